@@ -0,0 +1,111 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#define __STDC_CONSTANT_MACROS
+#define __STDC_LIMIT_MACROS
+
+#include <vector>
+#include <boost/bind.hpp>
+#include "Client.h"
+#include "Table.h"
+#include "TableIterator.h"
+#include "Row.hpp"
+#include "WireType.h"
+#include "Parameter.hpp"
+#include "ParameterSet.hpp"
+#include "InvocationFuture.h"
+#include "ClientConfig.h"
+
+/*
+ * The asynchronous hello world written with futures and continuations instead of
+ * callback classes. Continuations run from the event loop as soon as their response
+ * arrives, so a dependent call is issued without waiting for anything else.
+ */
+
+void printResponse(const voltdb::InvocationResponse &response) {
+    std::cout << response.toString();
+}
+
+/*
+ * Continuation of the Spanish insert: look the greeting up as soon as it is stored
+ */
+void selectGreeting(voltdb::Client *client, voltdb::Procedure *selectProc, const voltdb::InvocationResponse &insertResponse) {
+    if (insertResponse.failure()) {
+        std::cout << insertResponse.toString();
+        return;
+    }
+    selectProc->params()->addString("Spanish");
+    client->invokeAsync(*selectProc).then(printResponse);
+}
+
+int main(int argc, char **argv) {
+    /*
+     * Instantiate a client and connect to the database.
+     */
+    voltdb::ClientConfig clientConfig("program", "password");
+    voltdb::Client client = voltdb::Client::create();
+    client.createConnection("localhost");
+
+    /*
+     * Describe the stored procedures to be invoked
+     */
+    std::vector<voltdb::Parameter> parameterTypes(3);
+    parameterTypes[0] = voltdb::Parameter(voltdb::WIRE_TYPE_STRING);
+    parameterTypes[1] = voltdb::Parameter(voltdb::WIRE_TYPE_STRING);
+    parameterTypes[2] = voltdb::Parameter(voltdb::WIRE_TYPE_STRING);
+    voltdb::Procedure procedure("Insert", parameterTypes);
+
+    std::vector<voltdb::Parameter> selectTypes(1, voltdb::Parameter(voltdb::WIRE_TYPE_STRING));
+    voltdb::Procedure selectProc("Select", selectTypes);
+
+    /*
+     * Load the database, chaining the lookup onto the insert it depends on.
+     */
+    std::vector<voltdb::InvocationFuture> inserts;
+    voltdb::ParameterSet* params = procedure.params();
+    params->addString("English").addString("Hello").addString("World");
+    inserts.push_back(client.invokeAsync(procedure));
+
+    params->addString("French").addString("Bonjour").addString("Monde");
+    inserts.push_back(client.invokeAsync(procedure));
+
+    params->addString("Spanish").addString("Hola").addString("Mundo");
+    inserts.push_back(client.invokeAsync(procedure));
+    inserts.back().then(boost::bind(selectGreeting, &client, &selectProc, _1));
+
+    params->addString("Danish").addString("Hej").addString("Verden");
+    inserts.push_back(client.invokeAsync(procedure));
+
+    params->addString("Italian").addString("Ciao").addString("Mondo");
+    inserts.push_back(client.invokeAsync(procedure));
+
+    /*
+     * Join on the inserts, running the event loop until they have all completed, then
+     * drain whatever the continuations started.
+     */
+    if (!voltdb::whenAll(inserts)) {
+        std::cout << "Some inserts failed" << std::endl;
+    }
+    client.drain();
+
+    return 0;
+}
@@ -491,10 +491,11 @@ private:
 
 class SharedByteBuffer : public ExpandableByteBuffer {
 public:
-    SharedByteBuffer(const SharedByteBuffer &other) : ExpandableByteBuffer(other), m_ref(other.m_ref) {}
+    SharedByteBuffer(const SharedByteBuffer &other) : ExpandableByteBuffer(other), m_ref(other.m_ref), m_owner(other.m_owner) {}
 
     SharedByteBuffer& operator = (const SharedByteBuffer& other) {
         m_ref = other.m_ref;
+        m_owner = other.m_owner;
         m_buffer = other.m_buffer;
         m_position = other.m_position;
         m_limit = other.m_limit;
@@ -505,7 +506,7 @@ public:
     SharedByteBuffer() : ExpandableByteBuffer() {};
 
     SharedByteBuffer slice() {
-        SharedByteBuffer retval(m_ref, &m_buffer[m_position], m_limit - m_position);
+        SharedByteBuffer retval(m_ref, m_owner, &m_buffer[m_position], m_limit - m_position);
         m_position = m_limit;
         return retval;
     }
@@ -513,13 +514,26 @@ public:
     SharedByteBuffer(char *data, int32_t length) : ExpandableByteBuffer(data, length), m_ref(data) {}
     SharedByteBuffer(boost::shared_array<char>& data, int32_t length) : ExpandableByteBuffer(data.get(), length), m_ref(data) {}
 
+    /*
+     * View of length bytes at data that are kept alive by owner, which may own a larger region
+     * and releases it however it was allocated. The whole region stays alive for as long as
+     * this buffer or any slice of it does.
+     */
+    SharedByteBuffer(const boost::shared_ptr<void>& owner, char *data, int32_t length) :
+        ExpandableByteBuffer(data, length), m_owner(owner) {}
+
 protected:
     void resetRef(char *data)  {
         m_ref.reset(data);
+        m_owner.reset();
     }
 private:
-    SharedByteBuffer(boost::shared_array<char> ref, char *data, int32_t length) : ExpandableByteBuffer(data, length), m_ref(ref) {}
+    SharedByteBuffer(const boost::shared_array<char>& ref, const boost::shared_ptr<void>& owner, char *data, int32_t length) :
+        ExpandableByteBuffer(data, length), m_ref(ref), m_owner(owner) {}
+
     boost::shared_array<char> m_ref;
+    // region a view points into when it does not own its bytes through m_ref
+    boost::shared_ptr<void> m_owner;
 };
 
 class ScopedByteBuffer : public ExpandableByteBuffer {
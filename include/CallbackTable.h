@@ -0,0 +1,246 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_CALLBACKTABLE_H_
+#define VOLTDB_CALLBACKTABLE_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include "ProcedureCallback.hpp"
+
+namespace voltdb {
+
+class ConnectionState;
+
+/*
+ * Table of in-flight requests keyed by client data, shared by all connections.
+ *
+ * Client data is handed out sequentially, so the home slot of a request is the low bits of
+ * its client data and requests that complete in roughly the order they were sent never
+ * collide. Collisions caused by stragglers are resolved by linear probing and removal
+ * shifts the rest of the cluster back so no tombstones are needed. The table doubles if it
+ * becomes half full. The server's topology notifications arrive under a fixed client data
+ * value and are routed to a dedicated slot outside the table.
+ */
+class CallbackTable {
+public:
+    typedef std::pair<int64_t, boost::shared_ptr<ProcedureCallback> > Registration;
+
+    /*
+     * @param notificationClientData Client data the server uses for notifications
+     * @param expected Number of requests expected to be in flight at once
+     */
+    CallbackTable(int64_t notificationClientData, size_t expected) :
+        m_notificationClientData(notificationClientData), m_size(0) {
+        size_t capacity = MIN_CAPACITY;
+        while (capacity < expected * 2) {
+            capacity <<= 1;
+        }
+        m_slots.reset(new Slot[capacity]);
+        m_mask = capacity - 1;
+    }
+
+    /*
+     * Register the callback for a request of the given size sent on conn at sentMicros
+     */
+    void insert(int64_t clientData, ConnectionState *conn, const boost::shared_ptr<ProcedureCallback> &callback,
+                int64_t sentMicros = 0, int32_t bytes = 0) {
+        if ((m_size + 1) * 2 > m_mask + 1) {
+            rehash((m_mask + 1) * 2);
+        }
+        size_t slot = home(clientData);
+        while (m_slots[slot].m_callback.get() != NULL) {
+            slot = (slot + 1) & m_mask;
+        }
+        m_slots[slot].m_clientData = clientData;
+        m_slots[slot].m_conn = conn;
+        m_slots[slot].m_callback = callback;
+        m_slots[slot].m_sentMicros = sentMicros;
+        m_slots[slot].m_bytes = bytes;
+        m_size++;
+    }
+
+    /*
+     * Remove and return the callback registered for clientData, or an empty pointer if
+     * there is none. The connection, send time and size of a removed request are stored
+     * through conn, sentMicros and bytes when given. The notification callback is returned
+     * but never removed.
+     */
+    boost::shared_ptr<ProcedureCallback> remove(int64_t clientData, ConnectionState **conn = NULL,
+                                                int64_t *sentMicros = NULL, int32_t *bytes = NULL) {
+        if (clientData == m_notificationClientData) {
+            return m_notificationCallback;
+        }
+        boost::shared_ptr<ProcedureCallback> callback;
+        size_t slot = find(clientData);
+        if (slot != NOT_FOUND) {
+            callback.swap(m_slots[slot].m_callback);
+            if (conn != NULL) {
+                *conn = m_slots[slot].m_conn;
+            }
+            if (sentMicros != NULL) {
+                *sentMicros = m_slots[slot].m_sentMicros;
+            }
+            if (bytes != NULL) {
+                *bytes = m_slots[slot].m_bytes;
+            }
+            erase(slot);
+        }
+        return callback;
+    }
+
+    /*
+     * Connection the request for clientData was sent on, NULL if it is not in flight
+     */
+    ConnectionState *connection(int64_t clientData) const {
+        size_t slot = find(clientData);
+        return slot == NOT_FOUND ? NULL : m_slots[slot].m_conn;
+    }
+
+    /*
+     * Remove every request sent on conn, appending them to removed in the order they were sent
+     */
+    void removeConnection(ConnectionState *conn, std::vector<Registration> &removed) {
+        size_t first = removed.size();
+        for (size_t slot = 0; slot <= m_mask; slot++) {
+            if (m_slots[slot].m_callback.get() != NULL && m_slots[slot].m_conn == conn) {
+                removed.push_back(Registration(m_slots[slot].m_clientData, m_slots[slot].m_callback));
+            }
+        }
+        std::sort(removed.begin() + first, removed.end(), EarlierRequest());
+        for (size_t ii = first; ii < removed.size(); ii++) {
+            size_t slot = find(removed[ii].first);
+            m_slots[slot].m_callback.reset();
+            erase(slot);
+        }
+    }
+
+    void setNotificationCallback(const boost::shared_ptr<ProcedureCallback> &callback) {
+        m_notificationCallback = callback;
+    }
+
+    /*
+     * Number of requests in flight, not counting the notification callback
+     */
+    size_t size() const {
+        return m_size;
+    }
+
+    size_t capacity() const {
+        return m_mask + 1;
+    }
+
+    void clear() {
+        for (size_t slot = 0; slot <= m_mask; slot++) {
+            m_slots[slot].m_callback.reset();
+            m_slots[slot].m_conn = NULL;
+        }
+        m_notificationCallback.reset();
+        m_size = 0;
+    }
+
+private:
+    struct Slot {
+        Slot() : m_clientData(0), m_conn(NULL), m_sentMicros(0), m_bytes(0) {}
+        int64_t m_clientData;
+        ConnectionState *m_conn;
+        int64_t m_sentMicros;
+        int32_t m_bytes;
+        boost::shared_ptr<ProcedureCallback> m_callback;
+    };
+
+    struct EarlierRequest {
+        bool operator()(const Registration &a, const Registration &b) const {
+            return a.first < b.first;
+        }
+    };
+
+    static const size_t MIN_CAPACITY = 16;
+    static const size_t NOT_FOUND = ~static_cast<size_t>(0);
+
+    size_t home(int64_t clientData) const {
+        return static_cast<size_t>(static_cast<uint64_t>(clientData)) & m_mask;
+    }
+
+    size_t find(int64_t clientData) const {
+        size_t slot = home(clientData);
+        while (m_slots[slot].m_callback.get() != NULL) {
+            if (m_slots[slot].m_clientData == clientData) {
+                return slot;
+            }
+            slot = (slot + 1) & m_mask;
+        }
+        return NOT_FOUND;
+    }
+
+    /*
+     * Empty the slot and pull back any later entry of the cluster whose home is at or
+     * before the hole so that probes from their home slot still find them.
+     */
+    void erase(size_t hole) {
+        size_t next = (hole + 1) & m_mask;
+        while (m_slots[next].m_callback.get() != NULL) {
+            size_t nextHome = home(m_slots[next].m_clientData);
+            if (((next - nextHome) & m_mask) >= ((next - hole) & m_mask)) {
+                m_slots[hole].m_clientData = m_slots[next].m_clientData;
+                m_slots[hole].m_conn = m_slots[next].m_conn;
+                m_slots[hole].m_sentMicros = m_slots[next].m_sentMicros;
+                m_slots[hole].m_bytes = m_slots[next].m_bytes;
+                m_slots[hole].m_callback.swap(m_slots[next].m_callback);
+                hole = next;
+            }
+            next = (next + 1) & m_mask;
+        }
+        m_slots[hole].m_callback.reset();
+        m_slots[hole].m_conn = NULL;
+        m_size--;
+    }
+
+    void rehash(size_t capacity) {
+        boost::scoped_array<Slot> old(new Slot[capacity]);
+        old.swap(m_slots);
+        size_t oldCapacity = m_mask + 1;
+        m_mask = capacity - 1;
+        m_size = 0;
+        for (size_t slot = 0; slot < oldCapacity; slot++) {
+            if (old[slot].m_callback.get() != NULL) {
+                insert(old[slot].m_clientData, old[slot].m_conn, old[slot].m_callback, old[slot].m_sentMicros,
+                       old[slot].m_bytes);
+            }
+        }
+    }
+
+    const int64_t m_notificationClientData;
+    boost::scoped_array<Slot> m_slots;
+    size_t m_mask;
+    size_t m_size;
+    boost::shared_ptr<ProcedureCallback> m_notificationCallback;
+};
+
+}
+
+#endif /* VOLTDB_CALLBACKTABLE_H_ */
@@ -30,6 +30,9 @@
 #include "ClientLogger.h"
 #include <boost/shared_ptr.hpp>
 #include "ClientConfig.h"
+#include "ClientStats.h"
+#include "InvocationFuture.h"
+#include "ConnectionCallback.h"
 
 namespace voltdb {
 class MockVoltDB;
@@ -37,26 +40,47 @@ class ClientImpl;
 class ProcedureCallback;
 
 /*
- * A VoltDB client for invoking stored procedures on a VoltDB instance. The client and the
- * shared pointers it returns are not thread safe. If you need more parallelism you run multiple processes
- * and connect each process to a subset of the nodes in your VoltDB cluster.
+ * A VoltDB client for invoking stored procedures on a VoltDB instance. By default the client and the
+ * shared pointers it returns are not thread safe, and the client has no dedicated thread for doing network IO
+ * and invoking callbacks. Applications must call run() and runOnce() periodically to ensure that requests
+ * are sent and responses are processed. While one thread is inside run(), runOnce(), drain() or a
+ * synchronous invoke(), other threads may call invoke(); their invocations are serialized on the calling thread
+ * and queued for the thread running the event loop. If the queue is full the request is abandoned as TOO_BUSY.
  *
- * Because the client is single threaded it has no dedicated thread for doing network IO and invoking
- * callbacks. Applications must call run() and runOnce() periodically to ensure that requests are sent
- * and responses are processed.
+ * A client created with ClientConfig::m_ioThreads > 0 starts that many I/O threads, each with its own event
+ * loop, and spreads connections across them. invoke() may then be called from any thread; the invocation is
+ * serialized on the calling thread and handed to an I/O thread through a lock-free queue. Callbacks and
+ * status listener notifications run on the I/O threads, so they must be thread safe and must not make
+ * synchronous invocations. run() blocks until interrupt() or wakeup() and drain() waits for outstanding
+ * requests without driving any event loop.
  */
 class Client {
     friend class MockVoltDB;
 public:
     /*
      * Create a connection to the VoltDB process running at the specified host authenticating
-     * using the username and password provided when this client was constructed
+     * using the username and password provided when this client was constructed. Opens
+     * ClientConfig::m_connectionsPerHost sockets to the host.
      * @param hostname Hostname or IP address to connect to
      * @throws voltdb::ConnectException An error occurs connecting or authenticating
      * @throws voltdb::LibEventException libevent returns an error code
      */
     void createConnection(const std::string &hostname, const unsigned short port = 21212) throw (voltdb::ConnectException, voltdb::LibEventException, voltdb::Exception);
 
+    /*
+     * Resolve, connect and authenticate to all of the hosts concurrently without blocking.
+     * ClientConfig::m_connectionsPerHost connections are opened to each host. Connections
+     * are established while the event loop runs, and the client can invoke procedures as
+     * soon as the first one is up. The callback hears about each connection that
+     * authenticates and about completion of the whole set.
+     * @param hostnames Hostnames or IP addresses to connect to
+     * @param callback Notified as connections are established
+     * @param port Port to connect to on every host
+     * @throws voltdb::LibEventException libevent returns an error code
+     */
+    void createConnectionsAsync(const std::vector<std::string> &hostnames, boost::shared_ptr<ConnectionCallback> callback,
+                                const unsigned short port = 21212) throw (voltdb::Exception, voltdb::LibEventException);
+
     /*
      * Creates a pending connection that is handled in the reconnect callback 
      * @param hostname Hostname or IP address to connect to
@@ -99,6 +123,73 @@ public:
      */
     void invoke(voltdb::Procedure &proc, voltdb::ProcedureCallback *callback) throw (voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::Exception);
 
+    /*
+     * Asynchronously invoke a batch of stored procedures. The batch is serialized at once and each group of
+     * invocations bound for the same connection, by client affinity when enabled, is appended to it in one
+     * contiguous write. callbacks holds either one callback per procedure, in the same order, or a single
+     * callback shared by the whole batch. Backpressure is evaluated once for the batch: if the outstanding
+     * request limit leaves room for only part of it, the remainder is abandoned with TOO_BUSY. Each procedure
+     * in the batch must be a distinct Procedure with its own bound parameters. A batch holding a procedure
+     * rate limited by ClientConfig::m_rateLimits is invoked one procedure at a time.
+     * @throws NoConnectionsException No connections to submit the requests on
+     * @throws UninitializedParamsException Some or all of the parameters for a stored procedure were not set
+     * @throws LibEventException An unknown error occured in libevent
+     */
+#ifdef SWIG
+%ignore invokeBatch;
+#endif
+    void invokeBatch(std::vector<voltdb::Procedure*> &procs, const std::vector<boost::shared_ptr<voltdb::ProcedureCallback> > &callbacks) throw (voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::Exception);
+
+    /*
+     * Synchronously invoke a stored procedure, giving up after timeoutMillis. If no response arrives in time
+     * the returned response has status STATUS_CODE_CONNECTION_TIMEOUT.
+     * @throws NoConnectionsException No connections to submit the request on
+     * @throws UninitializedParamsException Some or all of the parameters for the stored procedure were not set
+     * @throws LibEventException An unknown error occured in libevent
+     */
+    voltdb::InvocationResponse invoke(voltdb::Procedure &proc, int32_t timeoutMillis) throw (voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::Exception);
+
+    /*
+     * Asynchronously invoke a stored procedure with a timeout. If no response arrives within timeoutMillis
+     * the callback is invoked from the event loop with a STATUS_CODE_CONNECTION_TIMEOUT response and
+     * any response that arrives later is dropped. Otherwise behaves as invoke without a timeout.
+     * @throws NoConnectionsException No connections to submit the request on
+     * @throws UninitializedParamsException Some or all of the parameters for the stored procedure were not set
+     * @throws LibEventException An unknown error occured in libevent
+     */
+#ifdef SWIG
+%ignore invoke(voltdb::Procedure &proc, boost::shared_ptr<voltdb::ProcedureCallback> callback, int32_t timeoutMillis);
+#endif
+    void invoke(voltdb::Procedure &proc, boost::shared_ptr<voltdb::ProcedureCallback> callback, int32_t timeoutMillis) throw (voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::Exception);
+    void invoke(voltdb::Procedure &proc, voltdb::ProcedureCallback *callback, int32_t timeoutMillis) throw (voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::Exception);
+
+    /*
+     * Asynchronously invoke a stored procedure that is only worth running until deadlineMillis, in
+     * milliseconds since the epoch. If the deadline passes while the client still holds the request,
+     * waiting out backpressure or buffered unsent on a connection, it is never sent and the callback
+     * is abandoned with DEADLINE_EXPIRED. A request already written to the socket is answered as usual,
+     * and ClientStats::m_lateResponses counts the answers that arrive after the deadline.
+     * @throws NoConnectionsException No connections to submit the request on
+     * @throws UninitializedParamsException Some or all of the parameters for the stored procedure were not set
+     * @throws LibEventException An unknown error occured in libevent
+     */
+#ifdef SWIG
+%ignore invokeWithDeadline;
+#endif
+    void invokeWithDeadline(voltdb::Procedure &proc, boost::shared_ptr<voltdb::ProcedureCallback> callback, int64_t deadlineMillis) throw (voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::Exception);
+
+    /*
+     * Asynchronously invoke a stored procedure and return a future for the response. Behaves as invoke
+     * with a callback, including blocking on backpressure. If the request is rejected because too many are
+     * outstanding the future completes with STATUS_CODE_SERVER_UNAVAILABLE. Use whenAll() to join on many
+     * futures at once; waiting runs the event loop a single threaded client needs to make progress.
+     * @throws NoConnectionsException No connections to submit the request on
+     * @throws UninitializedParamsException Some or all of the parameters for the stored procedure were not set
+     * @throws LibEventException An unknown error occured in libevent
+     */
+    voltdb::InvocationFuture invokeAsync(voltdb::Procedure &proc) throw (voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::Exception);
+    voltdb::InvocationFuture invokeAsync(voltdb::Procedure &proc, int32_t timeoutMillis) throw (voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::Exception);
+
     /*
      * Run the event loop once and process pending events. This writes requests to any ready connections
      * and reads all responses and invokes the appropriate callbacks. Returns immediately after performing
@@ -167,6 +258,11 @@ public:
     void setLoggerCallback(ClientLogger *pLogger);
 
     int32_t outstandingRequests() const; 
+
+    /*
+     * Counters describing the client's operation since it was created
+     */
+    ClientStats getStats() const;
     ~Client();
 private:
     /*
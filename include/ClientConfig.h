@@ -23,6 +23,7 @@
 
 #ifndef VOLTDB_CLIENTCONFIG_H_
 #define VOLTDB_CLIENTCONFIG_H_
+#include <map>
 #include <string>
 #include "StatusListener.h"
 #include <boost/shared_ptr.hpp>
@@ -31,6 +32,27 @@ namespace voltdb {
 
 enum ClientAuthHashScheme { HASH_SHA1, HASH_SHA256 };
 
+/*
+ * How a request that is not routed by client affinity picks its connection. Only connections
+ * without backpressure are considered.
+ * SELECT_ROUND_ROBIN takes each connection in turn.
+ * SELECT_LEAST_OUTSTANDING takes the one with the fewest requests in flight.
+ * SELECT_LEAST_LATENCY takes the one with the lowest average response time weighted by the
+ * requests in flight, at the cost of reading the clock for every request.
+ */
+enum ConnectionSelection { SELECT_ROUND_ROBIN, SELECT_LEAST_OUTSTANDING, SELECT_LEAST_LATENCY };
+
+/*
+ * A token bucket rate limit: permitsPerSecond invocations a second on average, in bursts of
+ * up to burst invocations. A limit of 0 or less permits per second is ignored.
+ */
+struct RateLimit {
+    RateLimit(int32_t permitsPerSecond = 0, int32_t burst = 1) :
+        m_permitsPerSecond(permitsPerSecond), m_burst(burst) {}
+    int32_t m_permitsPerSecond;
+    int32_t m_burst;
+};
+
 class ClientConfig {
 public:
     ClientConfig(
@@ -51,7 +73,85 @@ public:
     std::string m_password;
     boost::shared_ptr<StatusListener> m_listener;
     int32_t m_maxOutstandingRequests;
+    /*
+     * Limit on the total size of the requests in flight across all connections, checked
+     * alongside m_maxOutstandingRequests. 0, the default, sets no limit.
+     */
+    int64_t m_maxOutstandingBytes;
     ClientAuthHashScheme m_hashScheme;
+    /*
+     * Number of I/O threads to spread connections across. 0 (the default) keeps the
+     * single threaded behaviour where the application drives the event loop through
+     * run(), runOnce() and drain().
+     */
+    int32_t m_ioThreads;
+    /*
+     * Connection selection policy, SELECT_LEAST_OUTSTANDING by default
+     */
+    ConnectionSelection m_connectionSelection;
+    /*
+     * Number of sockets createConnection opens to each host, 1 by default. Requests routed
+     * to a host by client affinity pick among its sockets with the connection selection
+     * policy. Each socket is re-established on its own when it is lost.
+     */
+    int32_t m_connectionsPerHost;
+    /*
+     * Connect to every host of the cluster, not only the ones connections were created to.
+     * Whenever a connection is established or the topology changes the client asks the
+     * cluster for its hosts with @SystemInformation OVERVIEW and adds pending connections
+     * to the ones it has no connection to, which are retried until they succeed. Off by
+     * default.
+     */
+    bool m_discoverHosts;
+    /*
+     * Re-establishing lost connections. The first attempt is made as soon as a connection
+     * is lost. After it fails the client waits m_reconnectInitialDelayMillis (100), and each
+     * further failure multiplies the wait by m_reconnectBackoffMultiplier (2) up to
+     * m_reconnectMaxDelayMillis (10000). Every wait is shortened by a random fraction of up to
+     * m_reconnectJitter (0.2) so that clients do not all retry a restarted node together.
+     * An attempt that has not authenticated within m_reconnectTimeoutMillis (10000) is
+     * abandoned and counts as failed.
+     */
+    int32_t m_reconnectInitialDelayMillis;
+    int32_t m_reconnectMaxDelayMillis;
+    double m_reconnectBackoffMultiplier;
+    double m_reconnectJitter;
+    int32_t m_reconnectTimeoutMillis;
+    /*
+     * Flow control on each connection. Up to m_readHighWatermark bytes (55 MB) of responses
+     * are read before the connection stops reading until they are processed. Once more than
+     * m_backpressureThreshold bytes (256 KB) of requests are queued for a connection it is
+     * backpressured, and it is relieved when the queue drains below m_writeLowWatermark
+     * (8 KB). Fast links may need a larger threshold to keep enough requests in flight.
+     */
+    int32_t m_readHighWatermark;
+    int32_t m_backpressureThreshold;
+    int32_t m_writeLowWatermark;
+    /*
+     * Adapt the number of requests each connection may have in flight to its response times
+     * rather than relying on m_maxOutstandingRequests alone. A connection starts at
+     * m_concurrencyInitialLimit (20) requests. The limit grows by one per response while the
+     * connection is busy and responses are no slower than twice the fastest seen. It shrinks
+     * to 90% when they are slower or time out, but never below m_concurrencyMinLimit (1).
+     * m_maxOutstandingRequests still caps the total, and Client::getStats() reports the
+     * current limit. Off by default.
+     */
+    bool m_adaptiveConcurrency;
+    int32_t m_concurrencyInitialLimit;
+    int32_t m_concurrencyMinLimit;
+    /*
+     * Rate limits on asynchronous and synchronous invocations, keyed by procedure name or by
+     * the name of a group that m_rateLimitGroups maps procedures to. The procedures of a
+     * group share one bucket. An invocation that finds its bucket empty is deferred: it is
+     * counted as outstanding at once and the event loop sends it when its permit is due.
+     * Its timeout starts when it is sent. With m_rateLimitBlocking an asynchronous invoke
+     * waits for the permit instead, running the event loop meanwhile when called on the
+     * thread that drives it. Client::getStats() reports how many invocations had to wait.
+     * None by default.
+     */
+    std::map<std::string, RateLimit> m_rateLimits;
+    std::map<std::string, std::string> m_rateLimitGroups;
+    bool m_rateLimitBlocking;
 };
 }
 
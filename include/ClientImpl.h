@@ -34,38 +34,74 @@
 #include "Client.h"
 #include "Procedure.hpp"
 #include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_array.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include "ClientConfig.h"
 #include "Distributer.h"
+#include "CallbackTable.h"
+#include "ConnectionPolicy.h"
+#include "TimerWheel.h"
+#include "ReconnectBackoff.h"
+#include "ConcurrencyLimit.h"
+#include "TokenBucket.h"
+#include "MpscQueue.h"
+#include "FuturePool.h"
+#include "InvocationFuture.h"
 namespace voltdb {
 
-class CxnContext;
+class ConnectionState;
+class ConnectBatch;
 class MockVoltDB;
 class Client;
 class PendingConnection;
+class IoLoop;
+
+/*
+ * An invocation serialized by an application thread and waiting for the thread running
+ * the event loop to assign its client data and write it to a connection
+ */
+struct QueuedInvocation {
+    QueuedInvocation() : m_length(0), m_clientDataOffset(0), m_timeoutMillis(0), m_deadlineMillis(0), m_notBeforeMicros(0) {}
+    boost::shared_array<char> m_message;
+    int32_t m_length;
+    int32_t m_clientDataOffset;
+    std::string m_procedureName;
+    boost::shared_ptr<ProcedureCallback> m_callback;
+    int32_t m_timeoutMillis;
+    //On the monotonic clock, 0 for none
+    int64_t m_deadlineMillis;
+    //When its rate limit permits sending it, on the monotonic clock, 0 for at once
+    int64_t m_notBeforeMicros;
+};
+
+/*
+ * The members of an invocation batch bound for one connection, by index into the batch
+ */
+struct BatchGroup {
+    BatchGroup(ConnectionState *conn) : m_conn(conn), m_bytes(0) {}
+    ConnectionState *m_conn;
+    std::vector<size_t> m_members;
+    int32_t m_bytes;
+};
 
 class ClientImpl {
     friend class MockVoltDB;
     friend class PendingConnection;
     friend class Client;
+    friend class IoLoop;
+    friend class HostDiscoveryCallback;
+    friend class TopologyNotificationCallback;
 
 public:
 
-    /*
-     * Map from client data to the appropriate callback for a specific connection
-     */
-    typedef std::map< int64_t, boost::shared_ptr<ProcedureCallback> > CallbackMap;
-
-    /*
-     * Map from buffer event (connection) to the connection's callback map
-     */
-    typedef std::map< struct bufferevent*, boost::shared_ptr<CallbackMap> > BEVToCallbackMap;
-
-
     /*
      * Create a connection to the VoltDB process running at the specified host authenticating
-     * using the username and password provided when this client was constructed
+     * using the username and password provided when this client was constructed. Opens
+     * ClientConfig::m_connectionsPerHost sockets to the host.
      * @param hostname Hostname or IP address to connect to
      * @param port Port to connect to
      * @throws voltdb::ConnectException An error occurs connecting or authenticating
@@ -73,11 +109,26 @@ public:
      */
     void createConnection(const std::string &hostname, const unsigned short port) throw (voltdb::Exception, voltdb::ConnectException, voltdb::LibEventException);
 
+    /*
+     * Resolve, connect and authenticate to all of the hosts concurrently without blocking.
+     * ClientConfig::m_connectionsPerHost connections are opened to each host. Connections
+     * are established while the event loop runs, and the client can invoke procedures as
+     * soon as the first one is up. The callback hears about each connection that
+     * authenticates and about completion of the whole set.
+     * @param hostnames Hostnames or IP addresses to connect to
+     * @param callback Notified as connections are established
+     * @param port Port to connect to on every host
+     * @throws voltdb::LibEventException libevent returns an error code
+     */
+    void createConnectionsAsync(const std::vector<std::string> &hostnames, boost::shared_ptr<ConnectionCallback> callback,
+                                const unsigned short port) throw (voltdb::Exception, voltdb::LibEventException);
+
     /*
      * Creates a pending connection that is handled in the reconnect callback
      * @param hostname Hostname or IP address to connect to
      * @param port Port to connect to
-     * @param time since when connection is down
+     * @param time since when connection is down. The first attempt is made at once either
+     * way, later ones back off as configured in ClientConfig.
      */
     void createPendingConnection(const std::string &hostname, const unsigned short port, const int64_t time=0);
     void erasePendingConnection(PendingConnection *);
@@ -88,6 +139,41 @@ public:
     InvocationResponse invoke(Procedure &proc) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException);
     void invoke(Procedure &proc, boost::shared_ptr<ProcedureCallback> callback) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException);
     void invoke(Procedure &proc, ProcedureCallback *callback) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException);
+
+    /*
+     * Variants of invoke that complete the request with a STATUS_CODE_CONNECTION_TIMEOUT response
+     * if no response arrives within timeoutMillis. A timeout of 0 means wait indefinitely.
+     */
+    InvocationResponse invoke(Procedure &proc, int32_t timeoutMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException);
+    void invoke(Procedure &proc, boost::shared_ptr<ProcedureCallback> callback, int32_t timeoutMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException);
+    void invoke(Procedure &proc, ProcedureCallback *callback, int32_t timeoutMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException);
+
+    /*
+     * Asynchronously invoke a stored procedure that is only worth running until deadlineMillis,
+     * in milliseconds since the epoch. A request still held by the client when its deadline
+     * passes, whether waiting out backpressure or buffered unsent on a connection, is dropped
+     * and its callback abandoned with DEADLINE_EXPIRED. One already written to the socket is
+     * answered as usual and counted in ClientStats::m_lateResponses if the answer comes late.
+     */
+    void invokeWithDeadline(Procedure &proc, boost::shared_ptr<ProcedureCallback> callback, int64_t deadlineMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException);
+
+    /*
+     * Asynchronously invoke a batch of stored procedures with one write per target connection.
+     * callbacks holds either one callback per procedure or a single callback for all of them.
+     * A batch holding a rate limited procedure is invoked one procedure at a time.
+     */
+    void invokeBatch(std::vector<Procedure*> &procs, const std::vector<boost::shared_ptr<ProcedureCallback> > &callbacks) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException);
+
+    /*
+     * Asynchronously invoke a stored procedure, returning a future for the response
+     */
+    InvocationFuture invokeAsync(Procedure &proc, int32_t timeoutMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException);
+
+    /*
+     * Wait for a future created by this client to complete
+     */
+    void waitFor(FutureState &state) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException);
+
     void runOnce() throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException);
     void run() throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException);
 
@@ -102,11 +188,13 @@ public:
     bool drain() throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException);
     ~ClientImpl();
 
-    void regularReadCallback(struct bufferevent *bev);
-    void regularEventCallback(struct bufferevent *bev, short events);
-    void regularWriteCallback(struct bufferevent *bev);
+    void regularReadCallback(ConnectionState *conn);
+    void regularEventCallback(ConnectionState *conn, short events);
+    void regularWriteCallback(ConnectionState *conn);
+    void timeoutEventCallback();
     void eventBaseLoopBreak();
     void reconnectEventCallback();
+    void deferredEventCallback();
 
     /*
      * If one of the run family of methods is running on another thread, this
@@ -132,12 +220,34 @@ public:
     void setClientAffinity(bool enable);
     bool getClientAffinity(){return m_useClientAffinity;}
 
-    int32_t outstandingRequests() const {return m_outstandingRequests;}
+    int32_t outstandingRequests() const;
+
+    /*
+     * Total size of the requests written to connections and not yet answered
+     */
+    int64_t outstandingBytes() const;
+
+    /*
+     * Requests admitted in flight before more are rejected as too busy
+     */
+    int32_t concurrencyLimit() const;
+
+    ClientStats getStats() const;
 
-    void setLoggerCallback(ClientLogger *pLogger) { m_pLogger = pLogger;}
+    void setLoggerCallback(ClientLogger *pLogger);
+
+    /*
+     * Invoked on the event loop thread when the wakeup descriptor becomes readable
+     */
+    void wakeupPipeReadable();
 
 private:
-    ClientImpl(ClientConfig config) throw(voltdb::Exception, voltdb::LibEventException);
+    /*
+     * The I/O loops of a client are created with the client's distributer so that they
+     * all route with the same topology
+     */
+    ClientImpl(ClientConfig config, boost::shared_ptr<Distributer> distributer = boost::shared_ptr<Distributer>())
+    throw(voltdb::Exception, voltdb::LibEventException);
 
     void initiateAuthentication(PendingConnection* pc, struct bufferevent *bev) throw (voltdb::LibEventException);
     void finalizeAuthentication(PendingConnection* pc, struct bufferevent *bev) throw (voltdb::Exception, voltdb::ConnectException);
@@ -153,9 +263,211 @@ private:
     void subscribeToTopologyNotifications();
 
     /*
-     * Get the buffered event based on transaction routing algorithm
+     * Ask the cluster for its hosts if host discovery is configured and no request for them
+     * is already in flight
      */
-    struct bufferevent *routeProcedure(Procedure &proc, ScopedByteBuffer &sbb);
+    void discoverHosts();
+
+    /*
+     * Add pending connections to the hosts of an @SystemInformation OVERVIEW response that
+     * neither a connection nor a pending connection goes to
+     */
+    void connectDiscoveredHosts(const InvocationResponse &response);
+
+    /*
+     * True if a connection is up to the host or one to its address is up or pending
+     */
+    bool isConnectedOrPending(int hostId, const std::string &address, unsigned short port);
+
+    /*
+     * The topology snapshot to route with, fetched again only when the distributer has
+     * published a newer one. Valid until the next call, which may release it.
+     */
+    const TopologySnapshot &currentTopology();
+
+    /*
+     * Whether to route requests by client affinity with topology. While an update is being
+     * fetched the last topology received is still used and the requests are counted as
+     * routed with stale topology.
+     */
+    bool affinityRouting(const TopologySnapshot &topology, int64_t requests);
+
+    /*
+     * Get the connection based on transaction routing algorithm, or NULL if the host the
+     * request belongs on has no connection
+     */
+    ConnectionState *routeProcedure(const TopologySnapshot &topology, Procedure &proc);
+    ConnectionState *routeProcedure(const TopologySnapshot &topology, const std::string &name, ByteBuffer &params);
+    ConnectionState *routeToPartition(const TopologySnapshot &topology, const ProcedureInfo *procInfo, int hashedPartition);
+
+    /*
+     * Serialize an invocation with a placeholder client data
+     */
+    void serializeInvocation(Procedure &proc, const boost::shared_ptr<ProcedureCallback> &callback, int32_t timeoutMillis,
+                             int64_t deadlineMillis, int64_t notBeforeMicros, QueuedInvocation &invocation)
+    throw (voltdb::Exception, voltdb::UninitializedParamsException);
+
+    /*
+     * Serialize an invocation on the calling thread and queue it for the thread running
+     * the event loop. Returns false if the submission queue is full.
+     */
+    bool enqueueInvocation(Procedure &proc, const boost::shared_ptr<ProcedureCallback> &callback, int32_t timeoutMillis,
+                           int64_t deadlineMillis, int64_t notBeforeMicros)
+    throw (voltdb::Exception, voltdb::UninitializedParamsException);
+
+    /*
+     * Common path of the asynchronous invoke variants. deadlineMillis is on the monotonic
+     * clock, 0 for none.
+     */
+    void invokeUntil(Procedure &proc, const boost::shared_ptr<ProcedureCallback> &callback, int32_t timeoutMillis,
+                     int64_t deadlineMillis)
+    throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException);
+
+    /*
+     * Abandon a request whose deadline passed before it was sent and count it. Safe on any
+     * thread, as it touches no state of the event loop.
+     */
+    void abandonPastDeadline(const boost::shared_ptr<ProcedureCallback> &callback);
+
+    /*
+     * Abandon a request whose deadline passed before it was sent, on the event loop thread.
+     * Returns true if the event loop should break.
+     */
+    bool shedRequest(const boost::shared_ptr<ProcedureCallback> &callback);
+
+    /*
+     * Remember where the request just written to conn sits in its output buffer and arm its deadline
+     */
+    void scheduleDeadline(int64_t clientData, ConnectionState *conn, int32_t bytes, int64_t deadlineMillis);
+
+    /*
+     * The deadline of a request in flight passed. Removes it from its connection's output
+     * buffer if none of it has been written yet, otherwise marks its response as late.
+     * Returns true if the event loop should break.
+     */
+    bool expireDeadline(int64_t clientData);
+
+    /*
+     * Take a permit from the rate limit of the procedure. Returns 0 if it may be sent at
+     * once, otherwise the monotonic time in microseconds from which it may be sent.
+     */
+    int64_t reservePermit(const std::string &procedureName);
+
+    /*
+     * Hold a counted invocation until its permit is due and arm the timer for the earliest
+     */
+    void deferInvocation(QueuedInvocation &invocation);
+
+    /*
+     * Run the event loop until the deferred invocations due by sendMicros have been sent or
+     * a callback asks for the loop to break
+     */
+    void waitForDeferred(int64_t sendMicros) throw (voltdb::LibEventException);
+
+    /*
+     * Send everything in the submission queue. Runs on the event loop thread.
+     */
+    void drainSubmissions();
+    void sendQueued(QueuedInvocation &invocation);
+
+    /*
+     * Make the event loop run wakeupPipeReadable(). Signals raised before the loop gets to it
+     * are coalesced into one write.
+     */
+    void signalWakeup();
+
+    /*
+     * True if another thread is currently running this client's event loop
+     */
+    bool isForeignThread() const;
+
+    void rejectTooBusy(const boost::shared_ptr<ProcedureCallback> &callback);
+
+    /*
+     * The I/O thread to hand the next invocation or connection to. Throws if none
+     * of them has a connection.
+     */
+    IoLoop *nextIoLoop(bool requireConnection) throw (voltdb::NoConnectionsException);
+    bool ioLoopsHaveConnections() const;
+
+    /*
+     * Serialize an invocation straight into space reserved at the end of the
+     * connection's output buffer
+     */
+    void writeInvocation(ConnectionState *conn, Procedure &proc, int32_t messageSize, int64_t clientData) throw (voltdb::LibEventException);
+    void writeInvocations(const BatchGroup &batch, std::vector<Procedure*> &procs, const std::vector<int32_t> &sizes, int64_t firstClientData) throw (voltdb::LibEventException);
+
+    /*
+     * Pick the connection for the next write, running the event loop while every connection
+     * has backpressure unless the status listener says to queue anyway
+     */
+    ConnectionState *nextConnection() throw (voltdb::LibEventException);
+
+    /*
+     * Register a request written to conn so that its response finds its callback and the
+     * connection policy sees the request in flight
+     */
+    void trackRequest(int64_t clientData, ConnectionState *conn, const boost::shared_ptr<ProcedureCallback> &callback,
+                      int32_t bytes);
+
+    /*
+     * Whether m_maxOutstandingBytes is set and the requests in flight have reached it
+     */
+    bool outstandingBytesExceeded() const;
+
+    /*
+     * Feed a completed or timed out request to its connection's adaptive limit, if it has one
+     */
+    void adaptConcurrency(ConnectionState *conn, int64_t latencyMicros, bool timedOut);
+
+    /*
+     * Mark the connection backpressured if too much has been buffered for it
+     */
+    void checkBackpressure(ConnectionState *conn);
+
+    /*
+     * Arm the request timer wheel for a request invoked with a timeout
+     */
+    void scheduleTimeout(int64_t clientData, int32_t timeoutMillis);
+
+    /*
+     * Hand a response to a callback, routing anything it throws to the status listener.
+     * Returns true if the event loop should break.
+     */
+    bool invokeCallback(const boost::shared_ptr<ProcedureCallback> &callback, const InvocationResponse &response);
+
+    /*
+     * Open and authenticate a single socket to the host, driving the event loop until done
+     */
+    void openConnection(const std::string &hostname, const unsigned short port) throw (voltdb::Exception, voltdb::ConnectException, voltdb::LibEventException);
+
+    /*
+     * Start a connection of a createConnectionsAsync call and return without waiting for it
+     */
+    void beginConnection(const std::string &hostname, const unsigned short port, boost::shared_ptr<ConnectBatch> batch);
+
+    /*
+     * A connection started by beginConnection authenticated or failed. Releases the pending
+     * connection, so the caller must not touch it afterwards.
+     */
+    void connectionAttemptDone(PendingConnection *pc, bool connected);
+
+    /*
+     * An attempt to re-establish a pending connection failed, wait out its backoff delay
+     */
+    void reconnectFailed(PendingConnection *pc);
+
+    /*
+     * Arm the reconnect timer for the earliest pending connection whose attempt is due,
+     * or disarm it if none is waiting
+     */
+    void scheduleReconnect();
+
+    /*
+     * The asynchronous resolver, created with the first connection. NULL if it could not be
+     * created, in which case host names are resolved by blocking lookups.
+     */
+    struct evdns_base *dnsBase();
 
     /*
      * Initiate connection based on pending connection instance
@@ -168,21 +480,37 @@ private:
      */
     void logMessage(ClientLogger::CLIENT_LOG_LEVEL severity, const std::string& msg);
 
-    Distributer  m_distributer;
+    boost::shared_ptr<Distributer> m_distributer;
+    boost::shared_ptr<const TopologySnapshot> m_topology;
     struct event_base *m_base;
     int64_t m_nextRequestId;
-    size_t m_nextConnectionIndex;
-    std::vector<struct bufferevent*> m_bevs;
-    std::map<struct bufferevent *, boost::shared_ptr<CxnContext> > m_contexts;
-    std::map<int, struct bufferevent *> m_hostIdToEvent;
-    std::set<struct bufferevent *> m_backpressuredBevs;
-    BEVToCallbackMap m_callbacks;
+    //Authenticated connections, each the context of its bufferevent's callbacks
+    std::vector<boost::shared_ptr<ConnectionState> > m_connections;
+    //Selection among the connections to each host indexed by host id, NULL for hosts never connected
+    std::vector<boost::shared_ptr<ConnectionPolicy> > m_hostPolicies;
+    boost::scoped_ptr<ConnectionPolicy> m_connectionPolicy;
+    const ConnectionSelection m_connectionSelection;
+    //Whether requests are timed, for the connection policy or the adaptive limits
+    const bool m_trackLatency;
+    CallbackTable m_callbacks;
+    TimerWheel m_timeouts;
+    //Deadlines of requests sent with invokeWithDeadline, served by the timeout event
+    TimerWheel m_deadlines;
+    struct event *m_timeoutEvent;
     boost::shared_ptr<voltdb::StatusListener> m_listener;
     bool m_invocationBlockedOnBackpressure;
     boost::atomic<bool> m_loopBreakRequested;
     bool m_isDraining;
     bool m_instanceIdIsSet;
     boost::atomic<int32_t> m_outstandingRequests;
+    boost::atomic<int64_t> m_outstandingBytes;
+    //Sum of the adaptive limits of this client's connections
+    boost::atomic<int32_t> m_concurrencyLimit;
+    boost::atomic<int64_t> m_staleRoutedRequests;
+    boost::atomic<int64_t> m_shedRequests;
+    boost::atomic<int64_t> m_lateResponses;
+    boost::atomic<int64_t> m_rateLimitedRequests;
+    boost::shared_ptr<FuturePool> m_futures;
     //Identifier of the database instance this client is connected to
     int64_t m_clusterStartTime;
     int32_t m_leaderAddress;
@@ -190,21 +518,69 @@ private:
     std::string m_username;
     unsigned char *m_passwordHash;
     const int32_t m_maxOutstandingRequests;
+    const int64_t m_maxOutstandingBytes;
+    const size_t m_readHighWatermark;
+    const size_t m_backpressureThreshold;
+    const size_t m_writeLowWatermark;
+    const bool m_adaptiveConcurrency;
+    const int32_t m_concurrencyInitialLimit;
+    const int32_t m_concurrencyMinLimit;
+    const int32_t m_connectionsPerHost;
 
     bool m_ignoreBackpressure;
     bool m_useClientAffinity;
     //Flag to be set if topology is changed: node disconnected/rejoined
     bool m_updateHashinator;
+    const bool m_discoverHosts;
+    bool m_discoveryInFlight;
 
     std::list<boost::shared_ptr<PendingConnection> > m_pendingConnectionList;
     boost::atomic<size_t> m_pendingConnectionSize;
+    //Connections started by createConnectionsAsync that have not finished yet
+    std::list<boost::shared_ptr<PendingConnection> > m_connectingList;
+    boost::atomic<int32_t> m_connectingCount;
+    struct evdns_base *m_dnsBase;
     boost::mutex m_pendingConnectionLock;
+    //Single timer shared by every pending connection
+    struct event *m_reconnectEvent;
+    const ReconnectBackoff m_reconnectBackoff;
+    //How long an attempt may take before it is abandoned as failed
+    const int64_t m_reconnectTimeoutMillis;
+    unsigned int m_reconnectSeed;
 
+    //Buckets by procedure name, the procedures of a group share theirs
+    std::map<std::string, boost::shared_ptr<TokenBucket> > m_rateLimiters;
+    boost::mutex m_rateLimitLock;
+    const bool m_rateLimitBlocking;
+    //Invocations waiting for their permits by the time they are due, served by one timer
+    std::multimap<int64_t, QueuedInvocation> m_deferred;
+    struct event *m_deferredEvent;
+
+    //eventfd where available, both ends are the same descriptor
     int m_wakeupPipe[2];
-    boost::mutex m_wakeupPipeLock;
+    struct event *m_wakeupEvent;
+    boost::atomic<bool> m_wakeupPending;
+    boost::atomic<bool> m_wakeupBreakRequested;
 
     ClientLogger* m_pLogger;
     ClientAuthHashScheme m_hashScheme;
+
+    //Connections that have completed authentication, readable from any thread
+    boost::atomic<int32_t> m_connectionCount;
+    //Invocations from threads other than the one running the event loop
+    MpscQueue<QueuedInvocation> m_submissions;
+    class LoopThreadScope;
+    boost::atomic<bool> m_loopRunning;
+    boost::thread::id m_loopThreadId;
+    //Set when this client is driven by an I/O thread of another client
+    IoLoop *m_ioLoop;
+    //I/O threads that own the connections when configured with m_ioThreads
+    std::vector<boost::shared_ptr<IoLoop> > m_ioLoops;
+    boost::atomic<size_t> m_nextIoLoopIndex;
+    //Lets run() and drain() block while the I/O threads do the work
+    boost::mutex m_runLock;
+    boost::condition_variable m_runWake;
+    bool m_runWakeRequested;
     static const int64_t VOLT_NOTIFICATION_MAGIC_NUMBER;
 };
 }
@@ -0,0 +1,72 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_CLIENTSTATS_H_
+#define VOLTDB_CLIENTSTATS_H_
+
+#include <stdint.h>
+
+namespace voltdb {
+
+/*
+ * Counters a client keeps about its own operation, read with Client::getStats(). The counters
+ * of a client with I/O threads are summed over its loops.
+ */
+class ClientStats {
+public:
+    ClientStats() : m_staleRoutedRequests(0), m_concurrencyLimit(0), m_shedRequests(0), m_lateResponses(0),
+        m_rateLimitedRequests(0) {}
+
+    /*
+     * Requests routed by client affinity with the last topology received while a newer one
+     * was being fetched from the cluster
+     */
+    int64_t m_staleRoutedRequests;
+
+    /*
+     * Requests the client admits in flight before rejecting more as too busy. With adaptive
+     * concurrency this is the sum of the connections' current limits capped at
+     * m_maxOutstandingRequests, otherwise m_maxOutstandingRequests itself.
+     */
+    int32_t m_concurrencyLimit;
+
+    /*
+     * Requests with a deadline that were abandoned with DEADLINE_EXPIRED because it passed
+     * before they were sent
+     */
+    int64_t m_shedRequests;
+
+    /*
+     * Responses to requests with a deadline that arrived after it had passed
+     */
+    int64_t m_lateResponses;
+
+    /*
+     * Invocations that found their rate limit's bucket empty and waited for a permit
+     */
+    int64_t m_rateLimitedRequests;
+};
+
+}
+
+#endif /* VOLTDB_CLIENTSTATS_H_ */
@@ -0,0 +1,108 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_CONCURRENCYLIMIT_H_
+#define VOLTDB_CONCURRENCYLIMIT_H_
+
+#include <stdint.h>
+#include <algorithm>
+
+namespace voltdb {
+
+/*
+ * Number of requests one connection may have in flight, adapted to its response times by
+ * additive increase and multiplicative decrease.
+ *
+ * Response times are compared with the connection's no-load latency, the fastest response
+ * seen drifting slowly towards recent ones so that it follows a cluster whose normal speed
+ * changes. While responses take at most LATENCY_TOLERANCE times as long and the connection
+ * uses at least half its limit, every response raises the limit by one. A slower response
+ * or a timeout means requests are queueing at the server and the limit is cut to
+ * BACKOFF_PERCENT percent, at most once per limit's worth of responses so that one queue
+ * does not cut it repeatedly.
+ */
+class ConcurrencyLimit {
+public:
+    ConcurrencyLimit(int32_t initialLimit, int32_t minLimit, int32_t maxLimit) :
+        m_minLimit(std::max(minLimit, 1)), m_maxLimit(std::max(maxLimit, m_minLimit)),
+        m_limit(std::min(std::max(initialLimit, m_minLimit), m_maxLimit)),
+        m_noLoadLatencyMicros(0), m_sinceDecrease(0) {
+    }
+
+    int32_t limit() const {
+        return static_cast<int32_t>(m_limit);
+    }
+
+    /*
+     * A request was answered after latencyMicros while inFlight requests, itself included,
+     * were outstanding on the connection
+     */
+    void completed(int64_t latencyMicros, int32_t inFlight) {
+        const double sample = static_cast<double>(std::max(latencyMicros, static_cast<int64_t>(1)));
+        if (m_noLoadLatencyMicros == 0 || sample < m_noLoadLatencyMicros) {
+            m_noLoadLatencyMicros = sample;
+        } else {
+            m_noLoadLatencyMicros += (sample - m_noLoadLatencyMicros) / BASELINE_DRIFT;
+        }
+        m_sinceDecrease++;
+        if (sample > m_noLoadLatencyMicros * LATENCY_TOLERANCE) {
+            decrease();
+        } else if (inFlight * 2 >= m_limit) {
+            m_limit = std::min(m_limit + 1, static_cast<double>(m_maxLimit));
+        }
+    }
+
+    /*
+     * A request timed out
+     */
+    void timedOut() {
+        m_sinceDecrease++;
+        decrease();
+    }
+
+    double noLoadLatencyMicros() const {
+        return m_noLoadLatencyMicros;
+    }
+
+private:
+    // twice the no-load latency, cut to 90% of the limit, move the baseline 1/1000 of the way
+    enum { LATENCY_TOLERANCE = 2, BACKOFF_PERCENT = 90, BASELINE_DRIFT = 1000 };
+
+    void decrease() {
+        if (m_sinceDecrease < m_limit) {
+            return;
+        }
+        m_sinceDecrease = 0;
+        m_limit = std::max(m_limit * BACKOFF_PERCENT / 100, static_cast<double>(m_minLimit));
+    }
+
+    const int32_t m_minLimit;
+    const int32_t m_maxLimit;
+    double m_limit;
+    double m_noLoadLatencyMicros;
+    int32_t m_sinceDecrease;
+};
+
+}
+
+#endif /* VOLTDB_CONCURRENCYLIMIT_H_ */
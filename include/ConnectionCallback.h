@@ -0,0 +1,62 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLT_CONNECTIONCALLBACK_H_
+#define VOLT_CONNECTIONCALLBACK_H_
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace voltdb {
+
+/*
+ * Notified of the progress of Client::createConnectionsAsync. The methods are invoked on
+ * the thread running the event loop that established or failed the connection, one at a
+ * time, with completed last.
+ */
+class ConnectionCallback {
+public:
+    /*
+     * A connection to the host authenticated and the client can invoke procedures on it
+     * @param hostname Name of the host as it was passed in
+     * @param port Port connected to
+     * @return true if the event loop should terminate and false otherwise
+     */
+    virtual bool connected(const std::string &hostname, unsigned short port) {
+        return false;
+    }
+
+    /*
+     * Every host has either connected or failed
+     * @param connected Number of connections that authenticated
+     * @param failed Hosts a connection could not be established or authenticated to, once
+     * for each connection that failed
+     * @return true if the event loop should terminate and false otherwise
+     */
+    virtual bool completed(int32_t connected, const std::vector<std::string> &failed) = 0;
+
+    virtual ~ConnectionCallback() {}
+};
+}
+
+#endif /* VOLT_CONNECTIONCALLBACK_H_ */
@@ -0,0 +1,220 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_CONNECTIONPOLICY_H_
+#define VOLTDB_CONNECTIONPOLICY_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "ClientConfig.h"
+
+struct bufferevent;
+
+namespace voltdb {
+
+/*
+ * Load the client has put on one connection. Owned by the client's per connection state so
+ * that updating it after a send or a response needs no lookup.
+ */
+struct ConnectionLoad {
+    ConnectionLoad(struct bufferevent *bev) : m_bev(bev), m_outstanding(0), m_latencyMicros(0),
+        m_backpressured(false), m_limit(0) {}
+    struct bufferevent *m_bev;
+    int32_t m_outstanding;
+    // moving average of response times, 0 until the first response when latency is tracked
+    double m_latencyMicros;
+    // more is buffered for the connection than it should be given until it drains
+    bool m_backpressured;
+    // requests the connection may have in flight before it counts as backpressured, 0 for no limit
+    int32_t m_limit;
+};
+
+/*
+ * Chooses the connection for requests that are not routed to a partition master, including
+ * those whose routing falls back. The policy keeps the number of requests in flight on every
+ * connection and, if it asks for them, their response times. Subclasses decide which of the
+ * connections without backpressure is the better choice.
+ *
+ * Every scan starts one connection further along than the last, so connections the policy
+ * considers equal are used in turn and the round robin policy is simply one that never
+ * prefers a later connection over the first it sees.
+ */
+class ConnectionPolicy {
+public:
+    static ConnectionPolicy *create(ConnectionSelection selection);
+
+    ConnectionPolicy() : m_next(0) {}
+    virtual ~ConnectionPolicy() {}
+
+    /*
+     * Consider the connection whose load this is until it is removed
+     */
+    void addConnection(ConnectionLoad *load) {
+        m_loads.push_back(load);
+    }
+
+    void removeConnection(ConnectionLoad *load) {
+        std::vector<ConnectionLoad*>::iterator i = std::find(m_loads.begin(), m_loads.end(), load);
+        if (i != m_loads.end()) {
+            m_loads.erase(i);
+        }
+    }
+
+    /*
+     * Pick a connection, passing over those with backpressure or at their limit of requests
+     * in flight if skipBackpressured is set.
+     * Returns NULL if there are no connections or all of them were passed over.
+     */
+    ConnectionLoad *select(bool skipBackpressured) {
+        const size_t count = m_loads.size();
+        if (count == 0) {
+            return NULL;
+        }
+        const size_t start = ++m_next % count;
+        ConnectionLoad *best = NULL;
+        for (size_t ii = 0; ii < count; ii++) {
+            ConnectionLoad *load = m_loads[(start + ii) % count];
+            if (skipBackpressured && (load->m_backpressured ||
+                    (load->m_limit > 0 && load->m_outstanding >= load->m_limit))) {
+                continue;
+            }
+            if (best == NULL) {
+                best = load;
+                if (!comparesLoad()) {
+                    break;
+                }
+            } else if (better(*load, *best)) {
+                best = load;
+            }
+        }
+        return best;
+    }
+
+    /*
+     * A request was written to the connection
+     */
+    void sent(ConnectionLoad &load) {
+        load.m_outstanding++;
+    }
+
+    /*
+     * A request sent on the connection completed or timed out after latencyMicros. Pass a
+     * negative latency if it was not measured.
+     */
+    void completed(ConnectionLoad &load, int64_t latencyMicros) {
+        if (load.m_outstanding > 0) {
+            load.m_outstanding--;
+        }
+        if (latencyMicros >= 0 && tracksLatency()) {
+            const double sample = static_cast<double>(latencyMicros);
+            if (load.m_latencyMicros == 0) {
+                load.m_latencyMicros = sample;
+            } else {
+                // the newest sample carries a quarter of the weight
+                load.m_latencyMicros += (sample - load.m_latencyMicros) / 4;
+            }
+        }
+    }
+
+    size_t connectionCount() const {
+        return m_loads.size();
+    }
+
+    /*
+     * True if completed() should be given response times, which costs a clock read per request
+     */
+    virtual bool tracksLatency() const {
+        return false;
+    }
+
+protected:
+    /*
+     * True if candidate should be picked over the best connection found so far
+     */
+    virtual bool better(const ConnectionLoad &candidate, const ConnectionLoad &best) const = 0;
+
+    /*
+     * False if the first connection without backpressure is always the one to use
+     */
+    virtual bool comparesLoad() const {
+        return true;
+    }
+
+private:
+    std::vector<ConnectionLoad*> m_loads;
+    size_t m_next;
+};
+
+class RoundRobinPolicy : public ConnectionPolicy {
+protected:
+    bool better(const ConnectionLoad &candidate, const ConnectionLoad &best) const {
+        return false;
+    }
+    bool comparesLoad() const {
+        return false;
+    }
+};
+
+class LeastOutstandingPolicy : public ConnectionPolicy {
+protected:
+    bool better(const ConnectionLoad &candidate, const ConnectionLoad &best) const {
+        return candidate.m_outstanding < best.m_outstanding;
+    }
+};
+
+/*
+ * Weighs the response time average by the requests already queued on the connection, so a
+ * fast connection stops attracting everything once its queue grows, and a connection that
+ * has not answered anything yet competes on its queue alone.
+ */
+class LeastLatencyPolicy : public ConnectionPolicy {
+public:
+    bool tracksLatency() const {
+        return true;
+    }
+protected:
+    bool better(const ConnectionLoad &candidate, const ConnectionLoad &best) const {
+        return cost(candidate) < cost(best);
+    }
+private:
+    static double cost(const ConnectionLoad &load) {
+        return (load.m_latencyMicros + 1) * (load.m_outstanding + 1);
+    }
+};
+
+inline ConnectionPolicy *ConnectionPolicy::create(ConnectionSelection selection) {
+    switch (selection) {
+    case SELECT_ROUND_ROBIN:
+        return new RoundRobinPolicy();
+    case SELECT_LEAST_LATENCY:
+        return new LeastLatencyPolicy();
+    case SELECT_LEAST_OUTSTANDING:
+    default:
+        return new LeastOutstandingPolicy();
+    }
+}
+
+}
+
+#endif /* VOLTDB_CONNECTIONPOLICY_H_ */
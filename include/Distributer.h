@@ -24,15 +24,16 @@
 #ifndef DISTRIBUTER_H_
 #define DISTRIBUTER_H_
 
-#include <boost/scoped_ptr.hpp>
-#include <boost/thread/locks.hpp>
-#include <boost/thread/shared_mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #include "TheHashinator.h"
 #include "Table.h"
 #include "ByteBuffer.hpp"
 #include "Exception.hpp"
 #include <map>
 #include <string>
+#include <vector>
 
 
 
@@ -61,38 +62,106 @@ private:
     const int PARAMETER_NONE;
 };
 
+/*
+ * Everything routing needs, as of one topology and one procedure update. A snapshot is not
+ * modified once published: the Distributer publishes an update as a new snapshot that shares
+ * the parts that did not change, so a thread can keep routing with the snapshot it has while
+ * another publishes the next.
+ */
+class TopologySnapshot {
+     friend class Distributer;
+     friend class DistributerTest;
+public:
+     typedef std::map<std::string, boost::shared_ptr<ProcedureInfo> > ProcedureTable;
+
+     TopologySnapshot(): m_mpHostId(-1), m_procedures(new ProcedureTable()), m_isUpdating(false),
+         m_isElastic(true), m_version(0), m_procedureVersion(0){}
+
+     bool isUpdating() const {return m_isUpdating;}
+     bool isElastic() const {return m_isElastic;}
+     // whether a topology has been received from an elastic cluster to route with
+     bool hasTopology() const {return m_isElastic && m_hashinator;}
+     // changes every time a snapshot is published
+     int64_t version() const {return m_version;}
+     // changes every time the procedure information is replaced
+     int64_t procedureVersion() const {return m_procedureVersion;}
+
+     ProcedureInfo* getProcedure(const std::string& procName) const;
+     /*
+      * Handle to the partitioning of a procedure that stays valid after the procedure
+      * information is replaced, for callers that cache it along with procedureVersion()
+      */
+     boost::shared_ptr<ProcedureInfo> getProcedureHandle(const std::string& procName) const;
+     /*
+      * Partition the server would route the invocation to, or -1 if it cannot be determined.
+      * paramBuffer holds a serialized parameter set, starting with the parameter count.
+      * parameterType is the wire type of the partitioning column, -1 if unknown.
+      */
+     int getHashedPartitionForParameter(ByteBuffer &paramBuffer, int parameterId, int parameterType = -1) const;
+     /*
+      * As getHashedPartitionForParameter for a parameter already located at offset
+      */
+     int getHashedPartitionAt(ByteBuffer &paramBuffer, int offset, int parameterType = -1) const;
+     int getHostIdByPartitionId(int partitionId) const;
+
+private:
+     int parseParameter(ByteBuffer &paramBuffer, int &index, int partitionType) const;
+     static bool skipParameter(ByteBuffer &paramBuffer, int &index);
+
+     // leader host of each partition indexed by partition id, -1 where there is none
+     std::vector<int> m_partitionToHostId;
+     int m_mpHostId;
+     boost::shared_ptr<const TheHashinator> m_hashinator;
+     boost::shared_ptr<const ProcedureTable> m_procedures;
+     bool m_isUpdating;
+     bool m_isElastic;
+     int64_t m_version;
+     int64_t m_procedureVersion;
+};
+
+/*
+ * Publishes the topology and procedure partitioning learned from the cluster as
+ * TopologySnapshots. One Distributer is shared by a client and all of its I/O loops.
+ * Updates are serialized by a lock that readers never take in the common case: a reader
+ * holds on to a snapshot and only fetches the current one when version() has moved on, so
+ * routing a request costs one atomic load.
+ */
 class Distributer{
+     friend class DistributerTest;
 public:
-     void startUpdate(){m_isUpdating = true;}
-     bool isUpdating(){return m_isUpdating;}
-     bool isElastic(){return m_isElastic;}
+     Distributer();
+
+     void startUpdate();
+     /*
+      * Give up on an update whose topology fetch failed, republishing the current mappings
+      * with the updating flag cleared so requests stop being counted as routed on a stale map.
+      * The next topology notification starts a fresh update.
+      */
+     void abortUpdate();
 
      void updateAffinityTopology(const std::vector<voltdb::Table>& topoTable);
      void updateProcedurePartitioning(const std::vector<voltdb::Table>& procInfoTable);
+     void handleTopologyNotification(const std::vector<voltdb::Table>& t);
 
-     Distributer(): m_isUpdating(false), m_isElastic(true){}
-
-     virtual ~Distributer(){
-         m_procedureInfo.clear();
-         m_PartitionToHostId.clear();
-     }
+     /*
+      * The most recently published snapshot
+      */
+     boost::shared_ptr<const TopologySnapshot> snapshot() const;
+     // version of the most recently published snapshot
+     int64_t version() const {return m_version.load(boost::memory_order_acquire);}
 
-     ProcedureInfo* getProcedure(const std::string& procName) throw (UnknownProcedureException);
-     int getHashedPartitionForParameter(ByteBuffer &paramBuffer, int parameterId);
-     int getHostIdByPartitionId(int partitionId);
-     void handleTopologyNotification(const std::vector<voltdb::Table>& t);
      static const int MP_INIT_PID;
 
 private:
-     int parseParameter(ByteBuffer &paramBuffer, int &index);
-
-     std::map<std::string, ProcedureInfo> m_procedureInfo;
-     std::map<int, int> m_PartitionToHostId;
-     bool m_isUpdating;
-     bool m_isElastic;
-     boost::scoped_ptr<TheHashinator> m_hashinator;
-
-     static boost::shared_mutex m_procInfoLock;
+     /*
+      * Publish next, which starts out as a copy of the current snapshot. Called with
+      * m_publishLock held.
+      */
+     void publish(TopologySnapshot *next);
+
+     mutable boost::mutex m_publishLock;
+     boost::shared_ptr<const TopologySnapshot> m_snapshot;
+     boost::atomic<int64_t> m_version;
 
      voltdb::Table m_savedTopoTable;
 };
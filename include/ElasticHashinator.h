@@ -24,7 +24,11 @@
 #ifndef ELASTICHASHINATOR_H_
 #define ELASTICHASHINATOR_H_
 
+#include <arpa/inet.h>
+#include <cstring>
 #include <string>
+#include <vector>
+#include <boost/scoped_array.hpp>
 
 #include "TheHashinator.h"
 #include "MurmurHash3.h"
@@ -53,8 +57,8 @@ public:
         const uint32_t partitionOffset = 8;
         const uint32_t int32size = sizeof(int32_t);
 
-        m_tokens.reset(new int32_t[2*m_tokenCount]);
-
+        std::vector<int32_t> sortedHashes(m_tokenCount);
+        std::vector<int32_t> sortedPartitions(m_tokenCount);
         for (uint32_t ii = 0; ii < m_tokenCount; ii++) {
             int32_t hash;
             memcpy( &hash, tokens + ii*8 + tokenCountsOffset, int32size);
@@ -63,9 +67,17 @@ public:
             memcpy( &partitionId, tokens + ii*8 + partitionOffset, int32size);
 
             debug_msg("ElasticHashinator: hash " << std::hex << ntohl(hash) <<" partition " << std::dec << ntohl(partitionId));
-            m_tokens[ii * 2] = ntohl(hash);
-            m_tokens[ii * 2 + 1] =  ntohl(partitionId);
+            sortedHashes[ii] = ntohl(hash);
+            sortedPartitions[ii] =  ntohl(partitionId);
         }
+
+        // slot 0 is unused so that the children of slot k are 2k and 2k + 1
+        m_hashes.reset(new int32_t[m_tokenCount + 1]);
+        m_partitions.reset(new int32_t[m_tokenCount + 1]);
+        m_hashes[0] = 0;
+        m_partitions[0] = m_tokenCount > 0 ? sortedPartitions[m_tokenCount - 1] : 0;
+        uint32_t next = 0;
+        layout(sortedHashes, sortedPartitions, next, 1);
     }
 
 
@@ -96,29 +108,75 @@ public:
         return partitionForToken(hash);
     }
 
+    /*
+     * Hash the whole batch first, several keys at a time, then look up each hash's token
+     */
+    void hashinateBatch(const int64_t *values, size_t count, int32_t *partitionsOut) const {
+        MurmurHash3_x64_128_batch(values, count, partitionsOut);
+        for (size_t ii = 0; ii < count; ii++) {
+            partitionsOut[ii] = values[ii] == INT64_MIN ? 0 : partitionForToken(partitionsOut[ii]);
+        }
+    }
+
+    void hashinateBatch(const char *const *strings, const int32_t *lengths, size_t count,
+                        int32_t *partitionsOut) const {
+        for (size_t ii = 0; ii < count; ii++) {
+            partitionsOut[ii] = partitionForToken(MurmurHash3_x64_128(strings[ii], lengths[ii], 0));
+        }
+    }
+
+    /*
+     * Partition of the token at or before hash on the ring. The descent goes right at every
+     * token at or before hash, so the answer is where it last went right: drop the trailing
+     * left turns and that right turn from the final index. A hash before the first token
+     * wraps around to the last one, kept in slot 0.
+     */
+    int32_t partitionForToken(int32_t hash) const {
+        uint32_t k = 1;
+        while (k <= m_tokenCount) {
+#ifdef __GNUC__
+            // the 16 great grandchildren four levels down share a cache line
+            __builtin_prefetch(m_hashes.get() + 16 * k);
+#endif
+            k = 2 * k + (m_hashes[k] <= hash);
+        }
+#ifdef __GNUC__
+        k >>= __builtin_ffs(static_cast<int>(k));
+#else
+        while ((k & 1) == 0) {
+            k >>= 1;
+        }
+        k >>= 1;
+#endif
+        return m_partitions[k];
+    }
+
 private:
-    boost::scoped_array<int32_t> m_tokens;
+    /*
+     * The tokens are kept in Eytzinger order: the sorted ring laid out as an implicit
+     * binary search tree, breadth first, with the hashes and partitions in separate
+     * arrays. The top levels that every search visits share a few cache lines, the nodes a
+     * search will visit next can be prefetched, and descending is a comparison feeding an
+     * index instead of a branch.
+     */
+    boost::scoped_array<int32_t> m_hashes;
+    boost::scoped_array<int32_t> m_partitions;
     uint32_t m_tokenCount;
 
-    int32_t partitionForToken(int32_t hash) const {
-        int32_t min = 0;
-        int32_t max = m_tokenCount - 1;
-
-        while (min <= max) {
-            assert(min >= 0);
-            assert(max >= 0);
-            uint32_t mid = (min + max) >> 1;
-            int32_t midval = m_tokens[mid * 2];
-
-            if (midval < hash) {
-                min = mid + 1;
-            } else if (midval > hash) {
-                max = mid - 1;
-            } else {
-                return m_tokens[mid * 2 + 1];
-            }
+    /*
+     * Fill the subtree rooted at slot k with the sorted tokens from next onwards by an in
+     * order walk
+     */
+    void layout(const std::vector<int32_t> &sortedHashes, const std::vector<int32_t> &sortedPartitions,
+                uint32_t &next, uint32_t k) {
+        if (k > m_tokenCount) {
+            return;
         }
-        return m_tokens[(min - 1) * 2 + 1];
+        layout(sortedHashes, sortedPartitions, next, 2 * k);
+        m_hashes[k] = sortedHashes[next];
+        m_partitions[k] = sortedPartitions[next];
+        next++;
+        layout(sortedHashes, sortedPartitions, next, 2 * k + 1);
     }
 };
 }
@@ -0,0 +1,129 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_FUTUREPOOL_H_
+#define VOLTDB_FUTUREPOOL_H_
+
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include "ProcedureCallback.hpp"
+
+namespace voltdb {
+
+class ClientImpl;
+class FuturePool;
+
+/*
+ * Shared state of an InvocationFuture. It is the callback the request is registered with,
+ * handed to the callback table through a shared pointer created once per state rather
+ * than once per request. It is referenced by every future copy and by the pending
+ * completion, and returns to its pool when the last of them lets go.
+ */
+class FutureState : public ProcedureCallback, boost::noncopyable {
+public:
+    FutureState();
+
+    bool callback(InvocationResponse response) throw (voltdb::Exception);
+    void abandon(AbandonReason reason);
+
+    void retain() {
+        m_refs.fetch_add(1, boost::memory_order_relaxed);
+    }
+    void release();
+
+    bool ready() const {
+        return m_ready.load(boost::memory_order_acquire);
+    }
+
+    /*
+     * Block until the state is completed by another thread
+     */
+    void wait();
+
+    /*
+     * Set while the thread that owns the event loop dispatches on behalf of this future, so that
+     * completing it breaks the loop
+     */
+    void setWaiting(bool waiting) {
+        m_waiting = waiting;
+    }
+
+    /*
+     * Attach a continuation, or run it right away if the state is already complete
+     */
+    void then(const boost::function<void (const InvocationResponse&)> &continuation);
+
+    const InvocationResponse& response() const {
+        return m_response;
+    }
+
+    ClientImpl *client() const {
+        return m_client;
+    }
+
+    const boost::shared_ptr<ProcedureCallback>& asCallback() const {
+        return m_self;
+    }
+
+private:
+    friend class FuturePool;
+
+    bool complete(const InvocationResponse &response);
+
+    boost::shared_ptr<ProcedureCallback> m_self;
+    ClientImpl *m_client;
+    //Keeps the pool alive while the state is checked out
+    boost::shared_ptr<FuturePool> m_pool;
+    InvocationResponse m_response;
+    boost::atomic<bool> m_ready;
+    boost::atomic<int32_t> m_refs;
+    boost::atomic<bool> m_waiting;
+    boost::mutex m_lock;
+    boost::condition_variable m_completed;
+    boost::function<void (const InvocationResponse&)> m_continuation;
+};
+
+class FuturePool : public boost::enable_shared_from_this<FuturePool>, boost::noncopyable {
+public:
+    ~FuturePool();
+
+    /*
+     * Check out a state with one reference for the future and one for the completion
+     */
+    FutureState *acquire(ClientImpl *client);
+    void recycle(FutureState *state);
+
+private:
+    boost::mutex m_lock;
+    std::vector<FutureState*> m_free;
+};
+
+}
+
+#endif /* VOLTDB_FUTUREPOOL_H_ */
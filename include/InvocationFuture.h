@@ -0,0 +1,96 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_INVOCATIONFUTURE_H_
+#define VOLTDB_INVOCATIONFUTURE_H_
+
+#include <vector>
+#include <boost/function.hpp>
+#include "InvocationResponse.hpp"
+
+namespace voltdb {
+
+class ClientImpl;
+class FutureState;
+
+/*
+ * Handle to the response of a request made with Client::invokeAsync. Copies share the same
+ * result. The state behind a future comes from a pool owned by the client and goes back to
+ * it once the response has arrived and the last copy of the future is gone, so a future
+ * costs no allocation in the steady state. Futures must not outlive the client that
+ * created them.
+ */
+class InvocationFuture {
+public:
+    InvocationFuture() : m_state(NULL) {}
+    InvocationFuture(const InvocationFuture &other);
+    InvocationFuture& operator=(const InvocationFuture &other);
+    ~InvocationFuture();
+
+    bool valid() const { return m_state != NULL; }
+
+    /*
+     * True once the response, or an error response generated by the API, is available
+     */
+    bool ready() const;
+
+    /*
+     * Return the response, waiting for it if necessary. A single threaded client runs its event
+     * loop until the response arrives, invoking the callbacks of other requests along the way.
+     * A client with I/O threads, or one whose event loop is running on another thread, blocks.
+     * @throws NullPointerException The future is not valid
+     * @throws NoConnectionsException The response can never arrive because there are no connections
+     * @throws LibEventException An unknown error occured in libevent
+     */
+    InvocationResponse get() throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException);
+
+    /*
+     * Run continuation with the response as soon as it is available: immediately on the calling thread
+     * if it already is, otherwise from the event loop that receives it, before anything else is
+     * dispatched. Continuations may invoke further procedures to pipeline dependent calls without
+     * waiting. Only one continuation can be attached; a later one replaces it. An exception thrown
+     * by a continuation that runs from the event loop is passed to the status listener.
+     * @throws NullPointerException The future is not valid
+     */
+    void then(const boost::function<void (const InvocationResponse&)> &continuation) throw (voltdb::Exception);
+
+private:
+    friend class ClientImpl;
+    /*
+     * Takes over a reference to state that the caller already counted
+     */
+    explicit InvocationFuture(FutureState *state) : m_state(state) {}
+
+    FutureState *m_state;
+};
+
+/*
+ * Wait for every future in futures to complete.
+ * @return true if every response was successful
+ */
+bool whenAll(std::vector<InvocationFuture> &futures)
+throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException);
+
+}
+
+#endif /* VOLTDB_INVOCATIONFUTURE_H_ */
@@ -57,7 +57,19 @@ enum StatusCode {
     /*
      * Returned by the API when the connection to the server that a request was sent to is lost
      */
-    STATUS_CODE_CONNECTION_LOST = -4
+    STATUS_CODE_CONNECTION_LOST = -4,
+
+    /*
+     * Returned by the API when a request is rejected before being sent because the client
+     * already has too many requests outstanding
+     */
+    STATUS_CODE_SERVER_UNAVAILABLE = -5,
+
+    /*
+     * Returned by the API when no response to a request was received within the timeout
+     * the request was invoked with. A response that arrives later is dropped.
+     */
+    STATUS_CODE_CONNECTION_TIMEOUT = -6
 };
 
 /*
@@ -84,6 +96,22 @@ public:
         m_results() {
     }
 
+#ifdef SWIG
+    %ignore InvocationResponse(int64_t clientData, int8_t statusCode, const std::string& statusString);
+#endif
+    /*
+     * Constructor for an error response generated by the API rather than the server
+     */
+    InvocationResponse(int64_t clientData, int8_t statusCode, const std::string& statusString) :
+        m_clientData(clientData),
+        m_statusCode(statusCode),
+        m_statusString(statusString),
+        m_appStatusCode(INT8_MIN),
+        m_appStatusString(std::string("")),
+        m_clusterRoundTripTime(0),
+        m_results() {
+    }
+
 #ifdef SWIG
     %ignore InvocationResponse(boost::shared_array<char> data, int32_t length);
 #endif
@@ -92,36 +120,21 @@ public:
      * containing a response to a stored procedure invocation
      */
     InvocationResponse(boost::shared_array<char>& data, int32_t length) : m_results(0) {
-        SharedByteBuffer buffer(data, length);
-        int8_t version = buffer.getInt8();
-        assert(version == 0);
-        m_clientData = buffer.getInt64();
-        int8_t presentFields = buffer.getInt8();
-        m_statusCode =  buffer.getInt8();
-        bool wasNull = false;
-        if ((presentFields & (1 << 5)) != 0) {
-            m_statusString = buffer.getString(wasNull);
-        }
-        m_appStatusCode = buffer.getInt8();
-        if ((presentFields & (1 << 7)) != 0) {
-            m_appStatusString = buffer.getString(wasNull);
-        }
-        assert(!wasNull);
-        m_clusterRoundTripTime = buffer.getInt32();
-        if ((presentFields & (1 << 6)) != 0) {
-            int32_t position = buffer.position() + 4;
-            buffer.position(position + buffer.getInt32());
-        }
-        size_t resultCount = static_cast<size_t>(buffer.getInt16());
-        m_results.resize(resultCount);
-        int32_t startLimit = buffer.limit();
-        for (size_t ii = 0; ii < resultCount; ii++) {
-            int32_t tableLength = buffer.getInt32();
-            assert(tableLength >= 4);
-            buffer.limit(buffer.position() + tableLength);
-            m_results[ii] = voltdb::Table(buffer.slice());
-            buffer.limit(startLimit);
-        }
+        decode(SharedByteBuffer(data, length));
+    }
+
+#ifdef SWIG
+    %ignore InvocationResponse(const boost::shared_ptr<void>& owner, char *data, int32_t length);
+#endif
+    /*
+     * Constructor for decoding a response in place from a region of a larger buffer.
+     * owner keeps the entire buffer alive, not just this response's region, for as long as
+     * the response or any of its tables is referenced. The client only decodes in place when
+     * the response is large relative to the buffer it arrived in, so holding on to a response
+     * retains at most a bounded multiple of its own size.
+     */
+    InvocationResponse(const boost::shared_ptr<void>& owner, char *data, int32_t length) : m_results(0) {
+        decode(SharedByteBuffer(owner, data, length));
     }
 
     /*
@@ -238,6 +251,38 @@ private:
         } return str;
     }
 
+    void decode(SharedByteBuffer buffer) {
+        int8_t version = buffer.getInt8();
+        assert(version == 0);
+        m_clientData = buffer.getInt64();
+        int8_t presentFields = buffer.getInt8();
+        m_statusCode =  buffer.getInt8();
+        bool wasNull = false;
+        if ((presentFields & (1 << 5)) != 0) {
+            m_statusString = buffer.getString(wasNull);
+        }
+        m_appStatusCode = buffer.getInt8();
+        if ((presentFields & (1 << 7)) != 0) {
+            m_appStatusString = buffer.getString(wasNull);
+        }
+        assert(!wasNull);
+        m_clusterRoundTripTime = buffer.getInt32();
+        if ((presentFields & (1 << 6)) != 0) {
+            int32_t position = buffer.position() + 4;
+            buffer.position(position + buffer.getInt32());
+        }
+        size_t resultCount = static_cast<size_t>(buffer.getInt16());
+        m_results.resize(resultCount);
+        int32_t startLimit = buffer.limit();
+        for (size_t ii = 0; ii < resultCount; ii++) {
+            int32_t tableLength = buffer.getInt32();
+            assert(tableLength >= 4);
+            buffer.limit(buffer.position() + tableLength);
+            m_results[ii] = voltdb::Table(buffer.slice());
+            buffer.limit(startLimit);
+        }
+    }
+
 private:
     int64_t m_clientData;
     int8_t m_statusCode;
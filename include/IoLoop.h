@@ -0,0 +1,101 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_IOLOOP_H_
+#define VOLTDB_IOLOOP_H_
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "ClientImpl.h"
+
+namespace voltdb {
+
+/*
+ * One I/O thread of a client configured with ClientConfig::m_ioThreads. The thread owns a
+ * single threaded ClientImpl, its event_base and the connections created through it, and
+ * sits in event_base_dispatch for as long as the loop exists.
+ *
+ * Invocations are serialized by the calling thread and handed over through the lock-free
+ * submission queue of the loop's client. Everything else that touches the connections (connecting, enabling affinity,
+ * setting the logger) is run on the loop thread between dispatches while the caller waits.
+ */
+class IoLoop : boost::noncopyable {
+public:
+    IoLoop(ClientConfig config, boost::shared_ptr<Distributer> distributer) throw (voltdb::Exception, voltdb::LibEventException);
+    ~IoLoop();
+
+    /*
+     * Run task on the loop thread outside of event_base_dispatch and wait for it to finish.
+     * Rethrows the VoltDB exceptions the ClientImpl control methods can throw.
+     */
+    void execute(const boost::function<void()> &task)
+    throw (voltdb::Exception, voltdb::ConnectException, voltdb::LibEventException);
+
+    ClientImpl *impl() { return m_impl.get(); }
+
+    int32_t outstandingRequests() const { return m_impl->m_outstandingRequests; }
+    int64_t outstandingBytes() const { return m_impl->m_outstandingBytes; }
+    int32_t concurrencyLimit() const { return m_impl->m_concurrencyLimit; }
+
+    /*
+     * Connections that are up, and connections being established or waiting to be re-established
+     */
+    int32_t connectionCount() const { return m_impl->m_connectionCount; }
+    size_t pendingConnectionCount() const {
+        return m_impl->m_pendingConnectionSize + static_cast<size_t>(m_impl->m_connectingCount);
+    }
+
+    /*
+     * Invoked on the loop thread after the client drained its submissions on wakeup
+     */
+    void onWakeup();
+
+private:
+    enum TaskError { TASK_OK, TASK_CONNECT, TASK_CLUSTER_MISMATCH, TASK_LIBEVENT, TASK_OTHER };
+
+    void run();
+    void runTask();
+
+    boost::shared_ptr<ClientImpl> m_impl;
+    boost::atomic<bool> m_stop;
+
+    boost::mutex m_controlLock;
+    boost::mutex m_taskLock;
+    boost::condition_variable m_taskDone;
+    boost::function<void()> m_task;
+    boost::atomic<bool> m_taskPending;
+    TaskError m_taskError;
+    bool m_runningTask;
+
+    boost::scoped_ptr<boost::thread> m_thread;
+};
+
+}
+
+#endif /* VOLTDB_IOLOOP_H_ */
@@ -0,0 +1,115 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_MPSCQUEUE_H_
+#define VOLTDB_MPSCQUEUE_H_
+
+#include <stddef.h>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+
+namespace voltdb {
+
+/*
+ * Bounded multi-producer single-consumer ring (after Vyukov's bounded queue). Each cell
+ * carries a sequence number that tells a producer whether the cell is free for its lap of
+ * the ring and tells the consumer whether the value in it has been published. Producers
+ * claim cells with a compare-and-swap on the enqueue position and never wait for each
+ * other; push() fails instead of blocking when the ring is full. Only one thread may call
+ * pop().
+ */
+template <typename T>
+class MpscQueue : boost::noncopyable {
+public:
+    /*
+     * @param capacity Rounded up to a power of two
+     */
+    MpscQueue(size_t capacity) : m_enqueuePos(0), m_dequeuePos(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_cells.reset(new Cell[size]);
+        m_mask = size - 1;
+        for (size_t ii = 0; ii < size; ii++) {
+            m_cells[ii].m_sequence.store(ii, boost::memory_order_relaxed);
+        }
+    }
+
+    bool push(const T &value) {
+        size_t pos = m_enqueuePos.load(boost::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            const size_t sequence = cell->m_sequence.load(boost::memory_order_acquire);
+            const ptrdiff_t lap = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos);
+            if (lap == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (lap < 0) {
+                return false;
+            } else {
+                pos = m_enqueuePos.load(boost::memory_order_relaxed);
+            }
+        }
+        cell->m_value = value;
+        cell->m_sequence.store(pos + 1, boost::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value) {
+        Cell *cell = &m_cells[m_dequeuePos & m_mask];
+        if (cell->m_sequence.load(boost::memory_order_acquire) != m_dequeuePos + 1) {
+            return false;
+        }
+        value = cell->m_value;
+        cell->m_value = T();
+        cell->m_sequence.store(m_dequeuePos + m_mask + 1, boost::memory_order_release);
+        m_dequeuePos++;
+        return true;
+    }
+
+    size_t capacity() const {
+        return m_mask + 1;
+    }
+
+private:
+    struct Cell {
+        boost::atomic<size_t> m_sequence;
+        T m_value;
+    };
+
+    boost::scoped_array<Cell> m_cells;
+    size_t m_mask;
+    //Producers and the consumer work on opposite ends, keep them off each other's cache line
+    char m_pad0[64];
+    boost::atomic<size_t> m_enqueuePos;
+    char m_pad1[64];
+    size_t m_dequeuePos;
+};
+
+}
+
+#endif /* VOLTDB_MPSCQUEUE_H_ */
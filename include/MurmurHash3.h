@@ -5,6 +5,8 @@
 #ifndef _MURMURHASH3_H_
 #define _MURMURHASH3_H_
 
+#include <stddef.h>
+
 namespace voltdb {
 
 //-----------------------------------------------------------------------------
@@ -38,6 +40,9 @@ inline int32_t MurmurHash3_x64_128 ( int64_t value) {
     return MurmurHash3_x64_128(value, 0);
 }
 
+// Hash count 8 byte values with seed 0, storing hashes[i] = MurmurHash3_x64_128(values[i])
+void MurmurHash3_x64_128_batch ( const int64_t * values, size_t count, int32_t * hashes );
+
 //-----------------------------------------------------------------------------
 
 }
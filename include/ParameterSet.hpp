@@ -362,6 +362,7 @@ public:
         if (m_currentParam > m_parameters.size()) {
             throw new ParamMismatchException();
         }
+        markWatched();
         m_buffer.ensureRemaining(1);
         m_buffer.putInt8(WIRE_TYPE_NULL);
         m_currentParam++;
@@ -416,6 +417,7 @@ public:
     void reset() {
         m_buffer.clear();
         m_currentParam = 0;
+        m_watchedOffset = -1;
         m_buffer.putInt16(static_cast<int16_t>(m_parameters.size()));
     }
 
@@ -454,11 +456,13 @@ private:
         m_parameters(parameters)
        ,m_buffer(8192)
        ,m_currentParam(0)
-       ,m_dynamicParamCount(false) {
+       ,m_dynamicParamCount(false)
+       ,m_watchedParam(-1)
+       ,m_watchedOffset(-1) {
         m_buffer.putInt16(static_cast<int16_t>(m_parameters.size()));
     }
 
-    ParameterSet(): m_buffer(8192), m_currentParam(0), m_dynamicParamCount(true) {
+    ParameterSet(): m_buffer(8192), m_currentParam(0), m_dynamicParamCount(true), m_watchedParam(-1), m_watchedOffset(-1) {
         m_parameters.clear();
     }
 
@@ -466,7 +470,17 @@ private:
         m_buffer.putInt16(0, static_cast<int16_t>(m_parameters.size()));
     }
 
+    /*
+     * Remember where the watched parameter starts if it is the one about to be added
+     */
+    void markWatched() {
+        if (static_cast<int32_t>(m_currentParam) == m_watchedParam) {
+            m_watchedOffset = m_buffer.position();
+        }
+    }
+
     void validateType(WireType type, bool isArray) {
+        markWatched();
         if ((m_currentParam+1) > m_parameters.size() && m_dynamicParamCount) {
             m_parameters.push_back(Parameter(type, isArray));
             putParametersSize();
@@ -483,6 +497,9 @@ private:
     ScopedByteBuffer m_buffer;
     uint32_t m_currentParam;
     bool m_dynamicParamCount;
+    // parameter whose offset in m_buffer is recorded as it is added, -1 for none
+    int32_t m_watchedParam;
+    int32_t m_watchedOffset;
 };
 }
 #endif /* VOLTDB_PARAMETERSET_HPP_ */
@@ -25,10 +25,12 @@
 #define VOLTDB_PROCEDURE_HPP_
 #include <vector>
 #include <string>
+#include <boost/shared_ptr.hpp>
 #include "ParameterSet.hpp"
 #include "ByteBuffer.hpp"
 
 namespace voltdb {
+class ProcedureInfo;
 
 /*
  * Description of a stored procedure and its parameters that must be provided to the API
@@ -39,8 +41,9 @@ public:
     /*
      * Construct a Procedure with the specified name and specified signature (parameters)
      */
-    Procedure(const std::string& name, std::vector<Parameter> parameters) : m_name(name), m_params(parameters) {}
-    Procedure(const std::string& name) : m_name(name) {}
+    Procedure(const std::string& name, std::vector<Parameter> parameters) : m_name(name), m_params(parameters),
+        m_routingOwner(NULL), m_routingVersion(0) {}
+    Procedure(const std::string& name) : m_name(name), m_routingOwner(NULL), m_routingVersion(0) {}
 
     /**
      * Retrieve the parameter set associated with the procedure so that the parameters can be set
@@ -73,9 +76,52 @@ public:
         buffer->flip();
         buffer->putInt32( 0, buffer->limit() - 4);
     }
+
+#ifdef SWIG
+%ignore getParameterBuffer;
+#endif
+    /*
+     * View of the parameters bound so far, starting with the parameter count, as they will
+     * appear on the wire. Used to route an invocation before it is serialized.
+     */
+    ByteBuffer getParameterBuffer() {
+        return ByteBuffer(m_params.m_buffer.bytes(), m_params.getSerializedSize());
+    }
+
+#ifdef SWIG
+%ignore watchParameter;
+%ignore watchedParameterOffset;
+#endif
+    /*
+     * Record where the parameter at index starts in the parameter buffer each time it is
+     * bound, so the partitioning parameter can be found without decoding the ones before
+     * it. -1 stops recording.
+     */
+    void watchParameter(int32_t index) {
+        m_params.m_watchedParam = index;
+        m_params.m_watchedOffset = -1;
+    }
+
+    /*
+     * Offset of the watched parameter in getParameterBuffer(), or -1 if it has not been
+     * bound since it started being watched
+     */
+    int32_t watchedParameterOffset() const {
+        return m_params.m_watchedOffset;
+    }
 private:
+    friend class ClientImpl;
+
     const std::string m_name;
     ParameterSet m_params;
+
+    /*
+     * Partitioning of the procedure as last looked up by a client, valid while the client
+     * that looked it up, m_routingOwner, still has procedure information of m_routingVersion
+     */
+    boost::shared_ptr<ProcedureInfo> m_routingInfo;
+    const void *m_routingOwner;
+    int64_t m_routingVersion;
 };
 }
 
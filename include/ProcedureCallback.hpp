@@ -34,7 +34,11 @@ namespace voltdb {
 class ProcedureCallback {
 public:
 
-    enum AbandonReason { NOT_ABANDONED, TOO_BUSY };
+    /*
+     * TOO_BUSY: rejected because too many requests were outstanding.
+     * DEADLINE_EXPIRED: the deadline given to invokeWithDeadline passed before the request was sent.
+     */
+    enum AbandonReason { NOT_ABANDONED, TOO_BUSY, DEADLINE_EXPIRED };
 
     /*
      * Invoked when a response to an invocation is available or
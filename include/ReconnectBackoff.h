@@ -0,0 +1,137 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_RECONNECTBACKOFF_H_
+#define VOLTDB_RECONNECTBACKOFF_H_
+
+#include <stdint.h>
+#include <algorithm>
+
+namespace voltdb {
+
+/*
+ * Delays between attempts to re-establish a lost connection.
+ *
+ * After the first failed attempt the client waits initialDelayMillis, and each further
+ * failure multiplies the delay until it reaches maxDelayMillis. Every delay is shortened
+ * by a random fraction of up to jitter so that clients which lost the same node do not
+ * all retry it in lockstep.
+ */
+class ReconnectBackoff {
+public:
+    ReconnectBackoff(int32_t initialDelayMillis, int32_t maxDelayMillis, double multiplier, double jitter) :
+        m_initialDelayMillis(std::max(initialDelayMillis, 0)),
+        m_maxDelayMillis(std::max(maxDelayMillis, m_initialDelayMillis)),
+        m_multiplier(std::max(multiplier, 1.0)),
+        m_jitter(std::min(std::max(jitter, 0.0), 1.0)) {
+    }
+
+    /*
+     * @param failures Attempts that have failed so far, at least one
+     * @param random Uniformly distributed in [0, 1)
+     */
+    int64_t delayMillis(int32_t failures, double random) const {
+        double delay = m_initialDelayMillis;
+        for (int32_t ii = 1; ii < failures && delay > 0 && delay < m_maxDelayMillis; ii++) {
+            delay *= m_multiplier;
+        }
+        delay = std::min(delay, static_cast<double>(m_maxDelayMillis));
+        return static_cast<int64_t>(delay - delay * m_jitter * random);
+    }
+
+private:
+    const int32_t m_initialDelayMillis;
+    const int32_t m_maxDelayMillis;
+    const double m_multiplier;
+    const double m_jitter;
+};
+
+/*
+ * Where one lost connection is in being re-established. It waits until its next attempt
+ * is due, which for a connection that was just lost is at once, and is connecting while
+ * an attempt is in flight. A failed attempt sets it waiting again for the next backoff
+ * delay; a successful one removes the connection from the pending list altogether. An
+ * attempt that neither fails nor succeeds in time, e.g. to a peer that accepts the socket
+ * but never answers the login, expires and is treated as failed.
+ */
+class ReconnectState {
+public:
+    enum State {
+        WAITING,
+        CONNECTING
+    };
+
+    ReconnectState(int64_t dueMillis) : m_state(WAITING), m_failures(0), m_dueMillis(dueMillis), m_startedMillis(0) {
+    }
+
+    bool isDue(int64_t nowMillis) const {
+        return m_state == WAITING && nowMillis >= m_dueMillis;
+    }
+
+    void attemptStarted(int64_t nowMillis) {
+        m_state = CONNECTING;
+        m_startedMillis = nowMillis;
+    }
+
+    bool attemptExpired(int64_t nowMillis, int64_t attemptTimeoutMillis) const {
+        return m_state == CONNECTING && nowMillis >= m_startedMillis + attemptTimeoutMillis;
+    }
+
+    /*
+     * When the next attempt is due while waiting, or when the one in flight expires
+     */
+    int64_t nextEventMillis(int64_t attemptTimeoutMillis) const {
+        return m_state == WAITING ? m_dueMillis : m_startedMillis + attemptTimeoutMillis;
+    }
+
+    void attemptFailed(const ReconnectBackoff &backoff, int64_t nowMillis, double random) {
+        m_state = WAITING;
+        m_failures++;
+        m_dueMillis = nowMillis + backoff.delayMillis(m_failures, random);
+    }
+
+    State state() const {
+        return m_state;
+    }
+
+    /*
+     * When the next attempt is due, meaningful only while waiting
+     */
+    int64_t dueMillis() const {
+        return m_dueMillis;
+    }
+
+    int32_t failures() const {
+        return m_failures;
+    }
+
+private:
+    State m_state;
+    int32_t m_failures;
+    int64_t m_dueMillis;
+    int64_t m_startedMillis;
+};
+
+}
+
+#endif /* VOLTDB_RECONNECTBACKOFF_H_ */
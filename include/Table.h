@@ -44,6 +44,8 @@ public:
     /*
      * Construct a table from a shared buffer. The table retains a reference
      * to the shared buffer indefinitely so watch out for unwanted memory retension.
+     * A table from a response decoded in place keeps the whole network read it
+     * arrived in alive, see InvocationResponse.
      */
     Table(SharedByteBuffer buffer);
     Table() {}
@@ -46,6 +46,7 @@
 #endif
 
 
+#include <stddef.h>
 #include <stdint.h>
 namespace voltdb {
 
@@ -76,6 +77,27 @@ class TheHashinator {
      * pick a partition to store the data
      */
     virtual int32_t hashinate(const char *string, int32_t length) const = 0;
+
+    /*
+     * Pick partitions for count long values at once, storing the partition of values[i]
+     * in partitionsOut[i]. Costs one virtual call per batch instead of one per value.
+     */
+    virtual void hashinateBatch(const int64_t *values, size_t count, int32_t *partitionsOut) const {
+        for (size_t ii = 0; ii < count; ii++) {
+            partitionsOut[ii] = hashinate(values[ii]);
+        }
+    }
+
+    /*
+     * Pick partitions for count pieces of character or binary data, strings[i] being
+     * lengths[i] bytes long
+     */
+    virtual void hashinateBatch(const char *const *strings, const int32_t *lengths, size_t count,
+                                int32_t *partitionsOut) const {
+        for (size_t ii = 0; ii < count; ii++) {
+            partitionsOut[ii] = hashinate(strings[ii], lengths[ii]);
+        }
+    }
 };
 
 } // namespace voltdb
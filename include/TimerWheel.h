@@ -0,0 +1,121 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_TIMERWHEEL_H_
+#define VOLTDB_TIMERWHEEL_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace voltdb {
+
+/*
+ * Hashed timer wheel tracking request deadlines by client data.
+ *
+ * Scheduling appends to the slot for the deadline's tick, so it is O(1) however many
+ * requests are in flight. Timers are never cancelled: when a slot comes due the caller
+ * looks each expired client data up in its in-flight table and ignores the ones that have
+ * already completed. Deadlines more than one revolution away stay in their slot and are
+ * skipped until the revolution in which they fall due.
+ */
+class TimerWheel {
+public:
+    /*
+     * @param tickMillis Resolution of the wheel
+     * @param slots Number of slots, must be a power of two
+     * @param nowMillis Current time on the clock deadlines are measured against
+     */
+    TimerWheel(int64_t tickMillis, size_t slots, int64_t nowMillis) :
+        m_slots(slots), m_mask(slots - 1), m_tickMillis(tickMillis),
+        m_currentTick(nowMillis / tickMillis), m_size(0) {
+    }
+
+    void schedule(int64_t clientData, int64_t deadlineMillis) {
+        int64_t tick = (deadlineMillis + m_tickMillis - 1) / m_tickMillis;
+        if (tick <= m_currentTick) {
+            tick = m_currentTick + 1;
+        }
+        Timer timer = { clientData, tick };
+        m_slots[static_cast<size_t>(tick) & m_mask].push_back(timer);
+        m_size++;
+    }
+
+    /*
+     * Remove every timer whose deadline is at or before nowMillis and append its client data to expired
+     */
+    void expire(int64_t nowMillis, std::vector<int64_t> &expired) {
+        const int64_t nowTick = nowMillis / m_tickMillis;
+        if (nowTick <= m_currentTick) {
+            return;
+        }
+        int64_t ticks = nowTick - m_currentTick;
+        if (ticks > static_cast<int64_t>(m_slots.size())) {
+            ticks = static_cast<int64_t>(m_slots.size());
+        }
+        for (int64_t tick = nowTick - ticks + 1; tick <= nowTick; tick++) {
+            std::vector<Timer> &slot = m_slots[static_cast<size_t>(tick) & m_mask];
+            size_t kept = 0;
+            for (size_t ii = 0; ii < slot.size(); ii++) {
+                if (slot[ii].m_deadlineTick <= nowTick) {
+                    expired.push_back(slot[ii].m_clientData);
+                    m_size--;
+                } else {
+                    slot[kept++] = slot[ii];
+                }
+            }
+            slot.resize(kept);
+        }
+        m_currentTick = nowTick;
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    /*
+     * Number of timers scheduled, including those for requests that have since completed
+     */
+    size_t size() const {
+        return m_size;
+    }
+
+    int64_t tickMillis() const {
+        return m_tickMillis;
+    }
+
+private:
+    struct Timer {
+        int64_t m_clientData;
+        int64_t m_deadlineTick;
+    };
+
+    std::vector<std::vector<Timer> > m_slots;
+    const size_t m_mask;
+    const int64_t m_tickMillis;
+    int64_t m_currentTick;
+    size_t m_size;
+};
+
+}
+
+#endif /* VOLTDB_TIMERWHEEL_H_ */
@@ -0,0 +1,70 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VOLTDB_TOKENBUCKET_H_
+#define VOLTDB_TOKENBUCKET_H_
+
+#include <stdint.h>
+#include <algorithm>
+
+namespace voltdb {
+
+/*
+ * Token bucket holding up to burst permits and refilled with permitsPerSecond of them a
+ * second, read off a monotonic clock in microseconds.
+ *
+ * The bucket is kept as the time at which it will be full again, so refilling costs
+ * nothing and a permit can be reserved before it is available: reserve() takes the next
+ * permit and says when it may be used. Permits reserved ahead of time are owed by the
+ * bucket until the clock catches up with them.
+ */
+class TokenBucket {
+public:
+    TokenBucket(int32_t permitsPerSecond, int32_t burst) :
+        m_intervalNanos(NANOS_PER_SECOND / std::max(permitsPerSecond, 1)),
+        m_burstNanos(m_intervalNanos * (std::max(burst, 1) - 1)), m_fullNanos(0) {
+    }
+
+    /*
+     * Take a permit, returning the time from which it may be used. That is nowMicros when
+     * the bucket holds one.
+     */
+    int64_t reserve(int64_t nowMicros) {
+        const int64_t nowNanos = nowMicros * 1000;
+        const int64_t full = std::max(m_fullNanos, nowNanos);
+        m_fullNanos = full + m_intervalNanos;
+        const int64_t available = full - m_burstNanos;
+        return available <= nowNanos ? nowMicros : (available + 999) / 1000;
+    }
+
+private:
+    enum { NANOS_PER_SECOND = 1000000000 };
+
+    const int64_t m_intervalNanos;
+    const int64_t m_burstNanos;
+    int64_t m_fullNanos;
+};
+
+}
+
+#endif /* VOLTDB_TOKENBUCKET_H_ */
@@ -44,6 +44,15 @@ throw (voltdb::Exception, voltdb::ConnectException, voltdb::LibEventException) {
     m_impl->createConnection(hostname, port);
 }
 
+void
+Client::createConnectionsAsync(
+        const std::vector<std::string> &hostnames,
+        boost::shared_ptr<ConnectionCallback> callback,
+        const unsigned short port)
+throw (voltdb::Exception, voltdb::LibEventException) {
+    m_impl->createConnectionsAsync(hostnames, callback, port);
+}
+
 void 
 Client::createPendingConnection(
         const std::string &hostname, 
@@ -77,6 +86,59 @@ throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedP
     m_impl->invoke(proc, callback);
 }
 
+void
+Client::invokeBatch(
+        std::vector<Procedure*> &procs,
+        const std::vector<boost::shared_ptr<ProcedureCallback> > &callbacks)
+throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException) {
+    m_impl->invokeBatch(procs, callbacks);
+}
+
+InvocationResponse
+Client::invoke(Procedure &proc, int32_t timeoutMillis)
+throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException) {
+    return m_impl->invoke(proc, timeoutMillis);
+}
+
+void
+Client::invoke(
+        Procedure &proc,
+        boost::shared_ptr<ProcedureCallback> callback,
+        int32_t timeoutMillis)
+throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException) {
+    m_impl->invoke(proc, callback, timeoutMillis);
+}
+
+void
+Client::invoke(
+        Procedure &proc,
+        ProcedureCallback *callback,
+        int32_t timeoutMillis)
+throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException) {
+    m_impl->invoke(proc, callback, timeoutMillis);
+}
+
+void
+Client::invokeWithDeadline(
+        Procedure &proc,
+        boost::shared_ptr<ProcedureCallback> callback,
+        int64_t deadlineMillis)
+throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException) {
+    m_impl->invokeWithDeadline(proc, callback, deadlineMillis);
+}
+
+InvocationFuture
+Client::invokeAsync(Procedure &proc)
+throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException) {
+    return m_impl->invokeAsync(proc, 0);
+}
+
+InvocationFuture
+Client::invokeAsync(Procedure &proc, int32_t timeoutMillis)
+throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException) {
+    return m_impl->invokeAsync(proc, timeoutMillis);
+}
+
 void
 Client::runOnce()
 throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException) {
@@ -123,6 +185,10 @@ int32_t Client::outstandingRequests() const {
     return m_impl->outstandingRequests();
 }
 
+ClientStats Client::getStats() const {
+    return m_impl->getStats();
+}
+
 void Client::setLoggerCallback(ClientLogger *pLogger) {
     m_impl->setLoggerCallback(pLogger);
 }
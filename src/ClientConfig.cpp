@@ -69,14 +69,26 @@ public:
             std::string username,
             std::string password, ClientAuthHashScheme scheme) :
             m_username(username), m_password(password), m_listener(reinterpret_cast<StatusListener*>(NULL)),
-            m_maxOutstandingRequests(3000), m_hashScheme(scheme) {
+            m_maxOutstandingRequests(3000), m_maxOutstandingBytes(0), m_hashScheme(scheme), m_ioThreads(0),
+            m_connectionSelection(SELECT_LEAST_OUTSTANDING), m_connectionsPerHost(1), m_discoverHosts(false),
+            m_reconnectInitialDelayMillis(100), m_reconnectMaxDelayMillis(10000),
+            m_reconnectBackoffMultiplier(2.0), m_reconnectJitter(0.2), m_reconnectTimeoutMillis(10000),
+            m_readHighWatermark(1024 * 1024 * 55), m_backpressureThreshold(262144), m_writeLowWatermark(8192),
+            m_adaptiveConcurrency(false), m_concurrencyInitialLimit(20), m_concurrencyMinLimit(1),
+            m_rateLimitBlocking(false) {
     }
     ClientConfig::ClientConfig(
             std::string username,
             std::string password,
             StatusListener *listener, ClientAuthHashScheme scheme) :
             m_username(username), m_password(password), m_listener(new DummyStatusListener(listener)),
-            m_maxOutstandingRequests(3000), m_hashScheme(scheme) {
+            m_maxOutstandingRequests(3000), m_maxOutstandingBytes(0), m_hashScheme(scheme), m_ioThreads(0),
+            m_connectionSelection(SELECT_LEAST_OUTSTANDING), m_connectionsPerHost(1), m_discoverHosts(false),
+            m_reconnectInitialDelayMillis(100), m_reconnectMaxDelayMillis(10000),
+            m_reconnectBackoffMultiplier(2.0), m_reconnectJitter(0.2), m_reconnectTimeoutMillis(10000),
+            m_readHighWatermark(1024 * 1024 * 55), m_backpressureThreshold(262144), m_writeLowWatermark(8192),
+            m_adaptiveConcurrency(false), m_concurrencyInitialLimit(20), m_concurrencyMinLimit(1),
+            m_rateLimitBlocking(false) {
 
         m_hashScheme = HASH_SHA256;
     }
@@ -85,7 +97,13 @@ public:
             std::string password,
             boost::shared_ptr<StatusListener> listener, ClientAuthHashScheme scheme) :
                 m_username(username), m_password(password), m_listener(listener),
-                m_maxOutstandingRequests(3000), m_hashScheme(scheme) {
+                m_maxOutstandingRequests(3000), m_maxOutstandingBytes(0), m_hashScheme(scheme), m_ioThreads(0),
+                m_connectionSelection(SELECT_LEAST_OUTSTANDING), m_connectionsPerHost(1), m_discoverHosts(false),
+                m_reconnectInitialDelayMillis(100), m_reconnectMaxDelayMillis(10000),
+                m_reconnectBackoffMultiplier(2.0), m_reconnectJitter(0.2), m_reconnectTimeoutMillis(10000),
+                m_readHighWatermark(1024 * 1024 * 55), m_backpressureThreshold(262144), m_writeLowWatermark(8192),
+                m_adaptiveConcurrency(false), m_concurrencyInitialLimit(20), m_concurrencyMinLimit(1),
+                m_rateLimitBlocking(false) {
         m_hashScheme = HASH_SHA256;
     }
 }
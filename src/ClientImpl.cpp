@@ -21,21 +21,36 @@
  * OTHER DEALINGS IN THE SOFTWARE.
  */
 #include "ClientImpl.h"
+#include "IoLoop.h"
+#include <algorithm>
 #include <cassert>
 #include "AuthenticationResponse.hpp"
 #include "AuthenticationRequest.hpp"
+#include "TableIterator.h"
+#include "Row.hpp"
 #include <event2/buffer.h>
 #include <event2/thread.h>
 #include <event2/event.h>
+#include <event2/dns.h>
 #include "sha1.h"
 #include "sha256.h"
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <cstdlib>
+#include <deque>
+#include <set>
 #include <sstream>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 
 
-#define HIGH_WATERMARK 1024 * 1024 * 55
-#define RECONNECT_INTERVAL 10
+#define MAX_TAIL_COPY 4096
+#define MAX_SHARED_CHUNK (64 * 1024)
+#define TIMEOUT_TICK_MILLIS 10
+#define TIMEOUT_WHEEL_SLOTS 1024
+#define MIN_SUBMISSION_QUEUE 1024
 
 namespace voltdb {
 
@@ -50,11 +65,65 @@ int64_t get_sec_time() {
     return tp.tv_sec;
 }
 
+int64_t get_monotonic_msec() {
+    struct timespec ts;
+    int res = clock_gettime(CLOCK_MONOTONIC, &ts);
+    assert(res == 0);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+int64_t get_monotonic_usec() {
+    struct timespec ts;
+    int res = clock_gettime(CLOCK_MONOTONIC, &ts);
+    assert(res == 0);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Progress of the connections started by one createConnectionsAsync call. They may be
+ * spread over several I/O threads, so the callback is invoked under a lock and whichever
+ * thread finishes the last connection reports completion.
+ */
+class ConnectBatch {
+public:
+    ConnectBatch(size_t connections, boost::shared_ptr<ConnectionCallback> callback) :
+        m_remaining(connections), m_connected(0), m_callback(callback) {}
+
+    /*
+     * Returns true if the callback asked for the event loop to break
+     */
+    bool connectionDone(const std::string &hostname, unsigned short port, bool connected) {
+        boost::mutex::scoped_lock lock(m_lock);
+        bool breakEventLoop = false;
+        try {
+            if (connected) {
+                m_connected++;
+                breakEventLoop |= m_callback->connected(hostname, port);
+            } else {
+                m_failed.push_back(hostname);
+            }
+            if (--m_remaining == 0) {
+                breakEventLoop |= m_callback->completed(m_connected, m_failed);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Connection callback threw exception: " << e.what() << std::endl;
+        }
+        return breakEventLoop;
+    }
+
+private:
+    boost::mutex m_lock;
+    size_t m_remaining;
+    int32_t m_connected;
+    std::vector<std::string> m_failed;
+    boost::shared_ptr<ConnectionCallback> m_callback;
+};
+
 class PendingConnection {
 public:
     PendingConnection(const std::string& hostname,const unsigned short port, struct event_base *base, ClientImpl* ci)
         :  m_hostname(hostname), m_port(port), m_base(base), m_authenticationResponseLength(-1),
-           m_status(true), m_loginExchangeCompleted(false), m_startPending(-1), m_ci(ci) {
+           m_status(true), m_loginExchangeCompleted(false), m_startPending(-1), m_reconnect(0), m_bev(NULL), m_ci(ci) {
     }
 
     void initiateAuthentication(struct bufferevent *bev) {
@@ -65,6 +134,21 @@ public:
         m_ci->finalizeAuthentication(this, bev);
     }
 
+    /*
+     * Releases this pending connection
+     */
+    void attemptDone(bool connected) {
+        m_ci->connectionAttemptDone(this, connected);
+    }
+
+    void reconnectFailed() {
+        m_ci->reconnectFailed(this);
+    }
+
+    size_t readHighWatermark() const {
+        return m_ci->m_readHighWatermark;
+    }
+
     ~PendingConnection() {}
 
     /*
@@ -82,13 +166,19 @@ public:
     bool m_status;
     bool m_loginExchangeCompleted;
     int64_t m_startPending;
+    //When a pending connection is next tried, guarded by the client's pending connection lock
+    ReconnectState m_reconnect;
+    //Socket of the attempt in flight until it fails or is handed to its connection
+    struct bufferevent *m_bev;
     ClientImpl* m_ci;
+    //Set for connections started by createConnectionsAsync, which nothing waits on
+    boost::shared_ptr<ConnectBatch> m_batch;
 };
 
 class TopologyNotificationCallback : public voltdb::ProcedureCallback
 {
 public:
-    TopologyNotificationCallback(Distributer *dist):m_dist(dist){}
+    TopologyNotificationCallback(Distributer *dist, ClientImpl *client):m_dist(dist), m_client(client){}
     bool callback(InvocationResponse response) throw (voltdb::Exception)
     {
         if (response.failure()){
@@ -96,30 +186,163 @@ public:
             return false;
         }
         m_dist->handleTopologyNotification(response.results());
+        //a host may have joined
+        m_client->discoverHosts();
         return true;
     }
 
     void abandon(AbandonReason reason) {}
  private:
     Distributer *m_dist;
+    ClientImpl *m_client;
 };
 
 typedef boost::shared_ptr<PendingConnection> PendingConnectionSPtr;
 
-class CxnContext {
 /*
- * Data associated with a specific connection
+ * A request with a deadline in a connection's output buffer, located by its offset in the
+ * stream of bytes written to the buffer
  */
+struct DeadlineFrame {
+    int64_t m_clientData;
+    uint64_t m_start;
+    int32_t m_length;
+};
+
+/*
+ * Data associated with a specific connection. It is the context of the connection's
+ * callbacks, so they and the requests sent on the connection reach its load, backpressure
+ * and host without a lookup.
+ */
+class ConnectionState : public ConnectionLoad {
 public:
-    CxnContext(const std::string& name, unsigned short port) : m_name(name), m_port(port), m_nextLength(4), m_lengthOrMessage(true) {
+    ConnectionState(ClientImpl *impl, struct bufferevent *bev, const std::string& name, unsigned short port, int hostId) :
+        ConnectionLoad(bev), m_impl(impl), m_name(name), m_port(port), m_hostId(hostId), m_outstandingBytes(0),
+        m_streamBytes(evbuffer_get_length(bufferevent_get_output(bev))) {
+    }
 
+    /*
+     * Bytes of the stream that libevent has taken from the output buffer and written
+     */
+    uint64_t writtenBytes() const {
+        return m_streamBytes - evbuffer_get_length(bufferevent_get_output(m_bev));
     }
+
+    ClientImpl *const m_impl;
     const std::string m_name;
     const unsigned short m_port;
-    int32_t m_nextLength;
-    bool m_lengthOrMessage;
+    const int m_hostId;
+    //Size of the requests sent on this connection that have not been answered
+    int64_t m_outstandingBytes;
+    //Set with adaptive concurrency, its current limit is kept in m_limit
+    boost::scoped_ptr<ConcurrencyLimit> m_concurrency;
+    //Bytes ever added to the output buffer, less those of requests shed from it
+    uint64_t m_streamBytes;
+    //Requests with a deadline none of which had been written when last checked, in stream order
+    std::deque<DeadlineFrame> m_unsentDeadlines;
+    //Requests on the wire whose deadline has passed
+    std::set<int64_t> m_lateRequests;
+};
+
+/*
+ * Walks the chains of an evbuffer without removing anything from it. Used to frame
+ * responses in place so that the bytes can be handed to InvocationResponse where
+ * libevent read them.
+ */
+class ChainCursor {
+public:
+    ChainCursor(struct evbuffer *evbuf) : m_vecs(m_inlineVecs), m_index(0), m_offset(0) {
+        m_count = evbuffer_peek(evbuf, -1, NULL, NULL, 0);
+        if (m_count > INLINE_VECS) {
+            m_overflowVecs.resize(m_count);
+            m_vecs = &m_overflowVecs[0];
+        }
+        if (m_count > 0) {
+            evbuffer_peek(evbuf, -1, NULL, m_vecs, m_count);
+        }
+        skipEmptyChains();
+    }
+
+    /*
+     * Return a pointer to the next length bytes if they are contiguous in a single chain
+     * and advance past them, or NULL without advancing if they span chains.
+     */
+    char *contiguous(size_t length) {
+        if (m_index < m_count && m_vecs[m_index].iov_len - m_offset >= length) {
+            char *data = reinterpret_cast<char*>(m_vecs[m_index].iov_base) + m_offset;
+            m_offset += length;
+            skipEmptyChains();
+            return data;
+        }
+        return NULL;
+    }
+
+    /*
+     * Copy the next length bytes out, gathering across chains, and advance past them.
+     */
+    void copyOut(char *out, size_t length) {
+        while (length > 0) {
+            assert(m_index < m_count);
+            size_t chunk = std::min(length, m_vecs[m_index].iov_len - m_offset);
+            ::memcpy(out, reinterpret_cast<char*>(m_vecs[m_index].iov_base) + m_offset, chunk);
+            out += chunk;
+            length -= chunk;
+            m_offset += chunk;
+            skipEmptyChains();
+        }
+    }
+
+    /*
+     * Advance past the next length bytes.
+     */
+    void skip(size_t length) {
+        while (length > 0) {
+            assert(m_index < m_count);
+            size_t chunk = std::min(length, m_vecs[m_index].iov_len - m_offset);
+            length -= chunk;
+            m_offset += chunk;
+            skipEmptyChains();
+        }
+    }
+
+    int32_t readLength() {
+        char lengthBytes[4];
+        char *data = contiguous(4);
+        if (data == NULL) {
+            copyOut(lengthBytes, 4);
+            data = lengthBytes;
+        }
+        ByteBuffer lengthBuffer(data, 4);
+        return lengthBuffer.getInt32();
+    }
+
+private:
+    void skipEmptyChains() {
+        while (m_index < m_count && m_offset == m_vecs[m_index].iov_len) {
+            m_index++;
+            m_offset = 0;
+        }
+    }
+
+    static const int INLINE_VECS = 16;
+    struct evbuffer_iovec m_inlineVecs[INLINE_VECS];
+    std::vector<struct evbuffer_iovec> m_overflowVecs;
+    struct evbuffer_iovec *m_vecs;
+    int m_count;
+    int m_index;
+    size_t m_offset;
 };
 
+/*
+ * A response decoded in place keeps every chain of the chunk it arrived in alive until the
+ * last response or table referencing the chunk is gone. That is only worth it when the chunk
+ * is small or the response makes up most of it; a small response out of a large read is
+ * copied so that holding on to it does not pin the rest of the read.
+ */
+static bool decodeInPlace(size_t length, size_t chunkLength) {
+    return chunkLength <= MAX_SHARED_CHUNK || length >= chunkLength / 2;
+}
+
 /**
    type definition for the read or write callback.
 
@@ -147,7 +370,7 @@ static void authenticationReadCallback(struct bufferevent *bev, void *ctx) {
         assert(messageLength < 1024 * 1024);
         pc->m_authenticationResponseLength = messageLength;
         if (evbuffer_get_length(evbuf) < static_cast<size_t>(messageLength)) {
-            bufferevent_setwatermark( bev, EV_READ, static_cast<size_t>(messageLength), HIGH_WATERMARK);
+            bufferevent_setwatermark( bev, EV_READ, static_cast<size_t>(messageLength), pc->readHighWatermark());
             return;
         }
     }
@@ -163,14 +386,26 @@ static void authenticationReadCallback(struct bufferevent *bev, void *ctx) {
     pc->m_response = r;
     pc->m_loginExchangeCompleted = true;
 
-    bufferevent_setwatermark( bev, EV_READ, 4, HIGH_WATERMARK);
+    bufferevent_setwatermark( bev, EV_READ, 4, pc->readHighWatermark());
+    if (pc->m_batch) {
+        //there is no caller to throw to, a connection that can't be finalized has failed
+        bool connected = true;
+        try {
+            pc->finalizeAuthentication(bev);
+        } catch (const std::exception& e) {
+            connected = false;
+        }
+        pc->attemptDone(connected);
+        return;
+    }
+    //a reconnecting connection is released from the pending list once it is finalized
+    const bool fromCreateConnection = pc->m_startPending < 0;
+    struct event_base *base = pc->m_base;
     pc->finalizeAuthentication(bev);
 
-    if (pc->m_startPending < 0) {
+    if (fromCreateConnection) {
         //connection is pending from regular createConeection API
-        event_base_loopexit(pc->m_base, NULL);
-    } else {
-        pc->m_startPending = get_sec_time();
+        event_base_loopexit(base, NULL);
     }
 }
 
@@ -195,15 +430,23 @@ static void authenticationEventCallback(struct bufferevent *bev, short events, v
     } else if (events & (BEV_EVENT_ERROR | BEV_EVENT_EOF)) {
         pc->m_status = false;
         //pc->m_loginExchangeCompleted = true;
+        pc->m_bev = NULL;
         if (bev)
             bufferevent_free(bev);
     }
 
+    if (pc->m_batch) {
+        if (!pc->m_status) {
+            pc->attemptDone(false);
+        }
+        return;
+    }
+
     if (pc->m_startPending < 0) {
         //connection is pending from regular createConeection API
         event_base_loopexit(pc->m_base, NULL);
-    } else {
-        pc->m_startPending = get_sec_time();
+    } else if (!pc->m_status) {
+        pc->reconnectFailed();
     }
 }
 
@@ -221,23 +464,24 @@ static void authenticationEventCallback(struct bufferevent *bev, short events, v
    @param ctx the user specified context for this bufferevent
  */
 static void regularReadCallback(struct bufferevent *bev, void *ctx) {
-    ClientImpl *impl = reinterpret_cast<ClientImpl*>(ctx);
-    impl->regularReadCallback(bev);
+    ConnectionState *conn = reinterpret_cast<ConnectionState*>(ctx);
+    conn->m_impl->regularReadCallback(conn);
 }
 
 void wakeupPipeCallback(evutil_socket_t fd, short what, void *ctx) {
     ClientImpl *impl = reinterpret_cast<ClientImpl*>(ctx);
     char buf[64];
-    read(fd, buf, sizeof buf);
-    impl->eventBaseLoopBreak();
+    ssize_t consumed = read(fd, buf, sizeof buf);
+    (void)consumed;
+    impl->wakeupPipeReadable();
 }
 
 /*
  * Only has to handle the case where there is an error or EOF
  */
 static void regularEventCallback(struct bufferevent *bev, short events, void *ctx) {
-    ClientImpl *impl = reinterpret_cast<ClientImpl*>(ctx);
-    impl->regularEventCallback(bev, events);
+    ConnectionState *conn = reinterpret_cast<ConnectionState*>(ctx);
+    conn->m_impl->regularEventCallback(conn, events);
 }
 
 /**
@@ -254,17 +498,46 @@ static void regularEventCallback(struct bufferevent *bev, short events, void *ct
    @param ctx the user specified context for this bufferevent
  */
 static void regularWriteCallback(struct bufferevent *bev, void *ctx) {
+    ConnectionState *conn = reinterpret_cast<ConnectionState*>(ctx);
+    conn->m_impl->regularWriteCallback(conn);
+}
+
+static void timeoutEventCallback(evutil_socket_t fd, short events, void *ctx) {
+    ClientImpl *impl = reinterpret_cast<ClientImpl*>(ctx);
+    impl->timeoutEventCallback();
+}
+
+static void reconnectCallback(evutil_socket_t fd, short events, void *clientData) {
+    ClientImpl *self = reinterpret_cast<ClientImpl*>(clientData);
+    self->reconnectEventCallback();
+}
+
+static void deferredCallback(evutil_socket_t fd, short events, void *ctx) {
     ClientImpl *impl = reinterpret_cast<ClientImpl*>(ctx);
-    impl->regularWriteCallback(bev);
+    impl->deferredEventCallback();
 }
 
 ClientImpl::~ClientImpl() {
-    for (std::vector<struct bufferevent *>::iterator i = m_bevs.begin(); i != m_bevs.end(); ++i) {
-        bufferevent_free(*i);
+    m_ioLoops.clear();
+    for (size_t ii = 0; ii < m_connections.size(); ii++) {
+        bufferevent_free(m_connections[ii]->m_bev);
     }
-    m_bevs.clear();
-    m_contexts.clear();
+    m_connections.clear();
+    m_hostPolicies.clear();
     m_callbacks.clear();
+    if (m_dnsBase != NULL) {
+        evdns_base_free(m_dnsBase, 0);
+    }
+    event_free(m_timeoutEvent);
+    event_free(m_reconnectEvent);
+    event_free(m_deferredEvent);
+    if (m_wakeupEvent != NULL) {
+        event_free(m_wakeupEvent);
+        close(m_wakeupPipe[0]);
+        if (m_wakeupPipe[1] != m_wakeupPipe[0]) {
+            close(m_wakeupPipe[1]);
+        }
+    }
     if (m_passwordHash != NULL) free(m_passwordHash);
     event_base_free(m_base);
 }
@@ -280,15 +553,43 @@ void initLibevent() {
 
 const int64_t ClientImpl::VOLT_NOTIFICATION_MAGIC_NUMBER(9223372036854775806);
 
-ClientImpl::ClientImpl(ClientConfig config) throw(voltdb::Exception, voltdb::LibEventException) :
-        m_nextRequestId(INT64_MIN), m_nextConnectionIndex(0), m_listener(config.m_listener),
+ClientImpl::ClientImpl(ClientConfig config, boost::shared_ptr<Distributer> distributer)
+throw(voltdb::Exception, voltdb::LibEventException) :
+        m_distributer(distributer ? distributer : boost::shared_ptr<Distributer>(new Distributer())),
+        m_nextRequestId(INT64_MIN),
+        m_connectionPolicy(ConnectionPolicy::create(config.m_connectionSelection)),
+        m_connectionSelection(config.m_connectionSelection),
+        m_trackLatency(m_connectionPolicy->tracksLatency() || config.m_adaptiveConcurrency),
+        m_callbacks(VOLT_NOTIFICATION_MAGIC_NUMBER, static_cast<size_t>(std::max(config.m_maxOutstandingRequests, 0))),
+        m_timeouts(TIMEOUT_TICK_MILLIS, TIMEOUT_WHEEL_SLOTS, get_monotonic_msec()),
+        m_deadlines(TIMEOUT_TICK_MILLIS, TIMEOUT_WHEEL_SLOTS, get_monotonic_msec()),
+        m_listener(config.m_listener),
         m_invocationBlockedOnBackpressure(false), m_loopBreakRequested(false), m_isDraining(false),
-        m_instanceIdIsSet(false), m_outstandingRequests(0), m_username(config.m_username),
-        m_maxOutstandingRequests(config.m_maxOutstandingRequests), m_ignoreBackpressure(false),
-        m_useClientAffinity(false),m_updateHashinator(false), m_pendingConnectionSize(0) ,
-        m_pLogger(0)
+        m_instanceIdIsSet(false), m_outstandingRequests(0), m_outstandingBytes(0), m_concurrencyLimit(0), m_staleRoutedRequests(0), m_shedRequests(0), m_lateResponses(0), m_rateLimitedRequests(0), m_futures(new FuturePool()), m_username(config.m_username),
+        m_maxOutstandingRequests(config.m_maxOutstandingRequests),
+        m_maxOutstandingBytes(config.m_maxOutstandingBytes),
+        m_readHighWatermark(static_cast<size_t>(std::max(config.m_readHighWatermark, 4))),
+        m_backpressureThreshold(static_cast<size_t>(std::max(config.m_backpressureThreshold, 0))),
+        m_writeLowWatermark(static_cast<size_t>(std::max(config.m_writeLowWatermark, 0))),
+        m_adaptiveConcurrency(config.m_adaptiveConcurrency),
+        m_concurrencyInitialLimit(config.m_concurrencyInitialLimit),
+        m_concurrencyMinLimit(config.m_concurrencyMinLimit),
+        m_connectionsPerHost(std::max(config.m_connectionsPerHost, 1)), m_ignoreBackpressure(false),
+        m_useClientAffinity(false),m_updateHashinator(false),
+        m_discoverHosts(config.m_discoverHosts), m_discoveryInFlight(false), m_pendingConnectionSize(0), m_connectingCount(0), m_dnsBase(NULL),
+        m_reconnectEvent(NULL),
+        m_reconnectBackoff(config.m_reconnectInitialDelayMillis, config.m_reconnectMaxDelayMillis,
+                           config.m_reconnectBackoffMultiplier, config.m_reconnectJitter),
+        m_reconnectTimeoutMillis(std::max(config.m_reconnectTimeoutMillis, 1)),
+        m_reconnectSeed(static_cast<unsigned int>(get_monotonic_usec() ^ reinterpret_cast<uintptr_t>(this))),
+        m_rateLimitBlocking(config.m_rateLimitBlocking), m_deferredEvent(NULL),
+        m_wakeupEvent(NULL), m_wakeupPending(false), m_wakeupBreakRequested(false),
+        m_pLogger(0), m_connectionCount(0),
+        m_submissions(static_cast<size_t>(std::max(config.m_maxOutstandingRequests, MIN_SUBMISSION_QUEUE))),
+        m_loopRunning(false), m_ioLoop(NULL), m_nextIoLoopIndex(0), m_runWakeRequested(false)
 {
 
+    m_topology = m_distributer->snapshot();
     pthread_once(&once_initLibevent, initLibevent);
 #ifdef DEBUG
     if (!voltdb_clientimpl_debug_init_libevent) {
@@ -317,9 +618,41 @@ ClientImpl::ClientImpl(ClientConfig config) throw(voltdb::Exception, voltdb::Lib
         throw voltdb::LibEventException();
     }
 
-    if (0 == pipe(m_wakeupPipe)) {
-        struct event *ev = event_new(m_base, m_wakeupPipe[0], EV_READ|EV_PERSIST, wakeupPipeCallback, this);
-        event_add(ev, NULL);
+    m_timeoutEvent = event_new(m_base, -1, EV_PERSIST, voltdb::timeoutEventCallback, this);
+    if (!m_timeoutEvent) {
+        throw voltdb::LibEventException();
+    }
+    m_reconnectEvent = evtimer_new(m_base, voltdb::reconnectCallback, this);
+    if (!m_reconnectEvent) {
+        throw voltdb::LibEventException();
+    }
+    m_deferredEvent = evtimer_new(m_base, voltdb::deferredCallback, this);
+    if (!m_deferredEvent) {
+        throw voltdb::LibEventException();
+    }
+
+    // a group's procedures find the group's bucket under their own names
+    std::map<std::string, boost::shared_ptr<TokenBucket> > buckets;
+    for (std::map<std::string, RateLimit>::const_iterator i = config.m_rateLimits.begin(); i != config.m_rateLimits.end(); ++i) {
+        if (i->second.m_permitsPerSecond > 0) {
+            buckets[i->first].reset(new TokenBucket(i->second.m_permitsPerSecond, i->second.m_burst));
+        }
+    }
+    m_rateLimiters = buckets;
+    for (std::map<std::string, std::string>::const_iterator i = config.m_rateLimitGroups.begin(); i != config.m_rateLimitGroups.end(); ++i) {
+        std::map<std::string, boost::shared_ptr<TokenBucket> >::const_iterator group = buckets.find(i->second);
+        if (group != buckets.end()) {
+            m_rateLimiters[i->first] = group->second;
+        }
+    }
+
+    m_wakeupPipe[0] = m_wakeupPipe[1] = -1;
+#ifdef __linux__
+    m_wakeupPipe[0] = m_wakeupPipe[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+    if (m_wakeupPipe[0] != -1 || 0 == pipe(m_wakeupPipe)) {
+        m_wakeupEvent = event_new(m_base, m_wakeupPipe[0], EV_READ|EV_PERSIST, wakeupPipeCallback, this);
+        event_add(m_wakeupEvent, NULL);
     } else {
         m_wakeupPipe[1] = -1;
     }
@@ -327,6 +660,10 @@ ClientImpl::ClientImpl(ClientConfig config) throw(voltdb::Exception, voltdb::Lib
     SHA1_Init(&context);
     SHA1_Update( &context, reinterpret_cast<const unsigned char*>(config.m_password.data()), config.m_password.size());
     SHA1_Final(&context, m_passwordHash);
+
+    for (int32_t ii = 0; ii < config.m_ioThreads; ii++) {
+        m_ioLoops.push_back(boost::shared_ptr<IoLoop>(new IoLoop(config, m_distributer)));
+    }
 }
 
 class FreeBEVOnFailure {
@@ -359,7 +696,7 @@ void ClientImpl::initiateConnection(boost::shared_ptr<PendingConnection> &pc) th
     FreeBEVOnFailure protector(bev);
     bufferevent_setcb(bev, authenticationReadCallback, NULL, authenticationEventCallback, pc.get());
 
-    if (bufferevent_socket_connect_hostname(bev, NULL, AF_INET, pc->m_hostname.c_str(), pc->m_port) != 0) {
+    if (bufferevent_socket_connect_hostname(bev, dnsBase(), AF_INET, pc->m_hostname.c_str(), pc->m_port) != 0) {
 
         ss.str("");
         ss << "!!!! ClientImpl::initiateConnection to " << pc->m_hostname << ":" << pc->m_port << " failed";
@@ -368,15 +705,18 @@ void ClientImpl::initiateConnection(boost::shared_ptr<PendingConnection> &pc) th
         throw voltdb::LibEventException();
     }
     protector.success();
+    pc->m_bev = bev;
     }
 
 void ClientImpl::initiateAuthentication(PendingConnection* pc, struct bufferevent *bev)throw (voltdb::LibEventException) {
 
     logMessage(ClientLogger::DEBUG, "ClientImpl::initiateAuthentication");
 
+    //freed here if the login can't be sent
+    pc->m_bev = NULL;
     FreeBEVOnFailure protector(bev);
-    bufferevent_setwatermark( bev, EV_READ, 4, HIGH_WATERMARK);
-    bufferevent_setwatermark( bev, EV_WRITE, 8192, 262144);
+    bufferevent_setwatermark( bev, EV_READ, 4, m_readHighWatermark);
+    bufferevent_setwatermark( bev, EV_WRITE, m_writeLowWatermark, m_backpressureThreshold);
 
     if (bufferevent_enable(bev, EV_READ)) {
         throw voltdb::LibEventException();
@@ -390,12 +730,15 @@ void ClientImpl::initiateAuthentication(PendingConnection* pc, struct buffereven
         throw voltdb::LibEventException();
     }
     protector.success();
+    pc->m_bev = bev;
         }
 
 void ClientImpl::finalizeAuthentication(PendingConnection* pc, struct bufferevent *bev) throw (voltdb::Exception, voltdb::ConnectException){
 
     logMessage(ClientLogger::DEBUG, "ClientImpl::finalizeAuthentication");
 
+    //the socket goes to the connection, or is freed here on failure
+    pc->m_bev = NULL;
     FreeBEVOnFailure protector(bev);
     if (pc->m_loginExchangeCompleted) {
 
@@ -411,26 +754,38 @@ void ClientImpl::finalizeAuthentication(PendingConnection* pc, struct buffereven
                 throw ClusterInstanceMismatchException();
             }
         }
-        //save event for host id
-        m_hostIdToEvent[pc->m_response.hostId()] = bev;
-        bufferevent_setwatermark( bev, EV_READ, 4, HIGH_WATERMARK);
-        m_bevs.push_back(bev);
-
-        m_contexts[bev] =
-               boost::shared_ptr<CxnContext>(
-                   new CxnContext(pc->m_hostname, pc->m_port));
-        boost::shared_ptr<CallbackMap> callbackMap(new CallbackMap());
-        m_callbacks[bev] = callbackMap;
+        const int hostId = pc->m_response.hostId();
+        boost::shared_ptr<ConnectionState> conn(new ConnectionState(this, bev, pc->m_hostname, pc->m_port, hostId));
+        if (m_adaptiveConcurrency) {
+            conn->m_concurrency.reset(new ConcurrencyLimit(m_concurrencyInitialLimit, m_concurrencyMinLimit,
+                                                           m_maxOutstandingRequests));
+            conn->m_limit = conn->m_concurrency->limit();
+            m_concurrencyLimit += conn->m_limit;
+        }
+        //save connection for host id
+        if (hostId >= 0) {
+            if (static_cast<size_t>(hostId) >= m_hostPolicies.size()) {
+                m_hostPolicies.resize(hostId + 1);
+            }
+            if (!m_hostPolicies[hostId]) {
+                m_hostPolicies[hostId].reset(ConnectionPolicy::create(m_connectionSelection));
+            }
+            m_hostPolicies[hostId]->addConnection(conn.get());
+        }
+        bufferevent_setwatermark( bev, EV_READ, 4, m_readHighWatermark);
+        m_connections.push_back(conn);
+        m_connectionPolicy->addConnection(conn.get());
+        m_connectionCount = static_cast<int32_t>(m_connections.size());
 
-        //Add callback for Topology Notification to map for magic volt session id
-        boost::shared_ptr<TopologyNotificationCallback> topoNotificationCallback(new TopologyNotificationCallback(&m_distributer));
-        callbackMap->insert(std::pair< int64_t, boost::shared_ptr<ProcedureCallback> >(VOLT_NOTIFICATION_MAGIC_NUMBER, topoNotificationCallback));
+        //Add callback for Topology Notification to its slot for magic volt session id
+        boost::shared_ptr<TopologyNotificationCallback> topoNotificationCallback(new TopologyNotificationCallback(m_distributer.get(), this));
+        m_callbacks.setNotificationCallback(topoNotificationCallback);
 
         bufferevent_setcb(
                bev,
                voltdb::regularReadCallback,
                voltdb::regularWriteCallback,
-               voltdb::regularEventCallback, this);
+               voltdb::regularEventCallback, conn.get());
 
         {
             boost::mutex::scoped_lock lock(m_pendingConnectionLock);
@@ -448,16 +803,17 @@ void ClientImpl::finalizeAuthentication(PendingConnection* pc, struct buffereven
             updateHashinator();
             subscribeToTopologyNotifications();
         }
+        discoverHosts();
 
     	std::stringstream ss;
-    	ss << "connectionActive " << m_contexts[bev]->m_name << ":" << m_contexts[bev]->m_port ;
+    	ss << "connectionActive " << conn->m_name << ":" << conn->m_port ;
     	logMessage(ClientLogger::INFO, ss.str());
 
         //Notify client that a connection was active
         if (m_listener.get() != NULL) {
             try {
 
-                 m_listener->connectionActive( m_contexts[bev]->m_name, m_bevs.size() );
+                 m_listener->connectionActive( conn->m_name, m_connections.size() );
             } catch (const std::exception& e) {
                 std::cerr << "Status listener threw exception on connection active: " << e.what() << std::endl;
             }
@@ -478,8 +834,49 @@ void ClientImpl::finalizeAuthentication(PendingConnection* pc, struct buffereven
             protector.success();
 }
 
+/*
+ * Marks the calling thread as the one running the event loop for as long as it is in
+ * scope, so that invocations from other threads are handed over instead of touching
+ * the connections. Nested scopes, e.g. a callback invoking synchronously, are no-ops.
+ */
+class ClientImpl::LoopThreadScope {
+public:
+    LoopThreadScope(ClientImpl *impl) : m_impl(impl), m_outer(impl->m_loopRunning) {
+        if (!m_outer) {
+            m_impl->m_loopThreadId = boost::this_thread::get_id();
+            m_impl->m_loopRunning.store(true, boost::memory_order_release);
+        }
+    }
+    ~LoopThreadScope() {
+        if (!m_outer) {
+            m_impl->m_loopRunning.store(false, boost::memory_order_release);
+        }
+    }
+private:
+    ClientImpl *m_impl;
+    const bool m_outer;
+};
+
+bool ClientImpl::isForeignThread() const {
+    return m_loopRunning.load(boost::memory_order_acquire) && m_loopThreadId != boost::this_thread::get_id();
+}
+
+/*
+ * Each socket to the host is its own connection, so with I/O threads they are spread
+ * across the threads like connections to different hosts
+ */
 void ClientImpl::createConnection(const std::string& hostname, const unsigned short port) throw (voltdb::Exception, voltdb::ConnectException, voltdb::LibEventException) {
+    for (int32_t ii = 0; ii < m_connectionsPerHost; ii++) {
+        if (!m_ioLoops.empty()) {
+            IoLoop *loop = nextIoLoop(false);
+            loop->execute(boost::bind(&ClientImpl::openConnection, loop->impl(), hostname, port));
+        } else {
+            openConnection(hostname, port);
+        }
+    }
+}
 
+void ClientImpl::openConnection(const std::string& hostname, const unsigned short port) throw (voltdb::Exception, voltdb::ConnectException, voltdb::LibEventException) {
     std::stringstream ss;
     ss << "ClientImpl::createConnection" << " hostname:" << hostname << " port:" << port;
     logMessage(ClientLogger::INFO, ss.str());
@@ -487,6 +884,7 @@ void ClientImpl::createConnection(const std::string& hostname, const unsigned sh
     PendingConnectionSPtr pc(new PendingConnection(hostname, port, m_base, this));
     initiateConnection(pc);
 
+    LoopThreadScope scope(this);
     if (event_base_dispatch(m_base) == -1) {
         throw voltdb::LibEventException();
     }
@@ -503,47 +901,162 @@ void ClientImpl::createConnection(const std::string& hostname, const unsigned sh
     throw ConnectException();
 }
 
-static void reconnectCallback(evutil_socket_t fd, short events, void *clientData) {
-    ClientImpl *self = reinterpret_cast<ClientImpl*>(clientData);
-    self->reconnectEventCallback();
+void ClientImpl::createConnectionsAsync(const std::vector<std::string> &hostnames, boost::shared_ptr<ConnectionCallback> callback,
+                                        const unsigned short port) throw (voltdb::Exception, voltdb::LibEventException) {
+    if (callback.get() == NULL) {
+        throw voltdb::NullPointerException();
+    }
+    boost::shared_ptr<ConnectBatch> batch(new ConnectBatch(hostnames.size() * static_cast<size_t>(m_connectionsPerHost), callback));
+    if (hostnames.empty()) {
+        callback->completed(0, std::vector<std::string>());
+        return;
+    }
+    for (size_t host = 0; host < hostnames.size(); host++) {
+        for (int32_t ii = 0; ii < m_connectionsPerHost; ii++) {
+            if (!m_ioLoops.empty()) {
+                IoLoop *loop = nextIoLoop(false);
+                loop->execute(boost::bind(&ClientImpl::beginConnection, loop->impl(), hostnames[host], port, batch));
+            } else {
+                beginConnection(hostnames[host], port, batch);
+            }
+        }
+    }
+}
+
+void ClientImpl::beginConnection(const std::string &hostname, const unsigned short port, boost::shared_ptr<ConnectBatch> batch) {
+    std::stringstream ss;
+    ss << "ClientImpl::beginConnection" << " hostname:" << hostname << " port:" << port;
+    logMessage(ClientLogger::INFO, ss.str());
+
+    PendingConnectionSPtr pc(new PendingConnection(hostname, port, m_base, this));
+    pc->m_batch = batch;
+    m_connectingList.push_back(pc);
+    m_connectingCount++;
+    try {
+        initiateConnection(pc);
+    } catch (const std::exception& e) {
+        connectionAttemptDone(pc.get(), false);
+    }
+}
+
+void ClientImpl::connectionAttemptDone(PendingConnection *pc, bool connected) {
+    const std::string hostname = pc->m_hostname;
+    const unsigned short port = pc->m_port;
+    boost::shared_ptr<ConnectBatch> batch = pc->m_batch;
+    for (std::list<PendingConnectionSPtr>::iterator i = m_connectingList.begin(); i != m_connectingList.end(); ++i) {
+        if (i->get() == pc) {
+            m_connectingList.erase(i);
+            break;
+        }
+    }
+    m_connectingCount--;
+    if (batch->connectionDone(hostname, port, connected)) {
+        event_base_loopbreak(m_base);
+    }
+}
+
+struct evdns_base *ClientImpl::dnsBase() {
+    if (m_dnsBase == NULL) {
+        m_dnsBase = evdns_base_new(m_base, 1);
+    }
+    return m_dnsBase;
 }
 
 void ClientImpl::reconnectEventCallback() {
     if (m_pendingConnectionSize.load(boost::memory_order_consume) <= 0)  return;
 
-    boost::mutex::scoped_lock lock(m_pendingConnectionLock);
-    const int64_t now = get_sec_time();
-    BOOST_FOREACH( PendingConnectionSPtr& pc, m_pendingConnectionList ) {
-        if ((now - pc->m_startPending) > RECONNECT_INTERVAL){
-            //pc->m_startPending = now;
+    std::vector<PendingConnectionSPtr> due;
+    std::vector<PendingConnectionSPtr> expired;
+    {
+        boost::mutex::scoped_lock lock(m_pendingConnectionLock);
+        const int64_t now = get_monotonic_msec();
+        BOOST_FOREACH( PendingConnectionSPtr& pc, m_pendingConnectionList ) {
+            if (pc->m_reconnect.isDue(now)) {
+                pc->m_reconnect.attemptStarted(now);
+                due.push_back(pc);
+            } else if (pc->m_reconnect.attemptExpired(now, m_reconnectTimeoutMillis)) {
+                expired.push_back(pc);
+            }
+        }
+    }
+
+    //an attempt stuck connecting or authenticating is dropped along with its socket
+    BOOST_FOREACH( PendingConnectionSPtr& pc, expired ) {
+        if (pc->m_bev != NULL) {
+            bufferevent_free(pc->m_bev);
+            pc->m_bev = NULL;
+        }
+        pc->m_authenticationResponseLength = -1;
+        reconnectFailed(pc.get());
+    }
+
+    //attempts that fail right away are rescheduled by reconnectFailed, the rest report back
+    //through the authentication callbacks
+    BOOST_FOREACH( PendingConnectionSPtr& pc, due ) {
+        try {
             initiateConnection(pc);
+        } catch (const std::exception& e) {
+            reconnectFailed(pc.get());
         }
     }
+    scheduleReconnect();
+}
 
-    struct timeval tv;
-    tv.tv_sec = RECONNECT_INTERVAL;
-    tv.tv_usec = 0;
+void ClientImpl::reconnectFailed(PendingConnection *pc) {
+    const double random = rand_r(&m_reconnectSeed) / (RAND_MAX + 1.0);
+    int64_t delay;
+    {
+        boost::mutex::scoped_lock lock(m_pendingConnectionLock);
+        const int64_t now = get_monotonic_msec();
+        pc->m_reconnect.attemptFailed(m_reconnectBackoff, now, random);
+        delay = pc->m_reconnect.dueMillis() - now;
+    }
+    std::stringstream ss;
+    ss << "ClientImpl::reconnectFailed to " << pc->m_hostname << ":" << pc->m_port
+       << ", retrying in " << delay << " ms";
+    logMessage(ClientLogger::INFO, ss.str());
+    scheduleReconnect();
+}
 
-    event_base_once(m_base, -1, EV_TIMEOUT, reconnectCallback, this, &tv);
+void ClientImpl::scheduleReconnect() {
+    int64_t earliest = INT64_MAX;
+    {
+        boost::mutex::scoped_lock lock(m_pendingConnectionLock);
+        BOOST_FOREACH( PendingConnectionSPtr& pc, m_pendingConnectionList ) {
+            earliest = std::min(earliest, pc->m_reconnect.nextEventMillis(m_reconnectTimeoutMillis));
+        }
+    }
+    if (earliest == INT64_MAX) {
+        event_del(m_reconnectEvent);
+        return;
+    }
+    //re-adding a pending timer moves it, so there is never more than one outstanding
+    const int64_t delay = std::max(earliest - get_monotonic_msec(), static_cast<int64_t>(0));
+    struct timeval tv;
+    tv.tv_sec = static_cast<time_t>(delay / 1000);
+    tv.tv_usec = static_cast<suseconds_t>((delay % 1000) * 1000);
+    evtimer_add(m_reconnectEvent, &tv);
 }
 
 void ClientImpl::createPendingConnection(const std::string &hostname, const unsigned short port, int64_t time){
+    if (!m_ioLoops.empty()) {
+        IoLoop *loop = nextIoLoop(false);
+        loop->execute(boost::bind(&ClientImpl::createPendingConnection, loop->impl(), hostname, port, time));
+        return;
+    }
 
     logMessage(ClientLogger::DEBUG, "ClientImpl::createPendingConnection");
 
+    //the first attempt is made at once, later ones back off
     PendingConnectionSPtr pc(new PendingConnection(hostname, port, m_base, this));
     pc->m_startPending = time;
+    pc->m_reconnect = ReconnectState(get_monotonic_msec());
     {
         boost::mutex::scoped_lock lock(m_pendingConnectionLock);
         m_pendingConnectionList.push_back(pc);
         m_pendingConnectionSize.store(m_pendingConnectionList.size(), boost::memory_order_release);
     }
-
-    struct timeval tv;
-    tv.tv_sec = (time > 0)? RECONNECT_INTERVAL: 0;
-    tv.tv_usec = 0;
-
-    event_base_once(m_base, -1, EV_TIMEOUT, reconnectCallback, this, &tv);
+    scheduleReconnect();
 }
 
 
@@ -567,23 +1080,86 @@ private:
     InvocationResponse *m_responseOut;
 };
 
+/*
+ * Hands the response of a synchronous invocation made while I/O threads drive the
+ * connections back to the application thread waiting for it
+ */
+class BlockingCallback : public ProcedureCallback {
+public:
+    BlockingCallback() : m_done(false) {}
+
+    bool callback(InvocationResponse response) throw (voltdb::Exception) {
+        boost::mutex::scoped_lock lock(m_lock);
+        m_response = response;
+        m_done = true;
+        m_completed.notify_all();
+        return false;
+    }
+
+    void abandon(AbandonReason reason) {}
+
+    InvocationResponse wait() {
+        boost::mutex::scoped_lock lock(m_lock);
+        while (!m_done) {
+            m_completed.wait(lock);
+        }
+        return m_response;
+    }
+
+private:
+    boost::mutex m_lock;
+    boost::condition_variable m_completed;
+    bool m_done;
+    InvocationResponse m_response;
+};
+
 InvocationResponse ClientImpl::invoke(Procedure &proc) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException) {
-    if (m_bevs.empty()) {
+    return invoke(proc, 0);
+}
+
+InvocationResponse ClientImpl::invoke(Procedure &proc, int32_t timeoutMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException) {
+    if (!m_ioLoops.empty() || isForeignThread()) {
+        boost::shared_ptr<BlockingCallback> callback(new BlockingCallback());
+        // taken once there is a connection to send on, and kept across retries
+        int64_t notBeforeMicros = -1;
+        while (true) {
+            ClientImpl *target = this;
+            if (!m_ioLoops.empty()) {
+                target = nextIoLoop(true)->impl();
+            } else if (m_connectionCount == 0) {
+                throw voltdb::NoConnectionsException();
+            }
+            if (notBeforeMicros < 0) {
+                notBeforeMicros = reservePermit(proc.getName());
+            }
+            if (target->enqueueInvocation(proc, callback, timeoutMillis, 0, notBeforeMicros)) {
+                break;
+            }
+            boost::this_thread::yield();
+        }
+        return callback->wait();
+    }
+    if (m_connections.empty()) {
         throw voltdb::NoConnectionsException();
     }
-    int32_t messageSize = proc.getSerializedSize();
-    ScopedByteBuffer sbb(messageSize);
-    int64_t clientData = m_nextRequestId++;
-    proc.serializeTo(&sbb, clientData);
-    struct bufferevent *bev = m_bevs[m_nextConnectionIndex++ % m_bevs.size()];
+    const int64_t notBeforeMicros = reservePermit(proc.getName());
+    LoopThreadScope scope(this);
     InvocationResponse response;
     boost::shared_ptr<ProcedureCallback> callback(new SyncCallback(&response));
-    struct evbuffer *evbuf = bufferevent_get_output(bev);
-    if (evbuffer_add(evbuf, sbb.bytes(), static_cast<size_t>(sbb.remaining()))) {
-        throw voltdb::LibEventException();
+    if (notBeforeMicros > 0) {
+        QueuedInvocation invocation;
+        serializeInvocation(proc, callback, timeoutMillis, 0, notBeforeMicros, invocation);
+        m_outstandingRequests++;
+        deferInvocation(invocation);
+    } else {
+        int32_t messageSize = proc.getSerializedSize();
+        int64_t clientData = m_nextRequestId++;
+        ConnectionState *conn = static_cast<ConnectionState*>(m_connectionPolicy->select(false));
+        writeInvocation(conn, proc, messageSize, clientData);
+        m_outstandingRequests++;
+        trackRequest(clientData, conn, callback, messageSize);
+        scheduleTimeout(clientData, timeoutMillis);
     }
-    m_outstandingRequests++;
-    (*m_callbacks[bev])[clientData] = callback;
     if (event_base_dispatch(m_base) == -1) {
         throw voltdb::LibEventException();
     }
@@ -604,105 +1180,546 @@ public:
 };
 
 void ClientImpl::invoke(Procedure &proc, ProcedureCallback *callback) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException) {
+    invoke(proc, callback, 0);
+}
+
+void ClientImpl::invoke(Procedure &proc, ProcedureCallback *callback, int32_t timeoutMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException) {
     boost::shared_ptr<ProcedureCallback> wrapper(new DummyCallback(callback));
-    invoke(proc, wrapper);
+    invoke(proc, wrapper, timeoutMillis);
+}
+
+const TopologySnapshot &ClientImpl::currentTopology(){
+    if (m_distributer->version() != m_topology->version()) {
+        m_topology = m_distributer->snapshot();
+    }
+    return *m_topology;
+}
+
+bool ClientImpl::affinityRouting(const TopologySnapshot &topology, int64_t requests){
+    if (!m_useClientAffinity || !topology.hasTopology()) {
+        return false;
+    }
+    if (topology.isUpdating()) {
+        m_staleRoutedRequests += requests;
+    }
+    return true;
+}
+
+/*
+ * The procedure keeps its partitioning from one invocation to the next and has the offset of
+ * its partitioning parameter recorded as it is bound, so routing it again is a hash and a
+ * token lookup. The first invocation after the procedure information changes looks the
+ * procedure up and finds the parameter by walking the ones before it.
+ */
+ConnectionState *ClientImpl::routeProcedure(const TopologySnapshot &topology, Procedure &proc){
+    if (proc.m_routingOwner != m_distributer.get() || proc.m_routingVersion != topology.procedureVersion()) {
+        proc.m_routingInfo = topology.getProcedureHandle(proc.getName());
+        proc.m_routingOwner = m_distributer.get();
+        proc.m_routingVersion = topology.procedureVersion();
+        const ProcedureInfo *procInfo = proc.m_routingInfo.get();
+        proc.watchParameter(procInfo && !procInfo->m_multiPart ? procInfo->m_partitionParameter : -1);
+    }
+    const ProcedureInfo *procInfo = proc.m_routingInfo.get();
+    int hashedPartition = -1;
+    if (procInfo && !procInfo->m_multiPart) {
+        ByteBuffer params = proc.getParameterBuffer();
+        const int32_t offset = proc.watchedParameterOffset();
+        if (offset >= 0) {
+            hashedPartition = topology.getHashedPartitionAt(params, offset, procInfo->m_partitionParameterType);
+        } else {
+            hashedPartition = topology.getHashedPartitionForParameter(params, procInfo->m_partitionParameter, procInfo->m_partitionParameterType);
+        }
+    }
+    return routeToPartition(topology, procInfo, hashedPartition);
 }
 
-struct bufferevent *ClientImpl::routeProcedure(Procedure &proc, ScopedByteBuffer &sbb){
-    ProcedureInfo *procInfo = m_distributer.getProcedure(proc.getName());
+ConnectionState *ClientImpl::routeProcedure(const TopologySnapshot &topology, const std::string &name, ByteBuffer &params){
+    ProcedureInfo *procInfo = topology.getProcedure(name);
+    int hashedPartition = -1;
+    if (procInfo && !procInfo->m_multiPart){
+        hashedPartition = topology.getHashedPartitionForParameter(params, procInfo->m_partitionParameter, procInfo->m_partitionParameterType);
+    }
+    return routeToPartition(topology, procInfo, hashedPartition);
+}
 
+ConnectionState *ClientImpl::routeToPartition(const TopologySnapshot &topology, const ProcedureInfo *procInfo, int hashedPartition){
     //route transaction to correct event if procedure is found, transaction is single partitioned
     int hostId = -1;
     if (procInfo && !procInfo->m_multiPart){
-        const int hashedPartition = m_distributer.getHashedPartitionForParameter(sbb, procInfo->m_partitionParameter);
         if (hashedPartition >= 0) {
-            hostId = m_distributer.getHostIdByPartitionId(hashedPartition);
+            hostId = topology.getHostIdByPartitionId(hashedPartition);
         }
     }
     else
     {
         //use MIP partition instead
-        hostId = m_distributer.getHostIdByPartitionId(Distributer::MP_INIT_PID);
-    }
-    if (hostId >= 0) {
-        struct bufferevent *bev = m_hostIdToEvent[hostId];
-        return bev;
+        hostId = topology.getHostIdByPartitionId(Distributer::MP_INIT_PID);
+    }
+    if (hostId >= 0 && static_cast<size_t>(hostId) < m_hostPolicies.size() && m_hostPolicies[hostId]) {
+        //prefer a socket to the host without backpressure
+        ConnectionPolicy *policy = m_hostPolicies[hostId].get();
+        ConnectionLoad *load = policy->select(true);
+        if (load == NULL) {
+            load = policy->select(false);
+        }
+        return static_cast<ConnectionState*>(load);
     }
     return NULL;
 }
 
-
-void ClientImpl::invoke(Procedure &proc, boost::shared_ptr<ProcedureCallback> callback) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException) {
-    if (callback.get() == NULL) {
-        throw voltdb::NullPointerException();
+void ClientImpl::writeInvocation(ConnectionState *conn, Procedure &proc, int32_t messageSize, int64_t clientData) throw (voltdb::LibEventException) {
+    struct evbuffer *evbuf = bufferevent_get_output(conn->m_bev);
+    struct evbuffer_iovec extent;
+    if (evbuffer_reserve_space(evbuf, static_cast<ev_ssize_t>(messageSize), &extent, 1) != 1) {
+        throw voltdb::LibEventException();
     }
-    if (m_bevs.empty()) {
-        throw voltdb::NoConnectionsException();
+    ByteBuffer buffer(reinterpret_cast<char*>(extent.iov_base), messageSize);
+    proc.serializeTo(&buffer, clientData);
+    extent.iov_len = static_cast<size_t>(messageSize);
+    if (evbuffer_commit_space(evbuf, &extent, 1)) {
+        throw voltdb::LibEventException();
     }
+}
 
-    if (m_outstandingRequests >= m_maxOutstandingRequests) {
-    	if (m_listener.get() != NULL) {
-			try {
-				 m_listener->backpressure(true);
-			} catch (const std::exception& e) {
-				std::cerr << "Exception thrown on invocation of backpressure callback: " << e.what() << std::endl;
-			}
-		}
-    	// We are overloaded, we need to reject traffic and notify the caller
-        callback->abandon(ProcedureCallback::TOO_BUSY);
-        return;
+void ClientImpl::trackRequest(int64_t clientData, ConnectionState *conn, const boost::shared_ptr<ProcedureCallback> &callback,
+                              int32_t bytes) {
+    m_callbacks.insert(clientData, conn, callback, m_trackLatency ? get_monotonic_usec() : 0, bytes);
+    m_connectionPolicy->sent(*conn);
+    conn->m_outstandingBytes += bytes;
+    m_outstandingBytes += bytes;
+    conn->m_streamBytes += static_cast<uint64_t>(bytes);
+}
+
+bool ClientImpl::outstandingBytesExceeded() const {
+    return m_maxOutstandingBytes > 0 && outstandingBytes() >= m_maxOutstandingBytes;
+}
+
+void ClientImpl::adaptConcurrency(ConnectionState *conn, int64_t latencyMicros, bool timedOut) {
+    if (!conn->m_concurrency) {
+        return;
+    }
+    if (timedOut) {
+        conn->m_concurrency->timedOut();
+    } else {
+        conn->m_concurrency->completed(latencyMicros, conn->m_outstanding);
+    }
+    const int32_t limit = conn->m_concurrency->limit();
+    m_concurrencyLimit += limit - conn->m_limit;
+    conn->m_limit = limit;
+}
+
+void ClientImpl::checkBackpressure(ConnectionState *conn) {
+    if (evbuffer_get_length(bufferevent_get_output(conn->m_bev)) > m_backpressureThreshold) {
+        conn->m_backpressured = true;
+    }
+}
+
+void ClientImpl::scheduleTimeout(int64_t clientData, int32_t timeoutMillis) {
+    if (timeoutMillis <= 0) {
+        return;
+    }
+    if (m_timeouts.empty() && m_deadlines.empty()) {
+        struct timeval tick = { 0, TIMEOUT_TICK_MILLIS * 1000 };
+        event_add(m_timeoutEvent, &tick);
+    }
+    m_timeouts.schedule(clientData, get_monotonic_msec() + timeoutMillis);
+}
+
+/*
+ * Deadline frames that have started to be written can no longer be shed, so they are
+ * dropped from the front of the queue first. That keeps the queue to the requests buffered
+ * on the connection.
+ */
+void ClientImpl::scheduleDeadline(int64_t clientData, ConnectionState *conn, int32_t bytes, int64_t deadlineMillis) {
+    const uint64_t written = conn->writtenBytes();
+    while (!conn->m_unsentDeadlines.empty() && conn->m_unsentDeadlines.front().m_start < written) {
+        conn->m_unsentDeadlines.pop_front();
     }
+    DeadlineFrame frame = { clientData, conn->m_streamBytes - static_cast<uint64_t>(bytes), bytes };
+    conn->m_unsentDeadlines.push_back(frame);
+
+    if (m_timeouts.empty() && m_deadlines.empty()) {
+        struct timeval tick = { 0, TIMEOUT_TICK_MILLIS * 1000 };
+        event_add(m_timeoutEvent, &tick);
+    }
+    m_deadlines.schedule(clientData, deadlineMillis);
+}
+
+void ClientImpl::abandonPastDeadline(const boost::shared_ptr<ProcedureCallback> &callback) {
+    m_shedRequests++;
+    try {
+        callback->abandon(ProcedureCallback::DEADLINE_EXPIRED);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception thrown on abandoning a request past its deadline: " << e.what() << std::endl;
+    }
+}
 
+bool ClientImpl::shedRequest(const boost::shared_ptr<ProcedureCallback> &callback) {
+    bool breakEventLoop = false;
+    m_ignoreBackpressure = true;
+    abandonPastDeadline(callback);
+    m_ignoreBackpressure = false;
+    if (m_isDraining && m_outstandingRequests == 0) {
+        breakEventLoop = true;
+    }
+    return breakEventLoop;
+}
+
+/*
+ * An unsent request is cut out of the output buffer by moving the bytes ahead of it aside,
+ * dropping its own and putting the others back, which moves chains rather than copying
+ * them. The requests behind it move up in the stream by its length.
+ */
+bool ClientImpl::expireDeadline(int64_t clientData) {
+    ConnectionState *conn = m_callbacks.connection(clientData);
+    if (conn == NULL) {
+        return false;
+    }
+    const uint64_t written = conn->writtenBytes();
+    std::deque<DeadlineFrame> &frames = conn->m_unsentDeadlines;
+    while (!frames.empty() && frames.front().m_start < written) {
+        frames.pop_front();
+    }
+    std::deque<DeadlineFrame>::iterator frame = frames.begin();
+    while (frame != frames.end() && frame->m_clientData != clientData) {
+        ++frame;
+    }
+    if (frame == frames.end()) {
+        conn->m_lateRequests.insert(clientData);
+        return false;
+    }
+
+    struct evbuffer *evbuf = bufferevent_get_output(conn->m_bev);
+    struct evbuffer *ahead = evbuffer_new();
+    if (ahead == NULL) {
+        throw voltdb::LibEventException();
+    }
+    const size_t offset = static_cast<size_t>(frame->m_start - written);
+    const int32_t length = frame->m_length;
+    evbuffer_remove_buffer(evbuf, ahead, offset);
+    evbuffer_drain(evbuf, static_cast<size_t>(length));
+    evbuffer_prepend_buffer(evbuf, ahead);
+    evbuffer_free(ahead);
+    conn->m_streamBytes -= static_cast<uint64_t>(length);
+    for (std::deque<DeadlineFrame>::iterator i = frame + 1; i != frames.end(); ++i) {
+        i->m_start -= static_cast<uint64_t>(length);
+    }
+    frames.erase(frame);
+
+    int32_t bytes = 0;
+    boost::shared_ptr<ProcedureCallback> callback = m_callbacks.remove(clientData, NULL, NULL, &bytes);
+    m_outstandingRequests--;
+    conn->m_outstandingBytes -= bytes;
+    m_outstandingBytes -= bytes;
+    m_connectionPolicy->completed(*conn, -1);
+    return shedRequest(callback);
+}
+
+bool ClientImpl::invokeCallback(const boost::shared_ptr<ProcedureCallback> &callback, const InvocationResponse &response) {
+    bool breakEventLoop = false;
+    try {
+        m_ignoreBackpressure = true;
+        breakEventLoop |= callback->callback(response);
+        m_ignoreBackpressure = false;
+    } catch (std::exception &e) {
+        if (m_listener.get() != NULL) {
+            try {
+                m_ignoreBackpressure = true;
+                breakEventLoop |= m_listener->uncaughtException( e, callback, response);
+                m_ignoreBackpressure = false;
+            } catch (const std::exception& e) {
+                std::cerr << "Uncaught exception handler threw exception: " << e.what() << std::endl;
+            }
+        }
+    }
+    return breakEventLoop;
+}
+
+
+void ClientImpl::invoke(Procedure &proc, boost::shared_ptr<ProcedureCallback> callback) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException) {
+    invoke(proc, callback, 0);
+}
+
+void ClientImpl::invoke(Procedure &proc, boost::shared_ptr<ProcedureCallback> callback, int32_t timeoutMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException) {
+    invokeUntil(proc, callback, timeoutMillis, 0);
+}
+
+/*
+ * The deadline is moved onto the monotonic clock the event loop measures time with
+ */
+void ClientImpl::invokeWithDeadline(Procedure &proc, boost::shared_ptr<ProcedureCallback> callback, int64_t deadlineMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException) {
+    struct timeval tp;
+    gettimeofday(&tp, NULL);
+    const int64_t nowMillis = static_cast<int64_t>(tp.tv_sec) * 1000 + tp.tv_usec / 1000;
+    invokeUntil(proc, callback, 0, std::max(get_monotonic_msec() + deadlineMillis - nowMillis, static_cast<int64_t>(1)));
+}
+
+void ClientImpl::invokeUntil(Procedure &proc, const boost::shared_ptr<ProcedureCallback> &callback, int32_t timeoutMillis, int64_t deadlineMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException) {
+    if (callback.get() == NULL) {
+        throw voltdb::NullPointerException();
+    }
+    if (deadlineMillis > 0 && get_monotonic_msec() >= deadlineMillis) {
+        //another thread owns the loop state shedRequest touches
+        if (!m_ioLoops.empty() || isForeignThread()) {
+            abandonPastDeadline(callback);
+        } else {
+            shedRequest(callback);
+        }
+        return;
+    }
+    /*
+     * Requests made on a thread that is not running the event loop are handed over to
+     * the thread that is, either an I/O thread or the application thread inside run().
+     */
+    ClientImpl *target = NULL;
+    if (!m_ioLoops.empty()) {
+        target = nextIoLoop(true)->impl();
+    } else if (isForeignThread()) {
+        if (m_connectionCount == 0) {
+            throw voltdb::NoConnectionsException();
+        }
+        target = this;
+    } else if (m_connections.empty()) {
+        throw voltdb::NoConnectionsException();
+    }
+
+    if (outstandingRequests() >= concurrencyLimit() || outstandingBytesExceeded()) {
+        rejectTooBusy(callback);
+        return;
+    }
+
+    int64_t notBeforeMicros = reservePermit(proc.getName());
+    if (notBeforeMicros > 0 && m_rateLimitBlocking && target != NULL) {
+        // the event loop runs on another thread, so this one can simply sleep
+        const int64_t waitMicros = notBeforeMicros - get_monotonic_usec();
+        if (waitMicros > 0) {
+            boost::this_thread::sleep(boost::posix_time::microseconds(waitMicros));
+        }
+        notBeforeMicros = 0;
+    }
+
+    if (target != NULL) {
+        if (!target->enqueueInvocation(proc, callback, timeoutMillis, deadlineMillis, notBeforeMicros)) {
+            rejectTooBusy(callback);
+        }
+        return;
+    }
+
+    if (notBeforeMicros > 0) {
+        QueuedInvocation invocation;
+        serializeInvocation(proc, callback, timeoutMillis, deadlineMillis, notBeforeMicros, invocation);
+        m_outstandingRequests++;
+        deferInvocation(invocation);
+        if (m_rateLimitBlocking) {
+            waitForDeferred(notBeforeMicros);
+        }
+        return;
+    }
+
+    int32_t messageSize = proc.getSerializedSize();
+    ConnectionState *conn = nextConnection();
+    // waiting out backpressure may have used up the time the caller had
+    if (deadlineMillis > 0 && get_monotonic_msec() >= deadlineMillis) {
+        shedRequest(callback);
+        return;
+    }
+
+    // fetched after waiting out backpressure, whose callbacks may have replaced it
+    const TopologySnapshot &topology = currentTopology();
     //do not call the procedures if hashinator is in the LEGACY mode
-    if (!m_distributer.isUpdating() && !m_distributer.isElastic()) {
+    if (!topology.isUpdating() && !topology.isElastic()) {
         //todo: need to remove the connection
         throw voltdb::ElasticModeMismatchException();
     }
-
-    int32_t messageSize = proc.getSerializedSize();
-    ScopedByteBuffer sbb(messageSize);
     int64_t clientData = m_nextRequestId++;
-    proc.serializeTo(&sbb, clientData);
+
+    //route transaction to correct event if client affinity is enabled, with the last topology
+    //received if an update is in progress
+    //the host index is cleared when a connection is lost, so a routed connection is live
+    if (affinityRouting(topology, 1)) {
+        ConnectionState *routed = routeProcedure(topology, proc);
+        if (routed)
+            conn = routed;
+    }
+
+    writeInvocation(conn, proc, messageSize, clientData);
+    m_outstandingRequests++;
+    trackRequest(clientData, conn, callback, messageSize);
+    scheduleTimeout(clientData, timeoutMillis);
+    if (deadlineMillis > 0) {
+        scheduleDeadline(clientData, conn, messageSize, deadlineMillis);
+    }
+    checkBackpressure(conn);
+
+    return;
+}
+
+void ClientImpl::invokeBatch(std::vector<Procedure*> &procs, const std::vector<boost::shared_ptr<ProcedureCallback> > &callbacks) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException) {
+    if (procs.empty()) {
+        return;
+    }
+    if (callbacks.size() != 1 && callbacks.size() != procs.size()) {
+        throw voltdb::Exception();
+    }
+    for (size_t ii = 0; ii < callbacks.size(); ii++) {
+        if (callbacks[ii].get() == NULL) {
+            throw voltdb::NullPointerException();
+        }
+    }
+    const bool sharedCallback = callbacks.size() == 1;
+
+    // a batch holding rate limited procedures is paced one invocation at a time
+    if (!m_rateLimiters.empty()) {
+        for (size_t ii = 0; ii < procs.size(); ii++) {
+            if (m_rateLimiters.count(procs[ii]->getName()) > 0) {
+                for (size_t jj = 0; jj < procs.size(); jj++) {
+                    invokeUntil(*procs[jj], callbacks[sharedCallback ? 0 : jj], 0, 0);
+                }
+                return;
+            }
+        }
+    }
+
+    ClientImpl *target = NULL;
+    if (!m_ioLoops.empty()) {
+        target = nextIoLoop(true)->impl();
+    } else if (isForeignThread()) {
+        if (m_connectionCount == 0) {
+            throw voltdb::NoConnectionsException();
+        }
+        target = this;
+    } else if (m_connections.empty()) {
+        throw voltdb::NoConnectionsException();
+    }
 
     /*
-     * Decide what connection to buffer the event on.
-     * First each connection is checked for backpressure. If there is a connection
-     * with no backpressure break.
-     *
-     *  If none can be found, notify the client application and let it decide whether to queue anyways
-     *  or run the event loop until there is no more backpressure.
-     *
-     *  If queuing anyways just pick the next connection.
-     *
-     *  If waiting for no more backpressure, then set the m_invocationBlockedOnBackpressure flag
-     *  so that the write callback knows to break the event loop once there is a connection with no backpressure and
-     *  then enter the event loop.
-     *  It is possible for the event loop to break early while there is still backpressure because an unrelated callback
-     *  may have been invoked and that unrelated callback may have requested that the event loop be broken. In that
-     *  case just queue the request to the next connection despite backpressure so that loop break occurs as requested.
-     *  Also set the m_invocationBlockedOnBackpressure flag back to false so that the write callback won't spuriously
-     *  break the event loop later.
+     * Admit as much of the batch as fits under the outstanding request limit and reject
+     * the rest, rather than deciding request by request. Once the byte limit is reached
+     * nothing is admitted.
      */
-    struct bufferevent *bev = NULL;
+    const int32_t room = outstandingBytesExceeded() ? 0 : concurrencyLimit() - outstandingRequests();
+    const size_t admitted = room <= 0 ? 0 : std::min(procs.size(), static_cast<size_t>(room));
+    for (size_t ii = admitted; ii < procs.size(); ii++) {
+        if (ii == admitted) {
+            rejectTooBusy(callbacks[sharedCallback ? 0 : ii]);
+        } else {
+            callbacks[sharedCallback ? 0 : ii]->abandon(ProcedureCallback::TOO_BUSY);
+        }
+    }
+    if (admitted == 0) {
+        return;
+    }
+
+    if (target != NULL) {
+        for (size_t ii = 0; ii < admitted; ii++) {
+            if (!target->enqueueInvocation(*procs[ii], callbacks[sharedCallback ? 0 : ii], 0, 0, 0)) {
+                rejectTooBusy(callbacks[sharedCallback ? 0 : ii]);
+            }
+        }
+        return;
+    }
+
+    // sizing first means unbound parameters are reported before anything is written
+    std::vector<int32_t> sizes(admitted);
+    for (size_t ii = 0; ii < admitted; ii++) {
+        sizes[ii] = procs[ii]->getSerializedSize();
+    }
+
+    ConnectionState *conn = nextConnection();
+    const TopologySnapshot &topology = currentTopology();
+    if (!topology.isUpdating() && !topology.isElastic()) {
+        throw voltdb::ElasticModeMismatchException();
+    }
+    const bool route = affinityRouting(topology, static_cast<int64_t>(admitted));
+    std::vector<BatchGroup> groups;
+    for (size_t ii = 0; ii < admitted; ii++) {
+        ConnectionState *groupConn = conn;
+        if (route) {
+            ConnectionState *routed = routeProcedure(topology, *procs[ii]);
+            if (routed)
+                groupConn = routed;
+        }
+        size_t group = 0;
+        while (group < groups.size() && groups[group].m_conn != groupConn) {
+            group++;
+        }
+        if (group == groups.size()) {
+            groups.push_back(BatchGroup(groupConn));
+        }
+        groups[group].m_members.push_back(ii);
+        groups[group].m_bytes += sizes[ii];
+    }
+
+    for (size_t group = 0; group < groups.size(); group++) {
+        BatchGroup &batch = groups[group];
+        const int64_t firstClientData = m_nextRequestId;
+        writeInvocations(batch, procs, sizes, firstClientData);
+        m_nextRequestId += static_cast<int64_t>(batch.m_members.size());
+        m_outstandingRequests += static_cast<int32_t>(batch.m_members.size());
+        for (size_t ii = 0; ii < batch.m_members.size(); ii++) {
+            const size_t member = batch.m_members[ii];
+            trackRequest(firstClientData + static_cast<int64_t>(ii), batch.m_conn,
+                         callbacks[sharedCallback ? 0 : member], sizes[member]);
+        }
+        checkBackpressure(batch.m_conn);
+    }
+}
+
+/*
+ * Reserve room for the whole group in one extent and serialize its invocations back to back
+ */
+void ClientImpl::writeInvocations(const BatchGroup &batch, std::vector<Procedure*> &procs, const std::vector<int32_t> &sizes, int64_t firstClientData) throw (voltdb::LibEventException) {
+    struct evbuffer *evbuf = bufferevent_get_output(batch.m_conn->m_bev);
+    struct evbuffer_iovec extent;
+    if (evbuffer_reserve_space(evbuf, static_cast<ev_ssize_t>(batch.m_bytes), &extent, 1) != 1) {
+        throw voltdb::LibEventException();
+    }
+    char *position = reinterpret_cast<char*>(extent.iov_base);
+    for (size_t ii = 0; ii < batch.m_members.size(); ii++) {
+        const size_t member = batch.m_members[ii];
+        ByteBuffer buffer(position, sizes[member]);
+        procs[member]->serializeTo(&buffer, firstClientData + static_cast<int64_t>(ii));
+        position += sizes[member];
+    }
+    extent.iov_len = static_cast<size_t>(batch.m_bytes);
+    if (evbuffer_commit_space(evbuf, &extent, 1)) {
+        throw voltdb::LibEventException();
+    }
+}
+
+/*
+ * Decide what connection to buffer the event on.
+ * First each connection is checked for backpressure. If there is a connection
+ * with no backpressure break.
+ *
+ *  If none can be found, notify the client application and let it decide whether to queue anyways
+ *  or run the event loop until there is no more backpressure.
+ *
+ *  If queuing anyways just pick the next connection.
+ *
+ *  If waiting for no more backpressure, then set the m_invocationBlockedOnBackpressure flag
+ *  so that the write callback knows to break the event loop once there is a connection with no backpressure and
+ *  then enter the event loop.
+ *  It is possible for the event loop to break early while there is still backpressure because an unrelated callback
+ *  may have been invoked and that unrelated callback may have requested that the event loop be broken. In that
+ *  case just queue the request to the next connection despite backpressure so that loop break occurs as requested.
+ *  Also set the m_invocationBlockedOnBackpressure flag back to false so that the write callback won't spuriously
+ *  break the event loop later.
+ */
+ConnectionState *ClientImpl::nextConnection() throw (voltdb::LibEventException) {
+    ConnectionLoad *conn = NULL;
     while (true) {
         if (m_ignoreBackpressure) {
-            bev = m_bevs[++m_nextConnectionIndex % m_bevs.size()];
+            conn = m_connectionPolicy->select(false);
             break;
         }
 
-        //Assume backpressure if the number of outstanding requests is too large, i.e. leave bev == NULL
-        if (m_outstandingRequests <= m_maxOutstandingRequests) {
-            for (size_t ii = 0; ii < m_bevs.size(); ii++) {
-                bev = m_bevs[++m_nextConnectionIndex % m_bevs.size()];
-        	if (m_backpressuredBevs.find(bev) != m_backpressuredBevs.end()) {
-        	    bev = NULL;
-        	} else {
-        	    break;
-        	}
-            }
+        //Assume backpressure if the number or size of outstanding requests is too large, i.e. leave conn == NULL
+        if (m_outstandingRequests <= m_maxOutstandingRequests && !outstandingBytesExceeded()) {
+            conn = m_connectionPolicy->select(true);
 	}
 
-    	if (bev) {
+    	if (conn) {
     	    break;
     	} else {
     	    bool callEventLoop = true;
@@ -717,52 +1734,357 @@ void ClientImpl::invoke(Procedure &proc, boost::shared_ptr<ProcedureCallback> ca
     	    }
             if (callEventLoop) {
     	        m_invocationBlockedOnBackpressure = true;
+    	        LoopThreadScope scope(this);
     	        if (event_base_dispatch(m_base) == -1) {
     	            throw voltdb::LibEventException();
     	        }
     	        if (m_loopBreakRequested) {
     	            m_loopBreakRequested = false;
     	            m_invocationBlockedOnBackpressure = false;
-    	            bev = m_bevs[++m_nextConnectionIndex % m_bevs.size()];
+    	            conn = m_connectionPolicy->select(false);
     	        }
     	    } else {
-    	        bev = m_bevs[++m_nextConnectionIndex % m_bevs.size()];
+    	        conn = m_connectionPolicy->select(false);
     	        break;
             }
         }
     }
+    // the policy only holds the loads of this client's connections
+    return static_cast<ConnectionState*>(conn);
+}
 
-    //route transaction to correct event if client affinity is enabled and hashinator updating is not in progress
-    //elastic scalability is disabled
-    if (m_useClientAffinity && !m_distributer.isUpdating()) {
-        struct bufferevent *routed_bev = routeProcedure(proc, sbb);
-        // Check if the routed_bev is valid and has not been removed due to lost connection
-        if ((routed_bev) && (m_callbacks.find(routed_bev) != m_callbacks.end()))
-            bev = routed_bev;
+void ClientImpl::rejectTooBusy(const boost::shared_ptr<ProcedureCallback> &callback) {
+    if (m_listener.get() != NULL) {
+        try {
+            m_listener->backpressure(true);
+        } catch (const std::exception& e) {
+            std::cerr << "Exception thrown on invocation of backpressure callback: " << e.what() << std::endl;
+        }
     }
+    // We are overloaded, we need to reject traffic and notify the caller
+    callback->abandon(ProcedureCallback::TOO_BUSY);
+}
 
-    struct evbuffer *evbuf = bufferevent_get_output(bev);
-    if (evbuffer_add(evbuf, sbb.bytes(), static_cast<size_t>(sbb.remaining()))) {
-        throw voltdb::LibEventException();
-    }
+void ClientImpl::serializeInvocation(Procedure &proc, const boost::shared_ptr<ProcedureCallback> &callback, int32_t timeoutMillis,
+                                     int64_t deadlineMillis, int64_t notBeforeMicros, QueuedInvocation &invocation)
+throw (voltdb::Exception, voltdb::UninitializedParamsException) {
+    invocation.m_length = proc.getSerializedSize();
+    invocation.m_message.reset(new char[invocation.m_length]);
+    ByteBuffer buffer(invocation.m_message.get(), invocation.m_length);
+    proc.serializeTo(&buffer, 0);
+    invocation.m_procedureName = proc.getName();
+    invocation.m_clientDataOffset = 9 + static_cast<int32_t>(invocation.m_procedureName.size());
+    invocation.m_callback = callback;
+    invocation.m_timeoutMillis = timeoutMillis;
+    invocation.m_deadlineMillis = deadlineMillis;
+    invocation.m_notBeforeMicros = notBeforeMicros;
+}
+
+bool ClientImpl::enqueueInvocation(Procedure &proc, const boost::shared_ptr<ProcedureCallback> &callback, int32_t timeoutMillis,
+                                   int64_t deadlineMillis, int64_t notBeforeMicros)
+throw (voltdb::Exception, voltdb::UninitializedParamsException) {
+    QueuedInvocation invocation;
+    serializeInvocation(proc, callback, timeoutMillis, deadlineMillis, notBeforeMicros, invocation);
+
+    // counted before it is visible so the loop thread never sees the count go negative
     m_outstandingRequests++;
-    (*m_callbacks[bev])[clientData] = callback;
+    if (!m_submissions.push(invocation)) {
+        m_outstandingRequests--;
+        return false;
+    }
+    signalWakeup();
+    return true;
+}
 
-    if (evbuffer_get_length(evbuf) >  262144) {
-        m_backpressuredBevs.insert(bev);
+/*
+ * Only the first signal after the loop last woke up writes to the descriptor, the rest
+ * find the flag already set and rely on that wakeup to see their work.
+ */
+void ClientImpl::signalWakeup() {
+    if (m_wakeupPipe[1] == -1) {
+        return;
+    }
+    if (!m_wakeupPending.exchange(true)) {
+        const uint64_t one = 1;
+        ssize_t written = write(m_wakeupPipe[1], &one, sizeof one);
+        (void)written;
     }
+}
 
-    return;
+int64_t ClientImpl::reservePermit(const std::string &procedureName) {
+    if (m_rateLimiters.empty()) {
+        return 0;
+    }
+    std::map<std::string, boost::shared_ptr<TokenBucket> >::const_iterator bucket = m_rateLimiters.find(procedureName);
+    if (bucket == m_rateLimiters.end()) {
+        return 0;
+    }
+    const int64_t nowMicros = get_monotonic_usec();
+    int64_t availableMicros;
+    {
+        boost::mutex::scoped_lock lock(m_rateLimitLock);
+        availableMicros = bucket->second->reserve(nowMicros);
+    }
+    if (availableMicros <= nowMicros) {
+        return 0;
+    }
+    m_rateLimitedRequests++;
+    return availableMicros;
+}
+
+/*
+ * A deadline that passes before the permit is due cannot be met, so the invocation is shed
+ * rather than held
+ */
+void ClientImpl::deferInvocation(QueuedInvocation &invocation) {
+    if (invocation.m_deadlineMillis > 0 && invocation.m_deadlineMillis * 1000 <= invocation.m_notBeforeMicros) {
+        m_outstandingRequests--;
+        shedRequest(invocation.m_callback);
+        return;
+    }
+    const bool earliest = m_deferred.empty() || invocation.m_notBeforeMicros < m_deferred.begin()->first;
+    m_deferred.insert(std::make_pair(invocation.m_notBeforeMicros, invocation));
+    if (earliest) {
+        const int64_t waitMicros = std::max(invocation.m_notBeforeMicros - get_monotonic_usec(), static_cast<int64_t>(0));
+        struct timeval wait = { static_cast<time_t>(waitMicros / 1000000), static_cast<suseconds_t>(waitMicros % 1000000) };
+        event_add(m_deferredEvent, &wait);
+    }
+}
+
+void ClientImpl::deferredEventCallback() {
+    const int64_t nowMicros = get_monotonic_usec();
+    while (!m_deferred.empty() && m_deferred.begin()->first <= nowMicros) {
+        QueuedInvocation invocation = m_deferred.begin()->second;
+        m_deferred.erase(m_deferred.begin());
+        invocation.m_notBeforeMicros = 0;
+        sendQueued(invocation);
+    }
+    if (!m_deferred.empty()) {
+        const int64_t waitMicros = m_deferred.begin()->first - nowMicros;
+        struct timeval wait = { static_cast<time_t>(waitMicros / 1000000), static_cast<suseconds_t>(waitMicros % 1000000) };
+        event_add(m_deferredEvent, &wait);
+    }
+    // requests shed or failed while being sent may have been the last ones
+    if (m_isDraining && m_outstandingRequests == 0) {
+        event_base_loopbreak(m_base);
+    }
+}
+
+/*
+ * Invoked from a callback the loop is already running and cannot be entered again, so the
+ * invocation is left to be sent when its permit is due.
+ */
+void ClientImpl::waitForDeferred(int64_t sendMicros) throw (voltdb::LibEventException) {
+    if (m_loopRunning) {
+        return;
+    }
+    LoopThreadScope scope(this);
+    while (!m_deferred.empty() && m_deferred.begin()->first <= sendMicros) {
+        if (event_base_loop(m_base, EVLOOP_ONCE) == -1) {
+            throw voltdb::LibEventException();
+        }
+        if (event_base_got_break(m_base)) {
+            break;
+        }
+    }
+}
+
+void ClientImpl::drainSubmissions() {
+    QueuedInvocation invocation;
+    while (m_submissions.pop(invocation)) {
+        sendQueued(invocation);
+    }
+}
+
+/*
+ * Send an invocation another thread serialized with a placeholder client data. There is
+ * no application thread to block here, so backpressured connections are only avoided,
+ * not waited out.
+ */
+void ClientImpl::sendQueued(QueuedInvocation &invocation) {
+    if (m_connections.empty()) {
+        m_outstandingRequests--;
+        invokeCallback(invocation.m_callback, InvocationResponse());
+        return;
+    }
+    if (invocation.m_deadlineMillis > 0 && get_monotonic_msec() >= invocation.m_deadlineMillis) {
+        m_outstandingRequests--;
+        shedRequest(invocation.m_callback);
+        return;
+    }
+    if (invocation.m_notBeforeMicros > 0 && invocation.m_notBeforeMicros > get_monotonic_usec()) {
+        deferInvocation(invocation);
+        return;
+    }
+
+    const int64_t clientData = m_nextRequestId++;
+    ByteBuffer message(invocation.m_message.get(), invocation.m_length);
+    message.putInt64(invocation.m_clientDataOffset, clientData);
+
+    ConnectionLoad *load = m_connectionPolicy->select(true);
+    if (load == NULL) {
+        load = m_connectionPolicy->select(false);
+    }
+    ConnectionState *conn = static_cast<ConnectionState*>(load);
+
+    const TopologySnapshot &topology = currentTopology();
+    if (affinityRouting(topology, 1)) {
+        const int32_t paramsOffset = invocation.m_clientDataOffset + 8;
+        ByteBuffer params(invocation.m_message.get() + paramsOffset, invocation.m_length - paramsOffset);
+        ConnectionState *routed = routeProcedure(topology, invocation.m_procedureName, params);
+        if (routed)
+            conn = routed;
+    }
+
+    struct evbuffer *evbuf = bufferevent_get_output(conn->m_bev);
+    if (evbuffer_add(evbuf, invocation.m_message.get(), static_cast<size_t>(invocation.m_length))) {
+        m_outstandingRequests--;
+        invokeCallback(invocation.m_callback, InvocationResponse());
+        return;
+    }
+    trackRequest(clientData, conn, invocation.m_callback, invocation.m_length);
+    scheduleTimeout(clientData, invocation.m_timeoutMillis);
+    if (invocation.m_deadlineMillis > 0) {
+        scheduleDeadline(clientData, conn, invocation.m_length, invocation.m_deadlineMillis);
+    }
+    checkBackpressure(conn);
+}
+
+/*
+ * Unless connections are taken round robin, the I/O thread with the fewest requests in
+ * flight gets the invocation and its own policy picks among its connections.
+ */
+IoLoop *ClientImpl::nextIoLoop(bool requireConnection) throw (voltdb::NoConnectionsException) {
+    const size_t start = m_nextIoLoopIndex++;
+    IoLoop *best = NULL;
+    int32_t bestOutstanding = 0;
+    for (size_t ii = 0; ii < m_ioLoops.size(); ii++) {
+        IoLoop *loop = m_ioLoops[(start + ii) % m_ioLoops.size()].get();
+        if (requireConnection && loop->connectionCount() == 0) {
+            continue;
+        }
+        if (m_connectionSelection == SELECT_ROUND_ROBIN) {
+            return loop;
+        }
+        const int32_t outstanding = loop->outstandingRequests();
+        if (best == NULL || outstanding < bestOutstanding) {
+            best = loop;
+            bestOutstanding = outstanding;
+        }
+    }
+    if (best == NULL) {
+        throw voltdb::NoConnectionsException();
+    }
+    return best;
+}
+
+bool ClientImpl::ioLoopsHaveConnections() const {
+    for (size_t ii = 0; ii < m_ioLoops.size(); ii++) {
+        if (m_ioLoops[ii]->connectionCount() > 0 || m_ioLoops[ii]->pendingConnectionCount() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int32_t ClientImpl::outstandingRequests() const {
+    int32_t outstanding = m_outstandingRequests;
+    for (size_t ii = 0; ii < m_ioLoops.size(); ii++) {
+        outstanding += m_ioLoops[ii]->outstandingRequests();
+    }
+    return outstanding;
+}
+
+int32_t ClientImpl::concurrencyLimit() const {
+    if (!m_adaptiveConcurrency) {
+        return m_maxOutstandingRequests;
+    }
+    int64_t limit = m_concurrencyLimit;
+    for (size_t ii = 0; ii < m_ioLoops.size(); ii++) {
+        limit += m_ioLoops[ii]->concurrencyLimit();
+    }
+    return static_cast<int32_t>(std::min(limit, static_cast<int64_t>(m_maxOutstandingRequests)));
+}
+
+int64_t ClientImpl::outstandingBytes() const {
+    int64_t outstanding = m_outstandingBytes;
+    for (size_t ii = 0; ii < m_ioLoops.size(); ii++) {
+        outstanding += m_ioLoops[ii]->outstandingBytes();
+    }
+    return outstanding;
+}
+
+ClientStats ClientImpl::getStats() const {
+    ClientStats stats;
+    stats.m_staleRoutedRequests = m_staleRoutedRequests;
+    stats.m_shedRequests = m_shedRequests;
+    stats.m_lateResponses = m_lateResponses;
+    stats.m_rateLimitedRequests = m_rateLimitedRequests;
+    for (size_t ii = 0; ii < m_ioLoops.size(); ii++) {
+        const ClientStats loopStats = m_ioLoops[ii]->impl()->getStats();
+        stats.m_staleRoutedRequests += loopStats.m_staleRoutedRequests;
+        stats.m_shedRequests += loopStats.m_shedRequests;
+        stats.m_lateResponses += loopStats.m_lateResponses;
+    }
+    stats.m_concurrencyLimit = concurrencyLimit();
+    return stats;
+}
+
+InvocationFuture ClientImpl::invokeAsync(Procedure &proc, int32_t timeoutMillis) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::UninitializedParamsException, voltdb::LibEventException, voltdb::ElasticModeMismatchException) {
+    FutureState *state = m_futures->acquire(this);
+    InvocationFuture future(state);
+    try {
+        invoke(proc, state->asCallback(), timeoutMillis);
+    } catch (...) {
+        // the request was never registered, so its completion will never come
+        state->release();
+        throw;
+    }
+    return future;
+}
+
+/*
+ * Only the awaited future breaks the loop, other callbacks asking for a break are ignored
+ * until it completes.
+ */
+void ClientImpl::waitFor(FutureState &state) throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException) {
+    if (!m_ioLoops.empty() || isForeignThread()) {
+        state.wait();
+        return;
+    }
+
+    LoopThreadScope scope(this);
+    state.setWaiting(true);
+    while (!state.ready()) {
+        if (m_connections.empty()) {
+            state.setWaiting(false);
+            throw voltdb::NoConnectionsException();
+        }
+        if (event_base_dispatch(m_base) == -1) {
+            state.setWaiting(false);
+            throw voltdb::LibEventException();
+        }
+    }
+    state.setWaiting(false);
+    m_loopBreakRequested = false;
 }
 
 void ClientImpl::runOnce() throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException) {
 
     logMessage(ClientLogger::DEBUG, "ClientImpl::runOnce");
 
-    if (m_bevs.empty() && m_pendingConnectionSize.load(boost::memory_order_consume) <= 0) {
+    if (!m_ioLoops.empty()) {
+        if (!ioLoopsHaveConnections()) {
+            throw voltdb::NoConnectionsException();
+        }
+        return;
+    }
+
+    if (m_connections.empty() && m_pendingConnectionSize.load(boost::memory_order_consume) <= 0 && m_connectingCount == 0) {
         throw voltdb::NoConnectionsException();
     }
 
+    LoopThreadScope scope(this);
     if (event_base_loop(m_base, EVLOOP_NONBLOCK) == -1) {
         throw voltdb::LibEventException();
     }
@@ -773,9 +2095,22 @@ void ClientImpl::run() throw (voltdb::Exception, voltdb::NoConnectionsException,
 
     logMessage(ClientLogger::DEBUG, "ClientImpl::run");
 
-    if (m_bevs.empty() && m_pendingConnectionSize.load(boost::memory_order_consume) <= 0) {
+    if (!m_ioLoops.empty()) {
+        if (!ioLoopsHaveConnections()) {
+            throw voltdb::NoConnectionsException();
+        }
+        boost::mutex::scoped_lock lock(m_runLock);
+        while (!m_runWakeRequested) {
+            m_runWake.wait(lock);
+        }
+        m_runWakeRequested = false;
+        return;
+    }
+
+    if (m_connections.empty() && m_pendingConnectionSize.load(boost::memory_order_consume) <= 0 && m_connectingCount == 0) {
         throw voltdb::NoConnectionsException();
     }
+    LoopThreadScope scope(this);
     if (event_base_dispatch(m_base) == -1) {
         throw voltdb::LibEventException();
     }
@@ -783,75 +2118,166 @@ void ClientImpl::run() throw (voltdb::Exception, voltdb::NoConnectionsException,
     m_loopBreakRequested = false;
 }
 
-void ClientImpl::regularReadCallback(struct bufferevent *bev) {
+/*
+ * Responses are decoded where libevent read them. Complete frames are found by peeking
+ * at the length prefixes, then the chains holding them are moved into a chunk that every
+ * response in this pass shares by reference. Only a frame that straddles two chains, or
+ * the partial frame left at the tail, is copied.
+ */
+void ClientImpl::regularReadCallback(ConnectionState *conn) {
+    struct bufferevent *bev = conn->m_bev;
     struct evbuffer *evbuf = bufferevent_get_input(bev);
-    boost::shared_ptr<CxnContext> context = m_contexts[bev];
-    int32_t remaining = static_cast<int32_t>(evbuffer_get_length(evbuf));
+    const size_t available = evbuffer_get_length(evbuf);
     bool breakEventLoop = false;
 
-    if (context->m_lengthOrMessage && remaining < 4) {
+    size_t framed = 0;
+    size_t nextFrame = 4;
+    int32_t frameCount = 0;
+    {
+        ChainCursor cursor(evbuf);
+        while (available - framed >= 4) {
+            int32_t length = cursor.readLength();
+            assert(length >= 0);
+            if (available - framed - 4 < static_cast<size_t>(length)) {
+                nextFrame = 4 + static_cast<size_t>(length);
+                break;
+            }
+            cursor.skip(static_cast<size_t>(length));
+            framed += 4 + static_cast<size_t>(length);
+            frameCount++;
+        }
+    }
+
+    if (frameCount == 0) {
+        bufferevent_setwatermark( bev, EV_READ, nextFrame, std::max(nextFrame, m_readHighWatermark));
+        breakEventLoop |= (m_loopBreakRequested && (m_outstandingRequests <= m_maxOutstandingRequests));
+        if (breakEventLoop) {
+            event_base_loopbreak( m_base );
+        }
         return;
     }
 
-    while (true) {
-        if (context->m_lengthOrMessage && remaining >= 4) {
-            char lengthBytes[4];
-            ByteBuffer lengthBuffer(lengthBytes, 4);
-            evbuffer_remove( evbuf, lengthBytes, 4);
-            context->m_nextLength = static_cast<size_t>(lengthBuffer.getInt32());
-            context->m_lengthOrMessage = false;
-            remaining -= 4;
-        } else if (remaining >= context->m_nextLength) {
-            boost::shared_array<char> messageBytes = boost::shared_array<char>(new char[context->m_nextLength]);
-            context->m_lengthOrMessage = true;
-            evbuffer_remove( evbuf, messageBytes.get(), static_cast<size_t>(context->m_nextLength));
-            remaining -= context->m_nextLength;
-            InvocationResponse response(messageBytes, context->m_nextLength);
-            boost::shared_ptr<CallbackMap> callbackMap = m_callbacks[bev];
-            CallbackMap::iterator i = callbackMap->find(response.clientData());
-            if(i != callbackMap->end()){
-                try {
-                    m_ignoreBackpressure = true;
-                    breakEventLoop |= i->second->callback(response);
-                    m_ignoreBackpressure = false;
-                } catch (std::exception &e) {
-                    if (m_listener.get() != NULL) {
-                        try {
-                            m_ignoreBackpressure = true;
-                            breakEventLoop |= m_listener->uncaughtException( e, i->second, response);
-                            m_ignoreBackpressure = false;
-                        } catch (const std::exception& e) {
-                            std::cerr << "Uncaught exception handler threw exception: " << e.what() << std::endl;
-                        }
-                    }
+    /*
+     * Take the chains rather than the bytes. A short tail is cheaper to copy back than
+     * the frames sharing its chain, a long one (the head of a large response) is not.
+     */
+    struct evbuffer *chunk = evbuffer_new();
+    if (chunk == NULL) {
+        throw voltdb::LibEventException();
+    }
+    const size_t tail = available - framed;
+    if (tail <= MAX_TAIL_COPY) {
+        evbuffer_add_buffer(chunk, evbuf);
+        if (tail > 0) {
+            char tailBytes[MAX_TAIL_COPY];
+            ChainCursor cursor(chunk);
+            cursor.skip(framed);
+            cursor.copyOut(tailBytes, tail);
+            evbuffer_prepend(evbuf, tailBytes, tail);
+        }
+    } else {
+        evbuffer_remove_buffer(evbuf, chunk, framed);
+    }
+    bufferevent_setwatermark( bev, EV_READ, nextFrame, std::max(nextFrame, m_readHighWatermark));
+
+    const size_t chunkLength = evbuffer_get_length(chunk);
+    ChainCursor cursor(chunk);
+    boost::shared_ptr<void> chunkOwner(chunk, evbuffer_free);
+    // one clock read covers every response in this read
+    const bool trackLatency = m_trackLatency;
+    int64_t nowMicros = 0;
+    for (int32_t frame = 0; frame < frameCount; frame++) {
+        const int32_t length = cursor.readLength();
+        char *data = NULL;
+        if (decodeInPlace(static_cast<size_t>(length), chunkLength)) {
+            data = cursor.contiguous(static_cast<size_t>(length));
+        }
+        boost::shared_array<char> copy;
+        if (data == NULL) {
+            copy.reset(new char[length]);
+            cursor.copyOut(copy.get(), static_cast<size_t>(length));
+        }
+        InvocationResponse response = data == NULL ?
+                InvocationResponse(copy, length) : InvocationResponse(chunkOwner, data, length);
+        /*
+         * When Volt sends us out a notification, it comes with the ClientData
+         * filled in with a known 64-bit number. The table keeps that callback in
+         * a dedicated slot so it continues to process notifications.
+         */
+        int64_t sentMicros = 0;
+        int32_t bytes = 0;
+        boost::shared_ptr<ProcedureCallback> callback = m_callbacks.remove(response.clientData(), NULL, &sentMicros, &bytes);
+        if (callback.get() != NULL) {
+            // count the request as complete before its callback can release a waiting thread
+            if(response.clientData() != VOLT_NOTIFICATION_MAGIC_NUMBER){
+                m_outstandingRequests--;
+                conn->m_outstandingBytes -= bytes;
+                m_outstandingBytes -= bytes;
+                if (trackLatency && nowMicros == 0) {
+                    nowMicros = get_monotonic_usec();
                 }
-                /*
-                 * When Volt sends us out a notification, it comes with the ClientData
-                 * filled in with a known 64-bit number.
-                 * In this case, we don't want to remove the callback. We need a static
-                 * callback here to continually process notifications.
-                 */
-                if(response.clientData() != VOLT_NOTIFICATION_MAGIC_NUMBER){
-                    callbackMap->erase(i);
-                    m_outstandingRequests--;
+                adaptConcurrency(conn, nowMicros - sentMicros, false);
+                m_connectionPolicy->completed(*conn, trackLatency ? nowMicros - sentMicros : -1);
+                if (!conn->m_lateRequests.empty() && conn->m_lateRequests.erase(response.clientData()) > 0) {
+                    m_lateResponses++;
                 }
             }
+            breakEventLoop |= invokeCallback(callback, response);
+        }
 
-            //If the client is draining and it just drained the last request, break the loop
-            if (m_isDraining && m_outstandingRequests == 0) {
-                breakEventLoop = true;
-            } else if (m_loopBreakRequested && (m_outstandingRequests <= m_maxOutstandingRequests)) {
-                // ignore break requested until we have too many outstanding requests
-                breakEventLoop = true;
-            }
-        } else {
-            if (context->m_lengthOrMessage) {
-                bufferevent_setwatermark( bev, EV_READ, 4, HIGH_WATERMARK);
-            } else {
-                bufferevent_setwatermark( bev, EV_READ, static_cast<size_t>(context->m_nextLength), HIGH_WATERMARK);
-            }
-            breakEventLoop |= (m_loopBreakRequested && (m_outstandingRequests <= m_maxOutstandingRequests));
-            break;
+        //If the client is draining and it just drained the last request, break the loop
+        if (m_isDraining && m_outstandingRequests == 0) {
+            breakEventLoop = true;
+        } else if (m_loopBreakRequested && (m_outstandingRequests <= m_maxOutstandingRequests)) {
+            // ignore break requested until we have too many outstanding requests
+            breakEventLoop = true;
+        }
+    }
+    breakEventLoop |= (m_loopBreakRequested && (m_outstandingRequests <= m_maxOutstandingRequests));
+
+    if (breakEventLoop) {
+        event_base_loopbreak( m_base );
+    }
+}
+/*
+ * Fires every tick while any request timer is armed. Timers for requests that have
+ * already completed are no longer in the callback table and are skipped.
+ */
+void ClientImpl::timeoutEventCallback() {
+    std::vector<int64_t> expired;
+    std::vector<int64_t> pastDeadline;
+    const int64_t nowMillis = get_monotonic_msec();
+    m_timeouts.expire(nowMillis, expired);
+    m_deadlines.expire(nowMillis, pastDeadline);
+    if (m_timeouts.empty() && m_deadlines.empty()) {
+        event_del(m_timeoutEvent);
+    }
+
+    bool breakEventLoop = false;
+    for (std::vector<int64_t>::iterator i = pastDeadline.begin(); i != pastDeadline.end(); ++i) {
+        breakEventLoop |= expireDeadline(*i);
+    }
+    const bool trackLatency = m_trackLatency;
+    const int64_t nowMicros = trackLatency ? get_monotonic_usec() : 0;
+    for (std::vector<int64_t>::iterator i = expired.begin(); i != expired.end(); ++i) {
+        ConnectionState *conn = NULL;
+        int64_t sentMicros = 0;
+        int32_t bytes = 0;
+        boost::shared_ptr<ProcedureCallback> callback = m_callbacks.remove(*i, &conn, &sentMicros, &bytes);
+        if (callback.get() == NULL) {
+            continue;
+        }
+        InvocationResponse response(*i, STATUS_CODE_CONNECTION_TIMEOUT, "No response received in the allotted time");
+        m_outstandingRequests--;
+        conn->m_outstandingBytes -= bytes;
+        m_outstandingBytes -= bytes;
+        // a timed out request counts against its connection's response time and limit
+        adaptConcurrency(conn, nowMicros - sentMicros, true);
+        m_connectionPolicy->completed(*conn, trackLatency ? nowMicros - sentMicros : -1);
+        breakEventLoop |= invokeCallback(callback, response);
+
+        if (m_isDraining && m_outstandingRequests == 0) {
+            breakEventLoop = true;
         }
     }
 
@@ -859,14 +2285,15 @@ void ClientImpl::regularReadCallback(struct bufferevent *bev) {
         event_base_loopbreak( m_base );
     }
 }
-void ClientImpl::regularEventCallback(struct bufferevent *bev, short events) {
+
+void ClientImpl::regularEventCallback(ConnectionState *conn, short events) {
     if (events & BEV_EVENT_CONNECTED) {
         assert(false);
     } else if (events & (BEV_EVENT_ERROR | BEV_EVENT_EOF)) {
         /*
          * First drain anything in the read buffer
          */
-        regularReadCallback(bev);
+        regularReadCallback(conn);
 
         bool breakEventLoop = false;
 
@@ -875,13 +2302,45 @@ void ClientImpl::regularEventCallback(struct bufferevent *bev, short events) {
     	ss << "connectionLost: " << s_error;
     	logMessage(ClientLogger::ERROR, ss.str());
 
+        /*
+         * Take the connection out of the host index, the policy and the connection list
+         * before any application code runs, so that requests retried from the callbacks
+         * below can't be registered on it. Its state lives until the end of this call and
+         * its bufferevent is freed last.
+         */
+        boost::shared_ptr<ConnectionState> lostConnection;
+        if (conn->m_hostId >= 0 && static_cast<size_t>(conn->m_hostId) < m_hostPolicies.size() &&
+                m_hostPolicies[conn->m_hostId]) {
+            m_hostPolicies[conn->m_hostId]->removeConnection(conn);
+        }
+        m_connectionPolicy->removeConnection(conn);
+        for (std::vector<boost::shared_ptr<ConnectionState> >::iterator i = m_connections.begin(); i != m_connections.end(); ++i) {
+            if (i->get() == conn) {
+                lostConnection = *i;
+                m_connections.erase(i);
+                m_connectionCount = static_cast<int32_t>(m_connections.size());
+                break;
+            }
+        }
+
+        //Reset cluster Id as no more connections left
+        if (m_connections.empty())
+            m_instanceIdIsSet = false;
+
+        std::vector<CallbackTable::Registration> lost;
+        m_callbacks.removeConnection(conn, lost);
+        m_outstandingBytes -= conn->m_outstandingBytes;
+        conn->m_outstandingBytes = 0;
+        m_concurrencyLimit -= conn->m_limit;
+
         //Notify client that a connection was lost
         if (m_listener.get() != NULL) {
             try {
                 m_ignoreBackpressure = true;
-                breakEventLoop |= m_listener->connectionLost( m_contexts[bev]->m_name, m_bevs.size() - 1);
+                breakEventLoop |= m_listener->connectionLost( conn->m_name, m_connections.size());
                 m_ignoreBackpressure = false;
             } catch (const std::exception& e) {
+                m_ignoreBackpressure = false;
                 std::cerr << "Status listener threw exception on connection lost: " << e.what() << std::endl;
             }
         }
@@ -889,10 +2348,9 @@ void ClientImpl::regularEventCallback(struct bufferevent *bev, short events) {
          * Iterate the list of callbacks for this connection and invoke them
          * with the appropriate error response
          */
-        BEVToCallbackMap::iterator callbackMapIter = m_callbacks.find(bev);
-        boost::shared_ptr<CallbackMap> callbackMap = callbackMapIter->second;
-        for (CallbackMap::iterator i =  callbackMap->begin();
-                i != callbackMap->end(); ++i) {
+        for (std::vector<CallbackTable::Registration>::iterator i = lost.begin();
+                i != lost.end(); ++i) {
+            m_outstandingRequests--;
             try {
                 breakEventLoop |=
                         i->second->callback(InvocationResponse());
@@ -901,52 +2359,28 @@ void ClientImpl::regularEventCallback(struct bufferevent *bev, short events) {
                     breakEventLoop |= m_listener->uncaughtException( e, i->second, InvocationResponse());
                 }
             }
-            m_outstandingRequests--;
         }
 
         if (m_isDraining && m_outstandingRequests == 0) {
             breakEventLoop = true;
         }
 
-        //Remove the callback map from the callbacks map
-        m_callbacks.erase(callbackMapIter);
-
-        //remove the entry for the backpressured connection set
-        m_backpressuredBevs.erase(bev);
-        createPendingConnection(m_contexts[bev]->m_name, m_contexts[bev]->m_port, get_sec_time());
-
-        //Remove the connection context
-        m_contexts.erase(bev);
-
-        for (std::vector<struct bufferevent *>::iterator i = m_bevs.begin(); i != m_bevs.end(); ++i) {
-            if (*i == bev) {
-                m_bevs.erase(i);
-                break;
-            }
-        }
-
-        bufferevent_free(bev);
-        //Reset cluster Id as no more connections left
-        if (m_bevs.empty())
-            m_instanceIdIsSet = false;
+        createPendingConnection(conn->m_name, conn->m_port, get_sec_time());
+        bufferevent_free(conn->m_bev);
 
-        if (breakEventLoop || m_bevs.size() == 0) {
+        if (breakEventLoop || m_connections.size() == 0) {
             event_base_loopbreak( m_base );
         }
 
         //update topology info and procedures info
-        if (m_useClientAffinity && m_bevs.size() > 0) {
+        if (m_useClientAffinity && m_connections.size() > 0) {
             updateHashinator();
         }
     }
 }
 
-void ClientImpl::regularWriteCallback(struct bufferevent *bev) {
-    std::set<struct bufferevent*>::iterator iter =
-            m_backpressuredBevs.find(bev);
-    if (iter != m_backpressuredBevs.end()) {
-        m_backpressuredBevs.erase(iter);
-    }
+void ClientImpl::regularWriteCallback(ConnectionState *conn) {
+    conn->m_backpressured = false;
     if (m_invocationBlockedOnBackpressure) {
         m_invocationBlockedOnBackpressure = false;
         event_base_loopbreak(m_base);
@@ -963,6 +2397,10 @@ void ClientImpl::eventBaseLoopBreak() {
 }
 
 void ClientImpl::interrupt() {
+    if (!m_ioLoops.empty()) {
+        wakeup();
+        return;
+    }
     event_base_once(m_base, -1, EV_TIMEOUT, interrupt_callback, this, NULL);
 }
 
@@ -972,6 +2410,17 @@ void ClientImpl::interrupt() {
  * @throws LibEventException An unknown error occured in libevent
  */
 bool ClientImpl::drain() throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException) {
+    if (!m_ioLoops.empty()) {
+        if (outstandingRequests() > 0 && !ioLoopsHaveConnections()) {
+            throw voltdb::NoConnectionsException();
+        }
+        boost::mutex::scoped_lock lock(m_runLock);
+        while (outstandingRequests() > 0 && !m_runWakeRequested) {
+            m_runWake.timed_wait(lock, boost::posix_time::milliseconds(1));
+        }
+        m_runWakeRequested = false;
+        return outstandingRequests() == 0;
+    }
     if (m_outstandingRequests > 0) {
         m_isDraining = true;
         run();
@@ -992,11 +2441,16 @@ public:
     {
         if (response.failure()){
             //TODO:log
+            m_dist->abortUpdate();
             return false;
         }
         m_dist->updateAffinityTopology(response.results());
         return true;
     }
+    // a fetch that never gets a response must not leave the update open either
+    void abandon(AbandonReason reason) {
+        m_dist->abortUpdate();
+    }
  private:
     Distributer *m_dist;
 };
@@ -1043,14 +2497,14 @@ public:
 
 
 void ClientImpl::updateHashinator(){
-    m_distributer.startUpdate();
+    m_distributer->startUpdate();
     std::vector<voltdb::Parameter> parameterTypes(1);
     parameterTypes[0] = voltdb::Parameter(voltdb::WIRE_TYPE_STRING);
     voltdb::Procedure systemCatalogProc("@SystemCatalog", parameterTypes);
     voltdb::ParameterSet* params = systemCatalogProc.params();
     params->addString("PROCEDURES");
 
-    boost::shared_ptr<ProcUpdateCallback> procCallback(new ProcUpdateCallback(&m_distributer));
+    boost::shared_ptr<ProcUpdateCallback> procCallback(new ProcUpdateCallback(m_distributer.get()));
     invoke(systemCatalogProc, procCallback);
 
     parameterTypes.resize(2);
@@ -1061,7 +2515,7 @@ void ClientImpl::updateHashinator(){
     params = statisticsProc.params();
     params->addString("TOPO").addInt32(0);
 
-    boost::shared_ptr<TopoUpdateCallback> topoCallback(new TopoUpdateCallback(&m_distributer));
+    boost::shared_ptr<TopoUpdateCallback> topoCallback(new TopoUpdateCallback(m_distributer.get()));
 
     invoke(statisticsProc, topoCallback);
 }
@@ -1074,13 +2528,119 @@ void ClientImpl::subscribeToTopologyNotifications(){
     voltdb::ParameterSet* params = statisticsProc.params();
     params->addString("TOPOLOGY");
 
-    boost::shared_ptr<SubscribeCallback> topoCallback(new SubscribeCallback(&m_distributer));
+    boost::shared_ptr<SubscribeCallback> topoCallback(new SubscribeCallback(m_distributer.get()));
 
     invoke(statisticsProc, topoCallback);
 }
 
+/*
+ * Callback for ("@SystemInformation", "OVERVIEW")
+ */
+class HostDiscoveryCallback : public voltdb::ProcedureCallback
+{
+public:
+    HostDiscoveryCallback(ClientImpl *client):m_client(client){}
+    bool callback(InvocationResponse response) throw (voltdb::Exception)
+    {
+        m_client->connectDiscoveredHosts(response);
+        return false;
+    }
+
+    void abandon(AbandonReason reason) {
+        m_client->m_discoveryInFlight = false;
+    }
+
+ private:
+    ClientImpl *m_client;
+};
+
+void ClientImpl::discoverHosts(){
+    if (!m_discoverHosts || m_discoveryInFlight || m_connections.empty()) {
+        return;
+    }
+    m_discoveryInFlight = true;
+    std::vector<voltdb::Parameter> parameterTypes(1);
+    parameterTypes[0] = voltdb::Parameter(voltdb::WIRE_TYPE_STRING);
+    voltdb::Procedure systemInformationProc("@SystemInformation", parameterTypes);
+    voltdb::ParameterSet* params = systemInformationProc.params();
+    params->addString("OVERVIEW");
+
+    boost::shared_ptr<HostDiscoveryCallback> discoveryCallback(new HostDiscoveryCallback(this));
+    try {
+        invoke(systemInformationProc, discoveryCallback);
+    } catch (const std::exception& e) {
+        m_discoveryInFlight = false;
+        throw;
+    }
+}
+
+void ClientImpl::connectDiscoveredHosts(const InvocationResponse &response){
+//    HOST_ID, KEY,        VALUE
+//    0,       IPADDRESS,  10.0.0.1
+//    0,       CLIENTPORT, 21212
+//    1,       IPADDRESS,  10.0.0.2
+    m_discoveryInFlight = false;
+    if (response.failure() || response.results().empty()) {
+        logMessage(ClientLogger::WARNING, "ClientImpl::connectDiscoveredHosts no hosts in response");
+        return;
+    }
+    std::map<int, std::pair<std::string, int> > hosts;
+    voltdb::TableIterator tableIter = response.results()[0].iterator();
+    while (tableIter.hasNext()) {
+        voltdb::Row row = tableIter.next();
+        const std::string key = row.getString(1);
+        if (key == "IPADDRESS") {
+            hosts[row.getInt32(0)].first = row.getString(2);
+        } else if (key == "CLIENTPORT") {
+            hosts[row.getInt32(0)].second = atoi(row.getString(2).c_str());
+        }
+    }
+
+    for (std::map<int, std::pair<std::string, int> >::iterator i = hosts.begin(); i != hosts.end(); ++i) {
+        const std::string &address = i->second.first;
+        const int port = i->second.second;
+        if (address.empty() || port <= 0 || port > 65535 ||
+                isConnectedOrPending(i->first, address, static_cast<unsigned short>(port))) {
+            continue;
+        }
+        std::stringstream ss;
+        ss << "ClientImpl::connectDiscoveredHosts host " << i->first << " at " << address << ":" << port;
+        logMessage(ClientLogger::INFO, ss.str());
+        for (int32_t ii = 0; ii < m_connectionsPerHost; ii++) {
+            createPendingConnection(address, static_cast<unsigned short>(port), 0);
+        }
+    }
+}
+
+bool ClientImpl::isConnectedOrPending(int hostId, const std::string &address, unsigned short port){
+    if (hostId >= 0 && static_cast<size_t>(hostId) < m_hostPolicies.size() &&
+            m_hostPolicies[hostId] && m_hostPolicies[hostId]->connectionCount() > 0) {
+        return true;
+    }
+    for (size_t ii = 0; ii < m_connections.size(); ii++) {
+        if (m_connections[ii]->m_name == address && m_connections[ii]->m_port == port) {
+            return true;
+        }
+    }
+    for (std::list<PendingConnectionSPtr>::iterator i = m_connectingList.begin(); i != m_connectingList.end(); ++i) {
+        if ((*i)->m_hostname == address && (*i)->m_port == port) {
+            return true;
+        }
+    }
+    boost::mutex::scoped_lock lock(m_pendingConnectionLock);
+    for (std::list<PendingConnectionSPtr>::iterator i = m_pendingConnectionList.begin(); i != m_pendingConnectionList.end(); ++i) {
+        if ((*i)->m_hostname == address && (*i)->m_port == port) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void ClientImpl::setClientAffinity(bool enable){
-    if(enable && !m_useClientAffinity && !m_bevs.empty()) {
+    for (size_t ii = 0; ii < m_ioLoops.size(); ii++) {
+        m_ioLoops[ii]->execute(boost::bind(&ClientImpl::setClientAffinity, m_ioLoops[ii]->impl(), enable));
+    }
+    if(enable && !m_useClientAffinity && !m_connections.empty()) {
         updateHashinator();
         subscribeToTopologyNotifications();
     }
@@ -1088,13 +2648,39 @@ void ClientImpl::setClientAffinity(bool enable){
 }
 
 void ClientImpl::wakeup() {
-   if (m_wakeupPipe[1] != -1) {
-        static unsigned char c = 'w';
-        boost::mutex::scoped_lock lock(m_wakeupPipeLock, boost::try_to_lock);
-        if (lock) write(m_wakeupPipe[1], &c, 1);
+    if (!m_ioLoops.empty()) {
+        boost::mutex::scoped_lock lock(m_runLock);
+        m_runWakeRequested = true;
+        m_runWake.notify_all();
+        return;
+    }
+    if (m_wakeupPipe[1] != -1) {
+        m_wakeupBreakRequested = true;
+        signalWakeup();
     } else {
-      event_base_loopbreak(m_base);
+        event_base_loopbreak(m_base);
+    }
+}
+
+/*
+ * The pending flag is cleared before the queue is drained, so a submission that misses
+ * this drain is guaranteed to signal again.
+ */
+void ClientImpl::wakeupPipeReadable() {
+    m_wakeupPending = false;
+    drainSubmissions();
+    if (m_ioLoop != NULL) {
+        m_ioLoop->onWakeup();
+    } else if (m_wakeupBreakRequested.exchange(false)) {
+        event_base_loopbreak(m_base);
+    }
+}
+
+void ClientImpl::setLoggerCallback(ClientLogger *pLogger) {
+    for (size_t ii = 0; ii < m_ioLoops.size(); ii++) {
+        m_ioLoops[ii]->execute(boost::bind(&ClientImpl::setLoggerCallback, m_ioLoops[ii]->impl(), pLogger));
     }
+    m_pLogger = pLogger;
 }
 
 void ClientImpl::logMessage(ClientLogger::CLIENT_LOG_LEVEL severity, const std::string& msg){
@@ -36,9 +36,9 @@
 #include <boost/foreach.hpp>
 #include <boost/scoped_array.hpp>
 #include <stdlib.h>
+#include <algorithm>
 namespace voltdb {
 
-boost::shared_mutex Distributer::m_procInfoLock;
 const int Distributer::MP_INIT_PID = 16383;
 
 ProcedureInfo::ProcedureInfo(const std::string & jsonText):PARAMETER_NONE(-1){
@@ -58,94 +58,235 @@ ProcedureInfo::ProcedureInfo(const std::string & jsonText):PARAMETER_NONE(-1){
 }
 
 
-int Distributer::parseParameter(ByteBuffer &paramBuffer, int &index){
+/*
+ * Size of a value of a fixed width wire type, or -1 if the type is variable width or unknown
+ */
+static int fixedWireSize(int8_t type) {
+    switch (type) {
+    case WIRE_TYPE_TINYINT:
+        return 1;
+    case WIRE_TYPE_SMALLINT:
+        return 2;
+    case WIRE_TYPE_INTEGER:
+        return 4;
+    case WIRE_TYPE_BIGINT:
+    case WIRE_TYPE_FLOAT:
+    case WIRE_TYPE_TIMESTAMP:
+        return 8;
+    case WIRE_TYPE_DECIMAL:
+        return 16;
+    default:
+        return -1;
+    }
+}
+
+static bool isIntegerWireType(int type) {
+    return type == WIRE_TYPE_TINYINT || type == WIRE_TYPE_SMALLINT ||
+           type == WIRE_TYPE_INTEGER || type == WIRE_TYPE_BIGINT;
+}
+
+/*
+ * Advance index past the serialized parameter at index. Returns false if the parameter is
+ * of a type the client does not know how to skip.
+ */
+bool TopologySnapshot::skipParameter(ByteBuffer &paramBuffer, int &index) {
+    const int8_t paramType = paramBuffer.getInt8(index++);
+    if (paramType == WIRE_TYPE_NULL) {
+        return true;
+    }
+    if (paramType == WIRE_TYPE_STRING || paramType == WIRE_TYPE_VARBINARY) {
+        const int32_t length = paramBuffer.getInt32(index);
+        index += 4 + std::max(length, 0);
+        return true;
+    }
+    if (paramType != WIRE_TYPE_ARRAY) {
+        const int size = fixedWireSize(paramType);
+        index += size;
+        return size > 0;
+    }
+
+    const int8_t elementType = paramBuffer.getInt8(index++);
+    // byte arrays carry a 4 byte length like VARBINARY, every other array a 2 byte count
+    if (elementType == WIRE_TYPE_TINYINT) {
+        index += 4 + paramBuffer.getInt32(index);
+        return true;
+    }
+    const int16_t count = paramBuffer.getInt16(index);
+    index += 2;
+    if (elementType == WIRE_TYPE_STRING || elementType == WIRE_TYPE_VARBINARY) {
+        for (int16_t ii = 0; ii < count; ii++) {
+            const int32_t length = paramBuffer.getInt32(index);
+            index += 4 + std::max(length, 0);
+        }
+        return true;
+    }
+    const int size = fixedWireSize(elementType);
+    index += size * count;
+    return size > 0;
+}
+
+/*
+ * Hash the serialized parameter at index the way the server does once it has converted the
+ * value to the type of the partitioning column: integers of any width by value, strings and
+ * binary values by their bytes, and the SQL null of any type to partition 0. Returns -1 when
+ * the server's conversion is not one the client reproduces, in which case the request is
+ * sent without affinity and the server forwards it.
+ */
+int TopologySnapshot::parseParameter(ByteBuffer &paramBuffer, int &index, int partitionType) const {
+    if (!m_hashinator) {
+        return -1;
+    }
+    const bool anyType = partitionType < 0;
     int8_t paramType = paramBuffer.getInt8(index++);
-    int64_t val = INT64_MIN;
-    switch(paramType){
-    ///TODO:extend on all data types
+    if (paramType == WIRE_TYPE_NULL) {
+        return 0;
+    }
+    if (isIntegerWireType(paramType)) {
+        if (!anyType && !isIntegerWireType(partitionType)) {
+            return -1;
+        }
+        int64_t val;
+        switch (paramType) {
         case WIRE_TYPE_TINYINT:
         {
-            val = paramBuffer.getInt8(index);
+            const int8_t narrow = paramBuffer.getInt8(index);
+            val = narrow == INT8_MIN ? INT64_MIN : narrow;
             break;
         }
         case WIRE_TYPE_SMALLINT:
         {
-            val = paramBuffer.getInt16(index);
+            const int16_t narrow = paramBuffer.getInt16(index);
+            val = narrow == INT16_MIN ? INT64_MIN : narrow;
             break;
         }
         case WIRE_TYPE_INTEGER:
         {
-            val = paramBuffer.getInt32(index);
+            const int32_t narrow = paramBuffer.getInt32(index);
+            val = narrow == INT32_MIN ? INT64_MIN : narrow;
             break;
         }
-        case WIRE_TYPE_BIGINT:
-        case WIRE_TYPE_FLOAT:
-        case WIRE_TYPE_TIMESTAMP:
-        {
+        default:
             val = paramBuffer.getInt64(index);
             break;
         }
-        case WIRE_TYPE_STRING:
-        {
-            bool wasNull = false;
-            std::string strVal = paramBuffer.getString(index, wasNull);
+        // the hashinator sends the null value, INT64_MIN, to partition 0
+        return m_hashinator->hashinate(val);
+    }
 
-            if(wasNull)
-                return 0;
-            return m_hashinator->hashinate((strVal.data()), strVal.size());
+    int32_t length;
+    if (paramType == WIRE_TYPE_STRING || paramType == WIRE_TYPE_VARBINARY) {
+        if (!anyType && partitionType != paramType) {
+            return -1;
         }
-
-        default:
-            //not supported
+        length = paramBuffer.getInt32(index);
+    } else if (paramType == WIRE_TYPE_ARRAY && paramBuffer.getInt8(index) == WIRE_TYPE_TINYINT) {
+        // how a byte array for a VARBINARY column is sent
+        if (!anyType && partitionType != WIRE_TYPE_VARBINARY) {
             return -1;
+        }
+        index++;
+        length = paramBuffer.getInt32(index);
+    } else {
+        return -1;
     }
-
-    if (val != INT64_MIN)
-        return m_hashinator->hashinate(val);
-    return -1;
+    if (length < 0) {
+        return 0;
+    }
+    index += 4;
+    if (length > paramBuffer.limit() - index) {
+        return -1;
+    }
+    return m_hashinator->hashinate(paramBuffer.bytes() + index, length);
 }
 
 
-int Distributer::getHashedPartitionForParameter(ByteBuffer &paramBuffer, int parameterId){
+int TopologySnapshot::getHashedPartitionForParameter(ByteBuffer &paramBuffer, int parameterId, int parameterType) const {
 
-    int index = 5;//offset
-
-    bool wasNull;
-    std::string name = paramBuffer.getString(index, wasNull);
-
-    //Skip procedure name and size, client data
-    index += sizeof(int32_t) + name.size() + sizeof(int64_t);
+    int index = 0;
 
     //get number of parameters
-    paramBuffer.getInt16(index);
+    const int16_t paramCount = paramBuffer.getInt16(index);
     index += 2;
 
-    //partition key must be the first
-    if (parameterId > 0)
-        return -1;//throw
+    if (parameterId < 0 || parameterId >= paramCount)
+        return -1;
 
-    return parseParameter(paramBuffer, index);
+    for (int ii = 0; ii < parameterId; ii++) {
+        if (!skipParameter(paramBuffer, index))
+            return -1;
+    }
+
+    return parseParameter(paramBuffer, index, parameterType);
+}
+
+int TopologySnapshot::getHashedPartitionAt(ByteBuffer &paramBuffer, int offset, int parameterType) const {
+    return parseParameter(paramBuffer, offset, parameterType);
 }
 
-ProcedureInfo* Distributer::getProcedure(const std::string& procName) throw (UnknownProcedureException)
+ProcedureInfo* TopologySnapshot::getProcedure(const std::string& procName) const
 {
-    std::map<std::string, ProcedureInfo>::iterator it = m_procedureInfo.find(procName);
-    if (it == m_procedureInfo.end())
+    ProcedureTable::const_iterator it = m_procedures->find(procName);
+    if (it == m_procedures->end())
         return NULL;
-    return &it->second;
+    return it->second.get();
 }
 
-int Distributer::getHostIdByPartitionId(int partitionId)
+boost::shared_ptr<ProcedureInfo> TopologySnapshot::getProcedureHandle(const std::string& procName) const
 {
-    std::map<int, int>::iterator it = m_PartitionToHostId.find(partitionId);
-    if (it == m_PartitionToHostId.end())
-        return -1;
+    ProcedureTable::const_iterator it = m_procedures->find(procName);
+    if (it == m_procedures->end())
+        return boost::shared_ptr<ProcedureInfo>();
     return it->second;
 }
 
+int TopologySnapshot::getHostIdByPartitionId(int partitionId) const
+{
+    if (partitionId == Distributer::MP_INIT_PID)
+        return m_mpHostId;
+    if (partitionId < 0 || static_cast<size_t>(partitionId) >= m_partitionToHostId.size())
+        return -1;
+    return m_partitionToHostId[partitionId];
+}
+
+Distributer::Distributer(): m_snapshot(new TopologySnapshot()), m_version(0){}
+
+boost::shared_ptr<const TopologySnapshot> Distributer::snapshot() const {
+    boost::mutex::scoped_lock lock(m_publishLock);
+    return m_snapshot;
+}
+
+void Distributer::publish(TopologySnapshot *next){
+    next->m_version = m_snapshot->m_version + 1;
+    m_snapshot.reset(next);
+    m_version.store(next->m_version, boost::memory_order_release);
+}
+
+void Distributer::startUpdate(){
+    boost::mutex::scoped_lock lock(m_publishLock);
+    if (!m_snapshot->m_isUpdating) {
+        TopologySnapshot *next = new TopologySnapshot(*m_snapshot);
+        next->m_isUpdating = true;
+        publish(next);
+    }
+}
+
+void Distributer::abortUpdate(){
+    boost::mutex::scoped_lock lock(m_publishLock);
+    if (m_snapshot->m_isUpdating) {
+        TopologySnapshot *next = new TopologySnapshot(*m_snapshot);
+        next->m_isUpdating = false;
+        publish(next);
+    }
+}
+
 void Distributer::handleTopologyNotification(const std::vector<voltdb::Table>& t){
+    bool changed;
+    {
+        boost::mutex::scoped_lock lock(m_publishLock);
+        changed = m_savedTopoTable != t[0];
+    }
     // If The savedTopoTable is not the same as our notified one, we have to update the hashinator
-    if (m_savedTopoTable != t[0]) {
+    if (changed) {
         updateAffinityTopology(t);
         debug_msg("updateAffinityTopology after notification");
     }
@@ -162,7 +303,8 @@ void Distributer::updateAffinityTopology(const std::vector<voltdb::Table>& topoT
 //    16383,     2:2,   2:2
 
     debug_msg("updateAffinityTopology ");
-    m_PartitionToHostId.clear();
+    std::vector<int> partitionToHostId;
+    int mpHostId = -1;
     voltdb::TableIterator tableIter = topoTable[0].iterator();
     while (tableIter.hasNext())
     {
@@ -178,7 +320,14 @@ void Distributer::updateAffinityTopology(const std::vector<voltdb::Table>& topoT
         hostId = atoi(token.c_str());
 
         debug_msg("updateAffinityTopology: partitionId=" <<partitionId << " hostId="<<hostId);
-        m_PartitionToHostId.insert(std::pair<int, int >(partitionId, hostId));
+        if (partitionId == MP_INIT_PID) {
+            mpHostId = hostId;
+        } else if (partitionId >= 0) {
+            if (static_cast<size_t>(partitionId) >= partitionToHostId.size()) {
+                partitionToHostId.resize(partitionId + 1, -1);
+            }
+            partitionToHostId[partitionId] = hostId;
+        }
     }
 
     //Get partitions count from second table
@@ -190,19 +339,27 @@ void Distributer::updateAffinityTopology(const std::vector<voltdb::Table>& topoT
     //get real size of buffer
     hashRow.getVarbinary(1, sizeof(tokensCount), (uint8_t*)&tokensCount, &realsize);
 
+    // the ring is built before taking the lock so readers fetching a snapshot never wait on it
+    boost::shared_ptr<const TheHashinator> hashinator;
     const std::string hashMode = hashRow.getString(0);
     //Check if token ring is correct
     if (hashMode.compare("ELASTIC") == 0 ) {
         boost::scoped_array<char> tokens(new char[realsize]);
         hashRow.getVarbinary(1, realsize, (uint8_t*)(tokens.get()), &realsize);
-        m_hashinator.reset(new ElasticHashinator(tokens.get()));
-        m_isElastic = true;
-    }else{
-        m_isElastic = false;
+        hashinator.reset(new ElasticHashinator(tokens.get()));
     }
 
+    boost::mutex::scoped_lock lock(m_publishLock);
+    TopologySnapshot *next = new TopologySnapshot(*m_snapshot);
+    next->m_partitionToHostId.swap(partitionToHostId);
+    next->m_mpHostId = mpHostId;
+    next->m_isElastic = hashinator.get() != NULL;
+    if (next->m_isElastic) {
+        next->m_hashinator = hashinator;
+    }
     //mark update status as finished
-    m_isUpdating = false;
+    next->m_isUpdating = false;
+    publish(next);
 
     m_savedTopoTable = topoTable[0];
 }
@@ -210,8 +367,7 @@ void Distributer::updateAffinityTopology(const std::vector<voltdb::Table>& topoT
 void Distributer::updateProcedurePartitioning(const std::vector<voltdb::Table>& procInfoTable){
 
     debug_msg("updateProcedurePartitioning ");
-    boost::unique_lock<boost::shared_mutex> lock(m_procInfoLock);
-    m_procedureInfo.clear();
+    boost::shared_ptr<TopologySnapshot::ProcedureTable> procedures(new TopologySnapshot::ProcedureTable());
 
     voltdb::TableIterator tableIter = procInfoTable[0].iterator();
 
@@ -221,9 +377,15 @@ void Distributer::updateProcedurePartitioning(const std::vector<voltdb::Table>&
         std::string procedureName = row.getString(2);
         std::string jsonString = row.getString(6);
 
-        m_procedureInfo.insert(std::pair<std::string, ProcedureInfo>(procedureName, ProcedureInfo(jsonString)));
+        procedures->insert(std::make_pair(procedureName, boost::shared_ptr<ProcedureInfo>(new ProcedureInfo(jsonString))));
     }
 
+    boost::mutex::scoped_lock lock(m_publishLock);
+    TopologySnapshot *next = new TopologySnapshot(*m_snapshot);
+    next->m_procedures = procedures;
+    next->m_procedureVersion++;
+    publish(next);
+
 }
 
 
@@ -0,0 +1,189 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "InvocationFuture.h"
+#include "FuturePool.h"
+#include "ClientImpl.h"
+
+namespace voltdb {
+
+/*
+ * The callback table only ever holds copies of m_self, the state itself is owned by its pool
+ */
+struct NoOpDeleter {
+    void operator()(ProcedureCallback *) {}
+};
+
+FutureState::FutureState() :
+        m_self(this, NoOpDeleter()), m_client(NULL), m_ready(false), m_refs(0), m_waiting(false) {
+}
+
+bool FutureState::callback(InvocationResponse response) throw (voltdb::Exception) {
+    return complete(response);
+}
+
+void FutureState::abandon(AbandonReason reason) {
+    if (reason == DEADLINE_EXPIRED) {
+        complete(InvocationResponse(0, STATUS_CODE_CONNECTION_TIMEOUT, "Deadline passed before the request was sent"));
+        return;
+    }
+    complete(InvocationResponse(0, STATUS_CODE_SERVER_UNAVAILABLE, "Client has too many requests outstanding"));
+}
+
+bool FutureState::complete(const InvocationResponse &response) {
+    m_response = response;
+    boost::function<void (const InvocationResponse&)> continuation;
+    {
+        boost::mutex::scoped_lock lock(m_lock);
+        m_ready.store(true, boost::memory_order_release);
+        continuation.swap(m_continuation);
+        m_completed.notify_all();
+    }
+    if (continuation) {
+        try {
+            continuation(m_response);
+        } catch (...) {
+            release();
+            throw;
+        }
+    }
+    const bool breakEventLoop = m_waiting;
+    release();
+    return breakEventLoop;
+}
+
+void FutureState::then(const boost::function<void (const InvocationResponse&)> &continuation) {
+    {
+        boost::mutex::scoped_lock lock(m_lock);
+        if (!m_ready.load(boost::memory_order_acquire)) {
+            m_continuation = continuation;
+            return;
+        }
+    }
+    continuation(m_response);
+}
+
+void FutureState::release() {
+    if (m_refs.fetch_sub(1, boost::memory_order_acq_rel) == 1) {
+        // the pool may be destroyed, and this state with it, when the reference goes away
+        boost::shared_ptr<FuturePool> pool;
+        pool.swap(m_pool);
+        pool->recycle(this);
+    }
+}
+
+void FutureState::wait() {
+    boost::mutex::scoped_lock lock(m_lock);
+    while (!m_ready.load(boost::memory_order_acquire)) {
+        m_completed.wait(lock);
+    }
+}
+
+FuturePool::~FuturePool() {
+    for (std::vector<FutureState*>::iterator i = m_free.begin(); i != m_free.end(); ++i) {
+        delete *i;
+    }
+}
+
+FutureState *FuturePool::acquire(ClientImpl *client) {
+    FutureState *state = NULL;
+    {
+        boost::mutex::scoped_lock lock(m_lock);
+        if (!m_free.empty()) {
+            state = m_free.back();
+            m_free.pop_back();
+        }
+    }
+    if (state == NULL) {
+        state = new FutureState();
+    }
+    state->m_client = client;
+    state->m_pool = shared_from_this();
+    state->m_ready.store(false, boost::memory_order_relaxed);
+    state->m_waiting = false;
+    state->m_refs.store(2, boost::memory_order_relaxed);
+    return state;
+}
+
+void FuturePool::recycle(FutureState *state) {
+    state->m_response = InvocationResponse();
+    state->m_continuation.clear();
+    state->m_client = NULL;
+    boost::mutex::scoped_lock lock(m_lock);
+    m_free.push_back(state);
+}
+
+InvocationFuture::InvocationFuture(const InvocationFuture &other) : m_state(other.m_state) {
+    if (m_state != NULL) {
+        m_state->retain();
+    }
+}
+
+InvocationFuture& InvocationFuture::operator=(const InvocationFuture &other) {
+    if (other.m_state != NULL) {
+        other.m_state->retain();
+    }
+    if (m_state != NULL) {
+        m_state->release();
+    }
+    m_state = other.m_state;
+    return *this;
+}
+
+InvocationFuture::~InvocationFuture() {
+    if (m_state != NULL) {
+        m_state->release();
+    }
+}
+
+bool InvocationFuture::ready() const {
+    return m_state != NULL && m_state->ready();
+}
+
+InvocationResponse InvocationFuture::get() throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException) {
+    if (m_state == NULL) {
+        throw voltdb::NullPointerException();
+    }
+    if (!m_state->ready()) {
+        m_state->client()->waitFor(*m_state);
+    }
+    return m_state->response();
+}
+
+void InvocationFuture::then(const boost::function<void (const InvocationResponse&)> &continuation) throw (voltdb::Exception) {
+    if (m_state == NULL) {
+        throw voltdb::NullPointerException();
+    }
+    m_state->then(continuation);
+}
+
+bool whenAll(std::vector<InvocationFuture> &futures)
+throw (voltdb::Exception, voltdb::NoConnectionsException, voltdb::LibEventException) {
+    bool success = true;
+    for (std::vector<InvocationFuture>::iterator i = futures.begin(); i != futures.end(); ++i) {
+        success &= i->get().success();
+    }
+    return success;
+}
+
+}
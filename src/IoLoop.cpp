@@ -0,0 +1,128 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "IoLoop.h"
+#include <event2/event.h>
+
+namespace voltdb {
+
+IoLoop::IoLoop(ClientConfig config, boost::shared_ptr<Distributer> distributer)
+throw (voltdb::Exception, voltdb::LibEventException) :
+        m_stop(false), m_taskPending(false), m_taskError(TASK_OK), m_runningTask(false) {
+    config.m_ioThreads = 0;
+    // invocations are rate limited by the client handing them to the loops
+    config.m_rateLimits.clear();
+    m_impl.reset(new ClientImpl(config, distributer));
+    if (m_impl->m_wakeupPipe[1] == -1) {
+        throw voltdb::LibEventException();
+    }
+    m_impl->m_ioLoop = this;
+    m_thread.reset(new boost::thread(&IoLoop::run, this));
+}
+
+IoLoop::~IoLoop() {
+    m_stop = true;
+    m_impl->signalWakeup();
+    m_thread->join();
+}
+
+void IoLoop::execute(const boost::function<void()> &task)
+throw (voltdb::Exception, voltdb::ConnectException, voltdb::LibEventException) {
+    boost::mutex::scoped_lock control(m_controlLock);
+    {
+        boost::mutex::scoped_lock lock(m_taskLock);
+        m_task = task;
+        m_taskError = TASK_OK;
+        m_taskPending = true;
+    }
+    m_impl->signalWakeup();
+
+    TaskError error;
+    {
+        boost::mutex::scoped_lock lock(m_taskLock);
+        while (m_taskPending) {
+            m_taskDone.wait(lock);
+        }
+        m_task.clear();
+        error = m_taskError;
+    }
+
+    switch (error) {
+    case TASK_OK:
+        return;
+    case TASK_CONNECT:
+        throw voltdb::ConnectException();
+    case TASK_CLUSTER_MISMATCH:
+        throw voltdb::ClusterInstanceMismatchException();
+    case TASK_LIBEVENT:
+        throw voltdb::LibEventException();
+    default:
+        throw voltdb::Exception();
+    }
+}
+
+void IoLoop::onWakeup() {
+    if (!m_runningTask && (m_taskPending || m_stop)) {
+        event_base_loopbreak(m_impl->m_base);
+    }
+}
+
+void IoLoop::run() {
+    while (!m_stop) {
+        event_base_dispatch(m_impl->m_base);
+        runTask();
+    }
+}
+
+/*
+ * Tasks drive the loop themselves (createConnection dispatches until authentication
+ * completes), so a wakeup that arrives while one runs must not break the loop.
+ */
+void IoLoop::runTask() {
+    if (!m_taskPending) {
+        return;
+    }
+    TaskError error = TASK_OK;
+    m_runningTask = true;
+    try {
+        m_task();
+    } catch (const voltdb::ConnectException &) {
+        error = TASK_CONNECT;
+    } catch (const voltdb::ClusterInstanceMismatchException &) {
+        error = TASK_CLUSTER_MISMATCH;
+    } catch (const voltdb::LibEventException &) {
+        error = TASK_LIBEVENT;
+    } catch (const std::exception &) {
+        error = TASK_OTHER;
+    }
+    m_runningTask = false;
+
+    {
+        boost::mutex::scoped_lock lock(m_taskLock);
+        m_taskError = error;
+        m_taskPending = false;
+    }
+    m_taskDone.notify_all();
+}
+
+}
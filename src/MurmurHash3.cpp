@@ -7,6 +7,7 @@
 // compile and run any of them on any platform, but your performance with the
 // non-native version will be less than optimal.
 
+#include <string.h>
 #include "MurmurHash3.h"
 
 namespace voltdb {
@@ -147,6 +148,84 @@ int32_t MurmurHash3_x64_128 ( const void * key, const int len,
   //Also use the h1 higher order bits because it provided much better performance in voter, consistent too
   return static_cast<int32_t>(h1 >> 32);
 }
+
+//-----------------------------------------------------------------------------
+// An 8 byte key is a single tail block of the hash above, read little endian like the
+// tail bytes are. Keys are hashed MURMUR_LANES at a time with each step applied to every
+// lane before the next, so the multiply chains of independent keys overlap in the
+// pipeline instead of running one after another.
+
+static const size_t MURMUR_LANES = 4;
+
+static FORCE_INLINE uint64_t getlittleendian64 ( const int64_t * p )
+{
+  uint8_t bytes[8];
+  memcpy(bytes, p, 8);
+  return uint64_t(bytes[0])       | uint64_t(bytes[1]) << 8  |
+         uint64_t(bytes[2]) << 16 | uint64_t(bytes[3]) << 24 |
+         uint64_t(bytes[4]) << 32 | uint64_t(bytes[5]) << 40 |
+         uint64_t(bytes[6]) << 48 | uint64_t(bytes[7]) << 56;
+}
+
+static FORCE_INLINE int32_t hash64 ( uint64_t k1 )
+{
+  const uint64_t c1 = BIG_CONSTANT(0x87c37b91114253d5);
+  const uint64_t c2 = BIG_CONSTANT(0x4cf5ad432745937f);
+
+  k1 *= c1; k1 = ROTL64(k1,31); k1 *= c2;
+
+  uint64_t h1 = k1 ^ 8;
+  uint64_t h2 = 8;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = fmix(h1);
+  h2 = fmix(h2);
+
+  h1 += h2;
+
+  return static_cast<int32_t>(h1 >> 32);
+}
+
+void MurmurHash3_x64_128_batch ( const int64_t * values, size_t count, int32_t * hashes )
+{
+  const uint64_t c1 = BIG_CONSTANT(0x87c37b91114253d5);
+  const uint64_t c2 = BIG_CONSTANT(0x4cf5ad432745937f);
+
+  size_t i = 0;
+  for(; i + MURMUR_LANES <= count; i += MURMUR_LANES)
+  {
+    uint64_t h1[MURMUR_LANES];
+    uint64_t h2[MURMUR_LANES];
+
+    for(size_t l = 0; l < MURMUR_LANES; l++)
+    {
+      uint64_t k1 = getlittleendian64(values + i + l);
+      k1 *= c1; k1 = ROTL64(k1,31); k1 *= c2;
+      h1[l] = k1 ^ 8;
+    }
+    for(size_t l = 0; l < MURMUR_LANES; l++)
+    {
+      h1[l] += 8;
+      h2[l] = h1[l] + 8;
+    }
+    for(size_t l = 0; l < MURMUR_LANES; l++)
+    {
+      h1[l] = fmix(h1[l]);
+      h2[l] = fmix(h2[l]);
+    }
+    for(size_t l = 0; l < MURMUR_LANES; l++)
+    {
+      hashes[i + l] = static_cast<int32_t>((h1[l] + h2[l]) >> 32);
+    }
+  }
+
+  for(; i < count; i++)
+  {
+    hashes[i] = hash64(getlittleendian64(values + i));
+  }
+}
 }
 //-----------------------------------------------------------------------------
 
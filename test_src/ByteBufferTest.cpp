@@ -26,6 +26,7 @@
 #include "Exception.hpp"
 #include "ByteBuffer.hpp"
 #include <boost/scoped_ptr.hpp>
+#include <boost/checked_delete.hpp>
 
 namespace voltdb {
 
@@ -66,6 +67,7 @@ CPPUNIT_TEST_EXCEPTION( testEnsureCapacityThrows, voltdb::NonExpandableBufferExc
 CPPUNIT_TEST_EXCEPTION( testEnsureCapacityExactThrows, voltdb::NonExpandableBufferException );
 CPPUNIT_TEST( testCopyConstruction );
 CPPUNIT_TEST( testSharedAndScopedByteBuffer );
+CPPUNIT_TEST( testSharedView );
 CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -445,6 +447,30 @@ public:
         buf->ensureRemainingExact(533);
         delete buf;
     }
+
+    /*
+     * A view keeps its owner alive through slices and lets go of it once it has
+     * expanded into storage of its own
+     */
+    void testSharedView() {
+        char *storage = new char[64];
+        boost::shared_ptr<void> owner(storage, boost::checked_array_deleter<char>());
+        SharedByteBuffer view(owner, storage + 16, 32);
+        CPPUNIT_ASSERT(view.bytes() == storage + 16);
+        CPPUNIT_ASSERT(view.capacity() == 32);
+
+        view.position(8);
+        SharedByteBuffer slice = view.slice();
+        CPPUNIT_ASSERT(slice.bytes() == storage + 24);
+        CPPUNIT_ASSERT(owner.use_count() == 3);
+
+        slice.position(24);
+        slice.ensureRemaining(8);
+        CPPUNIT_ASSERT(slice.bytes() != storage + 24);
+        CPPUNIT_ASSERT(owner.use_count() == 2);
+        owner.reset();
+        CPPUNIT_ASSERT(view.bytes() == storage + 16);
+    }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( ByteBufferTest );
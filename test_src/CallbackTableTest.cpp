@@ -0,0 +1,148 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include "CallbackTable.h"
+
+namespace voltdb {
+
+class NoopCallback : public ProcedureCallback {
+public:
+    bool callback(InvocationResponse response) throw (voltdb::Exception) {
+        return false;
+    }
+};
+
+class CallbackTableTest : public CppUnit::TestFixture {
+CPPUNIT_TEST_SUITE( CallbackTableTest );
+CPPUNIT_TEST( testInsertRemove );
+CPPUNIT_TEST( testRemoveMissing );
+CPPUNIT_TEST( testCollidingClientData );
+CPPUNIT_TEST( testGrow );
+CPPUNIT_TEST( testNotificationSlot );
+CPPUNIT_TEST( testRemoveConnection );
+CPPUNIT_TEST_SUITE_END();
+
+public:
+    static const int64_t NOTIFICATION = 9223372036854775806LL;
+
+    ConnectionState *connection(intptr_t id) {
+        return reinterpret_cast<ConnectionState*>(id);
+    }
+
+    void testInsertRemove() {
+        CallbackTable table(NOTIFICATION, 8);
+        CPPUNIT_ASSERT(table.capacity() == 16);
+        std::vector<boost::shared_ptr<ProcedureCallback> > callbacks;
+        for (int64_t ii = INT64_MIN; ii < INT64_MIN + 8; ii++) {
+            callbacks.push_back(boost::shared_ptr<ProcedureCallback>(new NoopCallback()));
+            table.insert(ii, connection(1), callbacks.back());
+        }
+        CPPUNIT_ASSERT(table.size() == 8);
+        for (int64_t ii = INT64_MIN; ii < INT64_MIN + 8; ii++) {
+            CPPUNIT_ASSERT(table.remove(ii) == callbacks[ii - INT64_MIN]);
+        }
+        CPPUNIT_ASSERT(table.size() == 0);
+    }
+
+    void testRemoveMissing() {
+        CallbackTable table(NOTIFICATION, 8);
+        table.insert(1, connection(1), boost::shared_ptr<ProcedureCallback>(new NoopCallback()));
+        CPPUNIT_ASSERT(table.remove(2).get() == NULL);
+        CPPUNIT_ASSERT(table.remove(17).get() == NULL);
+        CPPUNIT_ASSERT(table.remove(1).get() != NULL);
+        CPPUNIT_ASSERT(table.remove(1).get() == NULL);
+    }
+
+    /*
+     * A straggler keeps its slot while later requests wrap around onto it, and removing
+     * from the middle of a cluster must leave the rest reachable
+     */
+    void testCollidingClientData() {
+        CallbackTable table(NOTIFICATION, 8);
+        boost::shared_ptr<ProcedureCallback> a(new NoopCallback());
+        boost::shared_ptr<ProcedureCallback> b(new NoopCallback());
+        boost::shared_ptr<ProcedureCallback> c(new NoopCallback());
+        boost::shared_ptr<ProcedureCallback> d(new NoopCallback());
+        table.insert(15, connection(1), a);
+        table.insert(31, connection(1), b);
+        table.insert(16, connection(1), c);
+        table.insert(47, connection(1), d);
+        CPPUNIT_ASSERT(table.remove(31) == b);
+        CPPUNIT_ASSERT(table.remove(16) == c);
+        CPPUNIT_ASSERT(table.remove(47) == d);
+        CPPUNIT_ASSERT(table.remove(15) == a);
+        CPPUNIT_ASSERT(table.size() == 0);
+    }
+
+    void testGrow() {
+        CallbackTable table(NOTIFICATION, 4);
+        boost::shared_ptr<ProcedureCallback> callback(new NoopCallback());
+        for (int64_t ii = 0; ii < 1000; ii++) {
+            table.insert(ii * 3, connection(1), callback, 0, static_cast<int32_t>(ii));
+        }
+        CPPUNIT_ASSERT(table.size() == 1000);
+        CPPUNIT_ASSERT(table.capacity() >= 2000);
+        // sizes survive rehashing and the shifts that close removed slots
+        for (int64_t ii = 999; ii >= 0; ii--) {
+            int32_t bytes = -1;
+            CPPUNIT_ASSERT(table.remove(ii * 3, NULL, NULL, &bytes) == callback);
+            CPPUNIT_ASSERT(bytes == ii);
+        }
+        CPPUNIT_ASSERT(table.size() == 0);
+    }
+
+    void testNotificationSlot() {
+        CallbackTable table(NOTIFICATION, 8);
+        CPPUNIT_ASSERT(table.remove(NOTIFICATION).get() == NULL);
+        boost::shared_ptr<ProcedureCallback> callback(new NoopCallback());
+        table.setNotificationCallback(callback);
+        CPPUNIT_ASSERT(table.remove(NOTIFICATION) == callback);
+        CPPUNIT_ASSERT(table.remove(NOTIFICATION) == callback);
+        CPPUNIT_ASSERT(table.size() == 0);
+    }
+
+    void testRemoveConnection() {
+        CallbackTable table(NOTIFICATION, 8);
+        boost::shared_ptr<ProcedureCallback> callback(new NoopCallback());
+        table.setNotificationCallback(callback);
+        for (int64_t ii = 0; ii < 40; ii++) {
+            table.insert(ii, connection(ii % 2 + 1), callback);
+        }
+        std::vector<CallbackTable::Registration> removed;
+        table.removeConnection(connection(1), removed);
+        CPPUNIT_ASSERT(removed.size() == 20);
+        CPPUNIT_ASSERT(table.size() == 20);
+        for (size_t ii = 0; ii < removed.size(); ii++) {
+            CPPUNIT_ASSERT(removed[ii].first == static_cast<int64_t>(ii * 2));
+        }
+        for (int64_t ii = 1; ii < 40; ii += 2) {
+            CPPUNIT_ASSERT(table.remove(ii) == callback);
+        }
+        CPPUNIT_ASSERT(table.remove(NOTIFICATION) == callback);
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( CallbackTableTest );
+}
@@ -23,7 +23,11 @@
 #include <cppunit/TestCase.h>
 #include <cppunit/extensions/HelperMacros.h>
 #include <cppunit/TestFixture.h>
+#include <sys/time.h>
 #include <vector>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 #include "Client.h"
 #include "MockVoltDB.h"
 #include "StatusListener.h"
@@ -87,6 +91,27 @@ CPPUNIT_TEST( testCallbackThrows );
 CPPUNIT_TEST( testBackpressure );
 CPPUNIT_TEST( testDrain );
 CPPUNIT_TEST( testLostConnectionDuringDrain );
+CPPUNIT_TEST( testTimeoutDuringDrain );
+CPPUNIT_TEST( testSyncInvokeTimeout );
+CPPUNIT_TEST( testInvokeFromOtherThreads );
+CPPUNIT_TEST( testInvokeAsyncWhenAll );
+CPPUNIT_TEST( testInvokeAsyncLostConnection );
+CPPUNIT_TEST( testInvokeAsyncThen );
+CPPUNIT_TEST( testInvokeBatch );
+CPPUNIT_TEST( testInvokeBatchTooBusy );
+CPPUNIT_TEST( testMaxOutstandingBytes );
+CPPUNIT_TEST( testAdaptiveConcurrency );
+CPPUNIT_TEST( testDeadlinePassed );
+CPPUNIT_TEST( testDeadlineShedsBufferedRequest );
+CPPUNIT_TEST( testRateLimitDefers );
+CPPUNIT_TEST( testRateLimitBlocking );
+CPPUNIT_TEST( testRateLimitNoConnections );
+CPPUNIT_TEST( testConnectionsPerHost );
+CPPUNIT_TEST( testCreateConnectionsAsync );
+CPPUNIT_TEST( testDiscoverHosts );
+CPPUNIT_TEST( testReconnectAfterLostConnection );
+CPPUNIT_TEST( testReconnectAttemptExpires );
+CPPUNIT_TEST( testRetryFromLostConnectionCallback );
 CPPUNIT_TEST_EXCEPTION( testLostConnection, voltdb::NoConnectionsException );
 CPPUNIT_TEST_SUITE_END();
 
@@ -482,6 +507,775 @@ public:
         CPPUNIT_ASSERT(cb->m_connectionLost == 3);
     }
 
+    class CountingSuccessAndTimeout : public voltdb::ProcedureCallback {
+    public:
+        CountingSuccessAndTimeout() : m_success(0), m_timeout(0) {}
+
+        bool callback(voltdb::InvocationResponse response) throw (voltdb::Exception) {
+            if (response.success()) {
+                m_success++;
+            } else {
+                CPPUNIT_ASSERT(response.statusCode() == voltdb::STATUS_CODE_CONNECTION_TIMEOUT);
+                m_timeout++;
+            }
+            return false;
+        }
+        int32_t m_success;
+        int32_t m_timeout;
+    };
+
+    void testTimeoutDuringDrain() {
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+
+        CountingSuccessAndTimeout *cb = new CountingSuccessAndTimeout();
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        m_voltdb->forceTimeoutAfter(2);
+        for (int ii = 0; ii < 5; ii++) {
+            (m_client)->invoke( proc, callback, 100);
+        }
+        CPPUNIT_ASSERT((m_client)->drain());
+        CPPUNIT_ASSERT(cb->m_success == 2);
+        CPPUNIT_ASSERT(cb->m_timeout == 3);
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 0);
+    }
+
+    void testSyncInvokeTimeout() {
+        (m_client)->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        m_voltdb->dontRead();
+        InvocationResponse response = (m_client)->invoke(proc, 50);
+        CPPUNIT_ASSERT(response.statusCode() == voltdb::STATUS_CODE_CONNECTION_TIMEOUT);
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 0);
+    }
+
+    class AtomicCountingCallback : public voltdb::ProcedureCallback {
+    public:
+        AtomicCountingCallback() : m_success(0) {}
+        bool callback(voltdb::InvocationResponse response) throw (voltdb::Exception) {
+            if (response.success()) {
+                m_success++;
+            }
+            return false;
+        }
+        boost::atomic<int32_t> m_success;
+    };
+
+    static void invokeMany(Client *client, boost::shared_ptr<ProcedureCallback> callback, int count) {
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        for (int ii = 0; ii < count; ii++) {
+            client->invoke(proc, callback);
+        }
+        InvocationResponse response = client->invoke(proc);
+        CPPUNIT_ASSERT(response.success());
+    }
+
+    void testInvokeFromOtherThreads() {
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+
+        // the first response is processed inside run(), so once it arrives the loop thread is running
+        AtomicCountingCallback *cb = new AtomicCountingCallback();
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        (m_client)->invoke(proc, callback);
+        boost::thread loop(boost::bind(&Client::run, m_client));
+        while (cb->m_success < 1) {
+            boost::this_thread::yield();
+        }
+
+        const int threads = 4;
+        const int perThread = 200;
+        boost::thread_group producers;
+        for (int ii = 0; ii < threads; ii++) {
+            producers.create_thread(boost::bind(&ClientTest::invokeMany, m_client, callback, perThread));
+        }
+        producers.join_all();
+        while (cb->m_success < 1 + threads * perThread) {
+            boost::this_thread::yield();
+        }
+        (m_client)->wakeup();
+        loop.join();
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 0);
+    }
+
+    void testInvokeAsyncWhenAll() {
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+
+        std::vector<InvocationFuture> futures;
+        for (int ii = 0; ii < 5; ii++) {
+            futures.push_back((m_client)->invokeAsync(proc));
+        }
+        CPPUNIT_ASSERT(whenAll(futures));
+        for (int ii = 0; ii < 5; ii++) {
+            CPPUNIT_ASSERT(futures[ii].ready());
+            CPPUNIT_ASSERT(futures[ii].get().success());
+        }
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 0);
+
+        // the states go back to the pool and are reused by the next round
+        futures.clear();
+        InvocationFuture future = (m_client)->invokeAsync(proc);
+        CPPUNIT_ASSERT(!future.ready());
+        CPPUNIT_ASSERT(future.get().success());
+    }
+
+    void testInvokeAsyncLostConnection() {
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+
+        std::vector<InvocationFuture> futures;
+        for (int ii = 0; ii < 5; ii++) {
+            futures.push_back((m_client)->invokeAsync(proc));
+        }
+        m_voltdb->hangupOnRequestCount(3);
+        CPPUNIT_ASSERT(!whenAll(futures));
+        int lost = 0;
+        for (int ii = 0; ii < 5; ii++) {
+            if (futures[ii].get().statusCode() == voltdb::STATUS_CODE_CONNECTION_LOST) {
+                lost++;
+            }
+        }
+        CPPUNIT_ASSERT(lost == 3);
+    }
+
+    struct Chain {
+        Chain() : m_client(NULL), m_proc(NULL), m_calls(0) {}
+        Client *m_client;
+        Procedure *m_proc;
+        int m_calls;
+        InvocationFuture m_next;
+    };
+
+    static void chainNext(Chain *chain, const InvocationResponse &response) {
+        chain->m_calls++;
+        if (response.success() && chain->m_proc != NULL) {
+            chain->m_next = chain->m_client->invokeAsync(*chain->m_proc);
+        }
+    }
+
+    void testInvokeAsyncThen() {
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+
+        // the continuation runs from the event loop and issues the dependent invocation
+        Chain chain;
+        chain.m_client = m_client;
+        chain.m_proc = &proc;
+        (m_client)->invokeAsync(proc).then(boost::bind(&ClientTest::chainNext, &chain, _1));
+        CPPUNIT_ASSERT(chain.m_calls == 0);
+        (m_client)->drain();
+        CPPUNIT_ASSERT(chain.m_calls == 1);
+        CPPUNIT_ASSERT(chain.m_next.ready());
+        CPPUNIT_ASSERT(chain.m_next.get().success());
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 0);
+
+        // a continuation attached to a completed future runs immediately
+        chain.m_proc = NULL;
+        chain.m_next.then(boost::bind(&ClientTest::chainNext, &chain, _1));
+        CPPUNIT_ASSERT(chain.m_calls == 2);
+
+        InvocationFuture invalid;
+        bool threw = false;
+        try {
+            invalid.then(boost::bind(&ClientTest::chainNext, &chain, _1));
+        } catch (voltdb::NullPointerException &e) {
+            threw = true;
+        }
+        CPPUNIT_ASSERT(threw);
+    }
+
+    void testInvokeBatch() {
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        std::vector<Parameter> signature(1, Parameter(WIRE_TYPE_STRING));
+        std::vector<boost::shared_ptr<Procedure> > owned;
+        std::vector<Procedure*> procs;
+        std::vector<boost::shared_ptr<ProcedureCallback> > callbacks;
+        for (int ii = 0; ii < 10; ii++) {
+            owned.push_back(boost::shared_ptr<Procedure>(new Procedure("Insert", signature)));
+            owned.back()->params()->addString("Hello");
+            procs.push_back(owned.back().get());
+            callbacks.push_back(boost::shared_ptr<ProcedureCallback>(new CountingCallback(1)));
+        }
+
+        // the callbacks have to pair up with the procedures
+        std::vector<boost::shared_ptr<ProcedureCallback> > tooFew(callbacks.begin(), callbacks.begin() + 2);
+        bool threw = false;
+        try {
+            (m_client)->invokeBatch(procs, tooFew);
+        } catch (voltdb::Exception &e) {
+            threw = true;
+        }
+        CPPUNIT_ASSERT(threw);
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 0);
+
+        (m_client)->invokeBatch(procs, callbacks);
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 10);
+        (m_client)->drain();
+        for (int ii = 0; ii < 10; ii++) {
+            CPPUNIT_ASSERT(static_cast<CountingCallback*>(callbacks[ii].get())->m_count == 0);
+        }
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 0);
+    }
+
+    class CountingSuccessAndTooBusy : public voltdb::ProcedureCallback {
+    public:
+        CountingSuccessAndTooBusy() : m_success(0), m_tooBusy(0) {}
+        bool callback(voltdb::InvocationResponse response) throw (voltdb::Exception) {
+            CPPUNIT_ASSERT(response.success());
+            m_success++;
+            return false;
+        }
+        void abandon(AbandonReason reason) {
+            CPPUNIT_ASSERT(reason == TOO_BUSY);
+            m_tooBusy++;
+        }
+        int32_t m_success;
+        int32_t m_tooBusy;
+    };
+
+    void testInvokeBatchTooBusy() {
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        std::vector<Parameter> signature;
+        std::vector<boost::shared_ptr<Procedure> > owned;
+        std::vector<Procedure*> procs;
+        // more than the default limit of 3000 outstanding requests
+        for (int ii = 0; ii < 3005; ii++) {
+            owned.push_back(boost::shared_ptr<Procedure>(new Procedure("Insert", signature)));
+            procs.push_back(owned.back().get());
+        }
+        CountingSuccessAndTooBusy *cb = new CountingSuccessAndTooBusy();
+        std::vector<boost::shared_ptr<ProcedureCallback> > callbacks(1, boost::shared_ptr<ProcedureCallback>(cb));
+        (m_client)->invokeBatch(procs, callbacks);
+        CPPUNIT_ASSERT(cb->m_tooBusy == 5);
+        (m_client)->drain();
+        CPPUNIT_ASSERT(cb->m_success == 3000);
+    }
+
+    void testMaxOutstandingBytes() {
+        ClientConfig config("hello", "world", *m_dlistener);
+        config.m_maxOutstandingBytes = 1;
+        m_voltdb.reset(NULL);
+        m_voltdb.reset(new MockVoltDB(Client::create(config)));
+        m_client = m_voltdb->client();
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        CountingSuccessAndTooBusy *cb = new CountingSuccessAndTooBusy();
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        // the first request reaches the limit and the rest are rejected until it is answered
+        for (int ii = 0; ii < 5; ii++) {
+            (m_client)->invoke(proc, callback);
+        }
+        CPPUNIT_ASSERT(cb->m_tooBusy == 4);
+        (m_client)->drain();
+        CPPUNIT_ASSERT(cb->m_success == 1);
+
+        (m_client)->invoke(proc, callback);
+        (m_client)->drain();
+        CPPUNIT_ASSERT(cb->m_success == 2);
+        CPPUNIT_ASSERT(cb->m_tooBusy == 4);
+    }
+
+    void testAdaptiveConcurrency() {
+        CPPUNIT_ASSERT(m_client->getStats().m_concurrencyLimit == 3000);
+
+        ClientConfig config("hello", "world", *m_dlistener);
+        config.m_adaptiveConcurrency = true;
+        config.m_concurrencyInitialLimit = 4;
+        config.m_connectionsPerHost = 2;
+        m_voltdb.reset(NULL);
+        m_voltdb.reset(new MockVoltDB(Client::create(config)));
+        m_client = m_voltdb->client();
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        CPPUNIT_ASSERT(m_client->getStats().m_concurrencyLimit == 8);
+
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        CountingSuccessAndTooBusy *cb = new CountingSuccessAndTooBusy();
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        for (int ii = 0; ii < 10; ii++) {
+            (m_client)->invoke(proc, callback);
+        }
+        CPPUNIT_ASSERT(cb->m_tooBusy == 2);
+        (m_client)->drain();
+        CPPUNIT_ASSERT(cb->m_success == 8);
+        // busy connections answering at an even pace raise their limits
+        CPPUNIT_ASSERT(m_client->getStats().m_concurrencyLimit > 8);
+    }
+
+    class RecordingAbandon : public voltdb::ProcedureCallback {
+    public:
+        RecordingAbandon() : m_responses(0), m_abandoned(0), m_reason(NOT_ABANDONED) {}
+        bool callback(voltdb::InvocationResponse response) throw (voltdb::Exception) {
+            m_responses++;
+            return false;
+        }
+        void abandon(AbandonReason reason) {
+            m_abandoned++;
+            m_reason = reason;
+        }
+        int32_t m_responses;
+        int32_t m_abandoned;
+        AbandonReason m_reason;
+    };
+
+    static int64_t epochMillis() {
+        struct timeval tp;
+        gettimeofday(&tp, NULL);
+        return static_cast<int64_t>(tp.tv_sec) * 1000 + tp.tv_usec / 1000;
+    }
+
+    void testDeadlinePassed() {
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        RecordingAbandon *cb = new RecordingAbandon();
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+
+        (m_client)->invokeWithDeadline(proc, callback, epochMillis() - 1);
+        CPPUNIT_ASSERT(cb->m_abandoned == 1);
+        CPPUNIT_ASSERT(cb->m_reason == ProcedureCallback::DEADLINE_EXPIRED);
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 0);
+        CPPUNIT_ASSERT(m_client->getStats().m_shedRequests == 1);
+
+        (m_client)->invokeWithDeadline(proc, callback, epochMillis() + 60000);
+        (m_client)->drain();
+        CPPUNIT_ASSERT(cb->m_responses == 1);
+        CPPUNIT_ASSERT(cb->m_abandoned == 1);
+        CPPUNIT_ASSERT(m_client->getStats().m_shedRequests == 1);
+        CPPUNIT_ASSERT(m_client->getStats().m_lateResponses == 0);
+    }
+
+    void testDeadlineShedsBufferedRequest() {
+        class Listener : public StatusListener {
+        public:
+            bool reported;
+            Listener() : reported(false) {}
+            virtual bool uncaughtException(
+                    std::exception exception,
+                    boost::shared_ptr<voltdb::ProcedureCallback> callback,
+                    InvocationResponse response) {
+                CPPUNIT_ASSERT(false);
+                return true;
+            }
+            virtual bool connectionLost(std::string hostname, int32_t connectionsLeft) {
+                return false;
+            }
+            virtual bool connectionActive(std::string hostname, int32_t connectionsLeft) {
+                return true;
+            }
+            virtual bool backpressure(bool hasBackpressure) {
+                reported |= hasBackpressure;
+                return true;
+            }
+        }  listener;
+        (*m_dlistener)->m_listener = &listener;
+
+        (m_client)->createConnection("localhost");
+        std::vector<Parameter> signature;
+        signature.push_back(Parameter(WIRE_TYPE_STRING));
+        Procedure proc("Insert", signature);
+        const std::string payload(4096, 'x');
+        RecordingAbandon *filler = new RecordingAbandon();
+        boost::shared_ptr<ProcedureCallback> fillerCallback(filler);
+        // fill the connection's output buffer behind a server that has stopped reading
+        m_voltdb->dontRead();
+        while (!listener.reported) {
+            proc.params()->addString(payload);
+            (m_client)->invoke(proc, fillerCallback);
+            (m_client)->runOnce();
+        }
+        CPPUNIT_ASSERT(filler->m_abandoned == 0);
+        const int32_t outstanding = (m_client)->outstandingRequests();
+
+        RecordingAbandon *cb = new RecordingAbandon();
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        proc.params()->addString(payload);
+        (m_client)->invokeWithDeadline(proc, callback, epochMillis() + 20);
+        CPPUNIT_ASSERT(cb->m_abandoned == 0);
+        for (int ii = 0; ii < 5000 && cb->m_abandoned == 0; ii++) {
+            (m_client)->runOnce();
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+        CPPUNIT_ASSERT(cb->m_abandoned == 1);
+        CPPUNIT_ASSERT(cb->m_reason == ProcedureCallback::DEADLINE_EXPIRED);
+        CPPUNIT_ASSERT(cb->m_responses == 0);
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == outstanding);
+        CPPUNIT_ASSERT(m_client->getStats().m_shedRequests == 1);
+        CPPUNIT_ASSERT(filler->m_abandoned == 0);
+        (*m_dlistener)->m_listener = NULL;
+    }
+
+    void testRateLimitDefers() {
+        ClientConfig config("hello", "world", *m_dlistener);
+        config.m_rateLimits["bulk"] = RateLimit(100, 2);
+        config.m_rateLimitGroups["Insert"] = "bulk";
+        m_voltdb.reset(NULL);
+        m_voltdb.reset(new MockVoltDB(Client::create(config)));
+        m_client = m_voltdb->client();
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        CountingSuccessAndTooBusy *cb = new CountingSuccessAndTooBusy();
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        const int64_t start = epochMillis();
+        // the burst is sent and the rest wait in the client, returning at once
+        for (int ii = 0; ii < 5; ii++) {
+            (m_client)->invoke(proc, callback);
+        }
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 5);
+        CPPUNIT_ASSERT(m_client->getStats().m_rateLimitedRequests == 3);
+        (m_client)->drain();
+        CPPUNIT_ASSERT(cb->m_success == 5);
+        CPPUNIT_ASSERT(epochMillis() - start >= 25);
+
+        // synchronous invocations share the bucket, and other procedures are not limited
+        InvocationResponse response = (m_client)->invoke(proc);
+        CPPUNIT_ASSERT(response.success());
+        Procedure other("Select", signature);
+        (m_client)->invoke(other, callback);
+        (m_client)->drain();
+        CPPUNIT_ASSERT(cb->m_success == 6);
+        CPPUNIT_ASSERT(cb->m_tooBusy == 0);
+        CPPUNIT_ASSERT(m_client->getStats().m_rateLimitedRequests == 4);
+    }
+
+    void testRateLimitBlocking() {
+        ClientConfig config("hello", "world", *m_dlistener);
+        config.m_rateLimits["Insert"] = RateLimit(100, 1);
+        config.m_rateLimitBlocking = true;
+        m_voltdb.reset(NULL);
+        m_voltdb.reset(new MockVoltDB(Client::create(config)));
+        m_client = m_voltdb->client();
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        CountingSuccessAndTooBusy *cb = new CountingSuccessAndTooBusy();
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        const int64_t start = epochMillis();
+        for (int ii = 0; ii < 3; ii++) {
+            (m_client)->invoke(proc, callback);
+        }
+        // each invoke returned once its request had been sent
+        CPPUNIT_ASSERT(epochMillis() - start >= 15);
+        CPPUNIT_ASSERT(m_client->getStats().m_rateLimitedRequests == 2);
+        (m_client)->drain();
+        CPPUNIT_ASSERT(cb->m_success == 3);
+    }
+
+    void testRateLimitNoConnections() {
+        ClientConfig config("hello", "world", *m_dlistener);
+        config.m_rateLimits["Insert"] = RateLimit(1, 1);
+        m_voltdb.reset(NULL);
+        m_voltdb.reset(new MockVoltDB(Client::create(config)));
+        m_client = m_voltdb->client();
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        bool threw = false;
+        try {
+            (m_client)->invoke(proc);
+        } catch (voltdb::NoConnectionsException&) {
+            threw = true;
+        }
+        CPPUNIT_ASSERT(threw);
+        // the failed call left the only permit in the bucket
+        (m_client)->createConnection("localhost");
+        InvocationResponse response = (m_client)->invoke(proc);
+        CPPUNIT_ASSERT(response.success());
+        CPPUNIT_ASSERT(m_client->getStats().m_rateLimitedRequests == 0);
+    }
+
+    void testConnectionsPerHost() {
+        ClientConfig config("hello", "world", *m_dlistener);
+        config.m_connectionsPerHost = 3;
+        m_voltdb.reset(NULL);
+        m_voltdb.reset(new MockVoltDB(Client::create(config)));
+        m_client = m_voltdb->client();
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        CPPUNIT_ASSERT(m_voltdb->m_connections.size() == 3);
+
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        CountingCallback *cb = new CountingCallback(30);
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        for (int ii = 0; ii < 30; ii++) {
+            (m_client)->invoke( proc, callback);
+        }
+        (m_client)->drain();
+        CPPUNIT_ASSERT(cb->m_count == 0);
+    }
+
+    class RecordingConnectionCallback : public voltdb::ConnectionCallback {
+    public:
+        RecordingConnectionCallback() : m_connected(0), m_completed(false), m_completedConnected(-1) {}
+
+        bool connected(const std::string &hostname, unsigned short port) {
+            CPPUNIT_ASSERT(!m_completed);
+            m_connected++;
+            return false;
+        }
+
+        bool completed(int32_t connected, const std::vector<std::string> &failed) {
+            m_completed = true;
+            m_completedConnected = connected;
+            m_failed = failed;
+            return true;
+        }
+        int32_t m_connected;
+        bool m_completed;
+        int32_t m_completedConnected;
+        std::vector<std::string> m_failed;
+    };
+
+    void testCreateConnectionsAsync() {
+        std::vector<std::string> hosts;
+        hosts.push_back("localhost");
+        hosts.push_back("127.0.0.1");
+        RecordingConnectionCallback *cb = new RecordingConnectionCallback();
+        boost::shared_ptr<ConnectionCallback> callback(cb);
+        (m_client)->createConnectionsAsync(hosts, callback);
+        // nothing is established until the event loop runs
+        CPPUNIT_ASSERT(cb->m_connected == 0);
+        while (!cb->m_completed) {
+            (m_client)->run();
+        }
+        CPPUNIT_ASSERT(cb->m_connected == 2);
+        CPPUNIT_ASSERT(cb->m_completedConnected == 2);
+        CPPUNIT_ASSERT(cb->m_failed.empty());
+        CPPUNIT_ASSERT(m_voltdb->m_connections.size() == 2);
+
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        InvocationResponse response = (m_client)->invoke(proc);
+        CPPUNIT_ASSERT(response.success());
+
+        // nothing listens on this port
+        cb = new RecordingConnectionCallback();
+        callback.reset(cb);
+        (m_client)->createConnectionsAsync(hosts, callback, 21213);
+        while (!cb->m_completed) {
+            (m_client)->run();
+        }
+        CPPUNIT_ASSERT(cb->m_connected == 0);
+        CPPUNIT_ASSERT(cb->m_completedConnected == 0);
+        CPPUNIT_ASSERT(cb->m_failed.size() == 2);
+    }
+
+    /*
+     * The overview lists the seed host as localhost and a second host at 127.0.0.1, which
+     * is the mock again under another address
+     */
+    void testDiscoverHosts() {
+        ClientConfig config("hello", "world", *m_dlistener);
+        config.m_discoverHosts = true;
+        m_voltdb.reset(NULL);
+        m_voltdb.reset(new MockVoltDB(Client::create(config)));
+        m_client = m_voltdb->client();
+        m_voltdb->filenameForNextResponse("system_information_overview.msg");
+        (m_client)->createConnection("localhost");
+        for (int ii = 0; ii < 1000 && m_voltdb->m_connections.size() < 2; ii++) {
+            (m_client)->runOnce();
+        }
+        CPPUNIT_ASSERT(m_voltdb->m_connections.size() == 2);
+
+        // discovery from the new connection finds both hosts connected
+        for (int ii = 0; ii < 100; ii++) {
+            (m_client)->runOnce();
+        }
+        CPPUNIT_ASSERT(m_voltdb->m_connections.size() == 2);
+    }
+
+    /*
+     * The first attempt is made as soon as the connection is lost and fails because the mock
+     * still hangs up, the next one follows after the initial backoff delay
+     */
+    void testReconnectAfterLostConnection() {
+        class Listener : public StatusListener {
+        public:
+            int32_t activeReported;
+            Listener() : activeReported(0) {}
+            virtual bool uncaughtException(
+                    std::exception exception,
+                    boost::shared_ptr<voltdb::ProcedureCallback> callback,
+                    InvocationResponse response) {
+                CPPUNIT_ASSERT(false);
+                return false;
+            }
+            virtual bool connectionLost(std::string hostname, int32_t connectionsLeft) {
+                return false;
+            }
+            virtual bool connectionActive(std::string hostname, int32_t connectionsLeft) {
+                activeReported++;
+                return false;
+            }
+            virtual bool backpressure(bool hasBackpressure) {
+                return false;
+            }
+        }  listener;
+        (*m_dlistener)->m_listener = &listener;
+        (m_client)->createConnection("localhost");
+        CPPUNIT_ASSERT(listener.activeReported == 1);
+
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        proc.params();
+        m_voltdb->hangupOnRequestCount(1);
+        InvocationResponse response = (m_client)->invoke(proc);
+        CPPUNIT_ASSERT(response.statusCode() == voltdb::STATUS_CODE_CONNECTION_LOST);
+        for (int ii = 0; ii < 10; ii++) {
+            (m_client)->runOnce();
+        }
+
+        m_voltdb->hangupOnRequestCount(-1);
+        for (int ii = 0; ii < 2000 && listener.activeReported < 2; ii++) {
+            (m_client)->runOnce();
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+        CPPUNIT_ASSERT(listener.activeReported == 2);
+    }
+
+    /*
+     * Resends its request twice when the connection it was sent on is lost, which with round
+     * robin selection would put one copy on each connection still in the policy
+     */
+    class RetryOnLostCallback : public voltdb::ProcedureCallback {
+    public:
+        RetryOnLostCallback(Client *client, MockVoltDB *voltdb, Procedure *proc) :
+            m_client(client), m_voltdb(voltdb), m_proc(proc), m_retry(new CountingCallback(2)), m_lost(0) {}
+        bool callback(voltdb::InvocationResponse response) throw (voltdb::Exception) {
+            if (response.statusCode() == voltdb::STATUS_CODE_CONNECTION_LOST) {
+                m_lost++;
+                m_voltdb->hangupOnRequestCount(-1);
+                m_client->invoke(*m_proc, m_retry);
+                m_client->invoke(*m_proc, m_retry);
+            }
+            return false;
+        }
+        Client *m_client;
+        MockVoltDB *m_voltdb;
+        Procedure *m_proc;
+        boost::shared_ptr<ProcedureCallback> m_retry;
+        int32_t m_lost;
+    };
+
+    void testRetryFromLostConnectionCallback() {
+        ClientConfig config("hello", "world", *m_dlistener);
+        config.m_connectionsPerHost = 2;
+        config.m_connectionSelection = SELECT_ROUND_ROBIN;
+        m_voltdb.reset(NULL);
+        m_voltdb.reset(new MockVoltDB(Client::create(config)));
+        m_client = m_voltdb->client();
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        RetryOnLostCallback *cb = new RetryOnLostCallback(m_client, m_voltdb.get(), &proc);
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        // the server hangs up the connection the request arrives on
+        m_voltdb->hangupOnRequestCount(1);
+        (m_client)->invoke(proc, callback);
+        CountingCallback *retry = static_cast<CountingCallback*>(cb->m_retry.get());
+        for (int ii = 0; ii < 2000 && retry->m_count > 0; ii++) {
+            (m_client)->runOnce();
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+        // the retries went to the surviving connection rather than the one being torn down
+        CPPUNIT_ASSERT(cb->m_lost == 1);
+        CPPUNIT_ASSERT(retry->m_count == 0);
+        CPPUNIT_ASSERT((m_client)->outstandingRequests() == 0);
+    }
+
+    void testReconnectAttemptExpires() {
+        class Listener : public StatusListener {
+        public:
+            int32_t activeReported;
+            Listener() : activeReported(0) {}
+            virtual bool uncaughtException(
+                    std::exception exception,
+                    boost::shared_ptr<voltdb::ProcedureCallback> callback,
+                    InvocationResponse response) {
+                CPPUNIT_ASSERT(false);
+                return false;
+            }
+            virtual bool connectionLost(std::string hostname, int32_t connectionsLeft) {
+                return false;
+            }
+            virtual bool connectionActive(std::string hostname, int32_t connectionsLeft) {
+                activeReported++;
+                return false;
+            }
+            virtual bool backpressure(bool hasBackpressure) {
+                return false;
+            }
+        }  listener;
+        (*m_dlistener)->m_listener = &listener;
+        ClientConfig config("hello", "world", *m_dlistener);
+        config.m_reconnectInitialDelayMillis = 10;
+        config.m_reconnectTimeoutMillis = 50;
+        m_voltdb.reset(NULL);
+        m_voltdb.reset(new MockVoltDB(Client::create(config)));
+        m_client = m_voltdb->client();
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        (m_client)->createConnection("localhost");
+        CPPUNIT_ASSERT(listener.activeReported == 1);
+
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        proc.params();
+        m_voltdb->hangupOnRequestCount(1);
+        InvocationResponse response = (m_client)->invoke(proc);
+        CPPUNIT_ASSERT(response.statusCode() == voltdb::STATUS_CODE_CONNECTION_LOST);
+        m_voltdb->hangupOnRequestCount(-1);
+
+        // the server accepts the reconnection but never answers its login
+        m_voltdb->answerLogins(false);
+        for (int ii = 0; ii < 200; ii++) {
+            (m_client)->runOnce();
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+        CPPUNIT_ASSERT(listener.activeReported == 1);
+        const size_t stuckAttempts = m_voltdb->m_connections.size();
+        CPPUNIT_ASSERT(stuckAttempts >= 2);
+
+        // expired attempts are retried, so the client reconnects once logins are answered
+        m_voltdb->answerLogins(true);
+        for (int ii = 0; ii < 2000 && listener.activeReported < 2; ii++) {
+            (m_client)->runOnce();
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+        CPPUNIT_ASSERT(listener.activeReported == 2);
+        CPPUNIT_ASSERT(m_voltdb->m_connections.size() > stuckAttempts);
+        (*m_dlistener)->m_listener = NULL;
+    }
+
 private:
     Client *m_client;
     boost::scoped_ptr<MockVoltDB> m_voltdb;
@@ -0,0 +1,98 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include "ConcurrencyLimit.h"
+
+namespace voltdb {
+
+class ConcurrencyLimitTest : public CppUnit::TestFixture {
+CPPUNIT_TEST_SUITE( ConcurrencyLimitTest );
+CPPUNIT_TEST( testGrowsWhileBusy );
+CPPUNIT_TEST( testShrinksOnSlowResponses );
+CPPUNIT_TEST( testTimeouts );
+CPPUNIT_TEST( testBounds );
+CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testGrowsWhileBusy() {
+        ConcurrencyLimit limit(10, 1, 100);
+        CPPUNIT_ASSERT(limit.limit() == 10);
+        // a connection using little of its limit gives no reason to raise it
+        for (int ii = 0; ii < 10; ii++) {
+            limit.completed(1000, 2);
+        }
+        CPPUNIT_ASSERT(limit.limit() == 10);
+        for (int ii = 0; ii < 10; ii++) {
+            limit.completed(1000, limit.limit());
+        }
+        CPPUNIT_ASSERT(limit.limit() == 20);
+        // nor does one using less than half of it
+        limit.completed(1000, 9);
+        CPPUNIT_ASSERT(limit.limit() == 20);
+        CPPUNIT_ASSERT(limit.noLoadLatencyMicros() == 1000);
+    }
+
+    void testShrinksOnSlowResponses() {
+        ConcurrencyLimit limit(40, 1, 100);
+        limit.completed(1000, 1);
+        // cut once for the first slow response after a limit's worth of responses
+        for (int ii = 0; ii < 38; ii++) {
+            limit.completed(5000, 40);
+        }
+        CPPUNIT_ASSERT(limit.limit() == 40);
+        limit.completed(5000, 40);
+        CPPUNIT_ASSERT(limit.limit() == 36);
+        limit.completed(5000, 40);
+        CPPUNIT_ASSERT(limit.limit() == 36);
+        // responses within twice the no-load latency do not count as slow
+        ConcurrencyLimit tolerant(40, 1, 100);
+        tolerant.completed(1000, 40);
+        for (int ii = 0; ii < 10; ii++) {
+            tolerant.completed(1900, 40);
+        }
+        CPPUNIT_ASSERT(tolerant.limit() == 51);
+    }
+
+    void testTimeouts() {
+        ConcurrencyLimit limit(4, 1, 100);
+        for (int ii = 0; ii < 4; ii++) {
+            limit.timedOut();
+        }
+        CPPUNIT_ASSERT(limit.limit() == 3);
+    }
+
+    void testBounds() {
+        ConcurrencyLimit limit(500, 2, 100);
+        CPPUNIT_ASSERT(limit.limit() == 100);
+        limit.completed(1000, 100);
+        CPPUNIT_ASSERT(limit.limit() == 100);
+        for (int ii = 0; ii < 10000; ii++) {
+            limit.timedOut();
+        }
+        CPPUNIT_ASSERT(limit.limit() == 2);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( ConcurrencyLimitTest );
+}
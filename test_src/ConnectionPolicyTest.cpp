@@ -0,0 +1,193 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include "ConnectionPolicy.h"
+
+namespace voltdb {
+
+class ConnectionPolicyTest : public CppUnit::TestFixture {
+CPPUNIT_TEST_SUITE( ConnectionPolicyTest );
+CPPUNIT_TEST( testRoundRobin );
+CPPUNIT_TEST( testLeastOutstanding );
+CPPUNIT_TEST( testLeastOutstandingTiesRotate );
+CPPUNIT_TEST( testLeastLatency );
+CPPUNIT_TEST( testBackpressure );
+CPPUNIT_TEST( testLimit );
+CPPUNIT_TEST( testRemoveConnection );
+CPPUNIT_TEST_SUITE_END();
+
+public:
+    /*
+     * A policy over loads numbered from 1, which it does not own
+     */
+    class Policy {
+    public:
+        Policy(ConnectionSelection selection, int connections) :
+            m_policy(ConnectionPolicy::create(selection)) {
+            for (int ii = 0; ii <= connections; ii++) {
+                m_loads.push_back(ConnectionLoad(reinterpret_cast<struct bufferevent*>(ii)));
+            }
+            for (int ii = 1; ii <= connections; ii++) {
+                m_policy->addConnection(&m_loads[ii]);
+            }
+        }
+
+        ConnectionPolicy *operator->() {
+            return m_policy.get();
+        }
+
+        ConnectionLoad &operator[](int id) {
+            return m_loads[id];
+        }
+
+        /*
+         * Number of the selected load or 0 if there was none
+         */
+        int select(bool skipBackpressured = false) {
+            ConnectionLoad *load = m_policy->select(skipBackpressured);
+            return load == NULL ? 0 : static_cast<int>(load - &m_loads[0]);
+        }
+
+    private:
+        boost::scoped_ptr<ConnectionPolicy> m_policy;
+        std::vector<ConnectionLoad> m_loads;
+    };
+
+    void testRoundRobin() {
+        Policy policy(SELECT_ROUND_ROBIN, 3);
+        // load makes no difference
+        policy->sent(policy[2]);
+        policy->sent(policy[2]);
+        CPPUNIT_ASSERT(policy.select() == 2);
+        CPPUNIT_ASSERT(policy.select() == 3);
+        CPPUNIT_ASSERT(policy.select() == 1);
+        CPPUNIT_ASSERT(policy.select() == 2);
+        CPPUNIT_ASSERT(!policy->tracksLatency());
+    }
+
+    void testLeastOutstanding() {
+        Policy policy(SELECT_LEAST_OUTSTANDING, 3);
+        policy->sent(policy[1]);
+        policy->sent(policy[1]);
+        policy->sent(policy[2]);
+        for (int ii = 0; ii < 3; ii++) {
+            CPPUNIT_ASSERT(policy.select() == 3);
+        }
+        policy->sent(policy[3]);
+        policy->sent(policy[3]);
+        CPPUNIT_ASSERT(policy.select() == 2);
+        policy->completed(policy[1], -1);
+        policy->completed(policy[1], -1);
+        CPPUNIT_ASSERT(policy.select() == 1);
+        CPPUNIT_ASSERT(policy[1].m_outstanding == 0);
+        // a completion that was never counted does not go negative
+        policy->completed(policy[1], -1);
+        CPPUNIT_ASSERT(policy[1].m_outstanding == 0);
+    }
+
+    void testLeastOutstandingTiesRotate() {
+        Policy policy(SELECT_LEAST_OUTSTANDING, 3);
+        int picked[4] = { 0, 0, 0, 0 };
+        for (int ii = 0; ii < 300; ii++) {
+            int chosen = policy.select();
+            picked[chosen]++;
+            policy->sent(policy[chosen]);
+            policy->completed(policy[chosen], -1);
+        }
+        CPPUNIT_ASSERT(picked[1] == 100 && picked[2] == 100 && picked[3] == 100);
+    }
+
+    void testLeastLatency() {
+        Policy policy(SELECT_LEAST_LATENCY, 2);
+        CPPUNIT_ASSERT(policy->tracksLatency());
+        for (int ii = 0; ii < 4; ii++) {
+            policy->sent(policy[1]);
+            policy->completed(policy[1], 100);
+            policy->sent(policy[2]);
+            policy->completed(policy[2], 10000);
+        }
+        CPPUNIT_ASSERT(policy[1].m_latencyMicros == 100);
+        for (int ii = 0; ii < 10; ii++) {
+            CPPUNIT_ASSERT(policy.select() == 1);
+            policy->sent(policy[1]);
+        }
+        // once enough is queued on the fast connection the slow one is cheaper
+        for (int ii = 0; ii < 100; ii++) {
+            policy->sent(policy[1]);
+        }
+        CPPUNIT_ASSERT(policy.select() == 2);
+
+        // the average follows a connection that slows down
+        Policy drifting(SELECT_LEAST_LATENCY, 1);
+        drifting->sent(drifting[1]);
+        drifting->completed(drifting[1], 100);
+        drifting->sent(drifting[1]);
+        drifting->completed(drifting[1], 500);
+        CPPUNIT_ASSERT(drifting[1].m_latencyMicros == 200);
+    }
+
+    void testBackpressure() {
+        Policy policy(SELECT_LEAST_OUTSTANDING, 2);
+        policy->sent(policy[2]);
+        policy[1].m_backpressured = true;
+        CPPUNIT_ASSERT(policy.select(true) == 2);
+        policy[2].m_backpressured = true;
+        CPPUNIT_ASSERT(policy.select(true) == 0);
+        CPPUNIT_ASSERT(policy.select(false) == 1);
+
+        Policy roundRobin(SELECT_ROUND_ROBIN, 2);
+        roundRobin[1].m_backpressured = true;
+        for (int ii = 0; ii < 3; ii++) {
+            CPPUNIT_ASSERT(roundRobin.select(true) == 2);
+        }
+    }
+
+    void testLimit() {
+        Policy policy(SELECT_ROUND_ROBIN, 2);
+        policy[1].m_limit = 1;
+        policy->sent(policy[1]);
+        for (int ii = 0; ii < 3; ii++) {
+            CPPUNIT_ASSERT(policy.select(true) == 2);
+        }
+        policy->completed(policy[1], -1);
+        CPPUNIT_ASSERT(policy.select(true) == 1);
+    }
+
+    void testRemoveConnection() {
+        Policy policy(SELECT_LEAST_OUTSTANDING, 2);
+        policy->sent(policy[2]);
+        policy->removeConnection(&policy[1]);
+        CPPUNIT_ASSERT(policy.select() == 2);
+        // removing a connection twice is harmless
+        policy->removeConnection(&policy[1]);
+        policy->removeConnection(&policy[2]);
+        CPPUNIT_ASSERT(policy.select() == 0);
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ConnectionPolicyTest );
+}
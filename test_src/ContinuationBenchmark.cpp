@@ -0,0 +1,148 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Per-request cost of the ways an application can be told about a response: a callback
+ * object allocated for every request, one callback shared by all of them as in the async
+ * examples, and a pooled future with a continuation attached. The client runs on the
+ * calling thread and is driven by drain() after each window of requests. The mock server
+ * runs on its own thread and event base.
+ * Must be run from the repository root so the mock can find its canned responses.
+ *
+ * Usage: continuationbench [invocations per round]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "Client.h"
+#include "ClientConfig.h"
+#include "InvocationFuture.h"
+#include "MockVoltDB.h"
+#include "Procedure.hpp"
+#include "ProcedureCallback.hpp"
+
+using namespace voltdb;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+static int64_t completed = 0;
+
+class CountingCallback : public ProcedureCallback {
+public:
+    bool callback(InvocationResponse response) throw (voltdb::Exception) {
+        completed++;
+        return false;
+    }
+};
+
+static void count(const InvocationResponse &response) {
+    completed++;
+}
+
+static void serve(MockVoltDB *mock, boost::atomic<bool> *stop) {
+    while (!*stop) {
+        mock->run();
+    }
+}
+
+static const int64_t WINDOW = 5000;
+
+enum Mode {
+    CALLBACK_PER_REQUEST,
+    SHARED_CALLBACK,
+    FUTURE_THEN
+};
+
+static void round(Client &client, Procedure &proc, Mode mode, int64_t invocations) {
+    boost::shared_ptr<ProcedureCallback> shared(new CountingCallback());
+    for (int64_t sent = 0; sent < invocations; sent += WINDOW) {
+        for (int64_t ii = 0; ii < WINDOW; ii++) {
+            proc.params()->addInt64(sent + ii);
+            switch (mode) {
+            case CALLBACK_PER_REQUEST:
+                client.invoke(proc, boost::shared_ptr<ProcedureCallback>(new CountingCallback()));
+                break;
+            case SHARED_CALLBACK:
+                client.invoke(proc, shared);
+                break;
+            case FUTURE_THEN:
+                client.invokeAsync(proc).then(count);
+                break;
+            }
+        }
+        client.drain();
+    }
+}
+
+int main(int argc, char **argv) {
+    int64_t invocations = argc > 1 ? atoll(argv[1]) : 400000;
+    invocations -= invocations % WINDOW;
+
+    MockVoltDB mock(Client::create(ClientConfig("hello", "world")));
+    mock.filenameForNextResponse("invocation_response_success.msg");
+    boost::atomic<bool> stopServer(false);
+    boost::thread server(boost::bind(serve, &mock, &stopServer));
+
+    ClientConfig config("hello", "world");
+    config.m_maxOutstandingRequests = static_cast<int32_t>(WINDOW * 2);
+    Client client = Client::create(config);
+    client.createConnection("localhost");
+
+    std::vector<Parameter> signature;
+    signature.push_back(Parameter(WIRE_TYPE_BIGINT));
+    Procedure proc("Insert", signature);
+
+    const char *names[] = { "callback per request", "shared callback", "future + then" };
+    const Mode modes[] = { CALLBACK_PER_REQUEST, SHARED_CALLBACK, FUTURE_THEN };
+    // warm up the connection and the future pool
+    round(client, proc, FUTURE_THEN, WINDOW);
+
+    printf("%lld invocations per round\n", static_cast<long long>(invocations));
+    printf("%-22s %12s %10s\n", "completion", "req/s", "ns/req");
+    for (size_t ii = 0; ii < sizeof modes / sizeof modes[0]; ii++) {
+        completed = 0;
+        double start = now();
+        round(client, proc, modes[ii], invocations);
+        double secs = now() - start;
+        if (completed != invocations) {
+            printf("%-22s completed %lld of %lld\n", names[ii], static_cast<long long>(completed),
+                   static_cast<long long>(invocations));
+            continue;
+        }
+        printf("%-22s %12.0f %10.0f\n", names[ii], static_cast<double>(invocations) / secs,
+               secs * 1e9 / static_cast<double>(invocations));
+    }
+
+    stopServer = true;
+    mock.interrupt();
+    server.join();
+    return 0;
+}
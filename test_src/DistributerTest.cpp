@@ -0,0 +1,472 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include "Distributer.h"
+#include "ElasticHashinator.h"
+#include "Procedure.hpp"
+#include "Parameter.hpp"
+#include "ParameterSet.hpp"
+#include "Decimal.hpp"
+
+namespace voltdb {
+
+/*
+ * Routing must land every invocation on the partition the server would pick for it. The
+ * server converts the partition parameter to the column's type and hashes integers by
+ * value as 8 little endian bytes, strings and binary values by their bytes, and nulls to
+ * partition 0. Each case is checked with the partition parameter at every position of a
+ * signature that mixes in every kind of parameter the client can send.
+ */
+class DistributerTest : public CppUnit::TestFixture {
+CPPUNIT_TEST_SUITE( DistributerTest );
+CPPUNIT_TEST( testIntegerHashesLittleEndianBytes );
+CPPUNIT_TEST( testIntegersAtEveryPosition );
+CPPUNIT_TEST( testIntegerWidthsAgree );
+CPPUNIT_TEST( testNulls );
+CPPUNIT_TEST( testStringAndBinaryAtEveryPosition );
+CPPUNIT_TEST( testUnroutable );
+CPPUNIT_TEST( testWatchedParameterOffset );
+CPPUNIT_TEST( testSnapshotPublishing );
+CPPUNIT_TEST( testAbortUpdate );
+CPPUNIT_TEST( testConcurrentPublishing );
+CPPUNIT_TEST( testLastTopologyDuringUpdate );
+CPPUNIT_TEST_SUITE_END();
+
+public:
+    static const int POSITIONS = 4;
+
+    void setUp() {
+        // four partitions evenly spaced around the ring
+        const int32_t tokenCount = 4;
+        char ring[4 + tokenCount * 8];
+        const int32_t count = htonl(tokenCount);
+        memcpy(ring, &count, 4);
+        for (int32_t ii = 0; ii < tokenCount; ii++) {
+            const int32_t token = htonl(static_cast<int32_t>(INT32_MIN + static_cast<int64_t>(ii) * (1LL << 30)));
+            const int32_t partition = htonl(ii);
+            memcpy(ring + 4 + ii * 8, &token, 4);
+            memcpy(ring + 8 + ii * 8, &partition, 4);
+        }
+        m_hashinator = new ElasticHashinator(ring);
+        m_topology.m_hashinator.reset(m_hashinator);
+    }
+
+    /*
+     * A procedure with the partition parameter of the given type at position and filler of
+     * every other kind around it
+     */
+    static Procedure *procedure(int position, const Parameter &partitionParameter) {
+        const Parameter filler[] = {
+            Parameter(WIRE_TYPE_BIGINT, true),
+            Parameter(WIRE_TYPE_DECIMAL),
+            Parameter(WIRE_TYPE_STRING, true),
+            Parameter(WIRE_TYPE_VARBINARY),
+            Parameter(WIRE_TYPE_TINYINT, true),
+            Parameter(WIRE_TYPE_FLOAT),
+            Parameter(WIRE_TYPE_TIMESTAMP),
+            Parameter(WIRE_TYPE_STRING)
+        };
+        std::vector<Parameter> signature;
+        for (int ii = 0; ii < POSITIONS; ii++) {
+            signature.push_back(ii == position ? partitionParameter : filler[ii * 2 + (position % 2)]);
+        }
+        return new Procedure("Routed", signature);
+    }
+
+    /*
+     * Bind the filler parameters before or after the partition parameter at position
+     */
+    static void bindFiller(ParameterSet *params, int from, int to, int position) {
+        for (int ii = from; ii < to; ii++) {
+            switch (ii * 2 + (position % 2)) {
+            case 0:
+                params->addInt64(std::vector<int64_t>(3, 7));
+                break;
+            case 1:
+                params->addDecimal(Decimal(std::string("12.5")));
+                break;
+            case 2:
+                params->addString(std::vector<std::string>(2, "filler"));
+                break;
+            case 3:
+                params->addNull();
+                break;
+            case 4:
+                params->addInt8(std::vector<int8_t>(5, 1));
+                break;
+            case 5:
+                params->addDouble(1.5);
+                break;
+            case 6:
+                params->addTimestamp(123456789);
+                break;
+            default:
+                params->addString("after");
+                break;
+            }
+        }
+    }
+
+    int route(Procedure &proc, int position, int columnType) {
+        ByteBuffer params = proc.getParameterBuffer();
+        return m_topology.getHashedPartitionForParameter(params, position, columnType);
+    }
+
+    template <typename T>
+    int routeInteger(WireType type, T value, int position, int columnType) {
+        boost::scoped_ptr<Procedure> proc(procedure(position, Parameter(type)));
+        ParameterSet *params = proc->params();
+        bindFiller(params, 0, position, position);
+        switch (type) {
+        case WIRE_TYPE_TINYINT:
+            params->addInt8(static_cast<int8_t>(value));
+            break;
+        case WIRE_TYPE_SMALLINT:
+            params->addInt16(static_cast<int16_t>(value));
+            break;
+        case WIRE_TYPE_INTEGER:
+            params->addInt32(static_cast<int32_t>(value));
+            break;
+        default:
+            params->addInt64(static_cast<int64_t>(value));
+            break;
+        }
+        bindFiller(params, position + 1, POSITIONS, position);
+        return route(*proc, position, columnType);
+    }
+
+    int routeBytes(WireType type, const std::string &value, int position, int columnType) {
+        boost::scoped_ptr<Procedure> proc(procedure(position, Parameter(type, type == WIRE_TYPE_TINYINT)));
+        ParameterSet *params = proc->params();
+        bindFiller(params, 0, position, position);
+        if (type == WIRE_TYPE_STRING) {
+            params->addString(value);
+        } else if (type == WIRE_TYPE_VARBINARY) {
+            params->addBytes(static_cast<int32_t>(value.size()), reinterpret_cast<const uint8_t*>(value.data()));
+        } else {
+            params->addInt8(std::vector<int8_t>(value.begin(), value.end()));
+        }
+        bindFiller(params, position + 1, POSITIONS, position);
+        return route(*proc, position, columnType);
+    }
+
+    void testIntegerHashesLittleEndianBytes() {
+        const int64_t values[] = { 0, 1, -1, 42, 1234567890123LL, INT64_MAX };
+        for (size_t ii = 0; ii < sizeof values / sizeof values[0]; ii++) {
+            unsigned char bytes[8];
+            for (int jj = 0; jj < 8; jj++) {
+                bytes[jj] = static_cast<unsigned char>(static_cast<uint64_t>(values[ii]) >> (8 * jj));
+            }
+            CPPUNIT_ASSERT(m_hashinator->hashinate(values[ii]) ==
+                           m_hashinator->hashinate(reinterpret_cast<const char*>(bytes), 8));
+        }
+    }
+
+    void testIntegersAtEveryPosition() {
+        const int64_t values[] = { 0, 1, -1, 42, 1234567890123LL, INT64_MAX, INT64_MIN + 1 };
+        std::vector<bool> seen(4, false);
+        for (int position = 0; position < POSITIONS; position++) {
+            for (size_t ii = 0; ii < sizeof values / sizeof values[0]; ii++) {
+                const int expected = m_hashinator->hashinate(values[ii]);
+                seen[expected] = true;
+                CPPUNIT_ASSERT(routeInteger(WIRE_TYPE_BIGINT, values[ii], position, WIRE_TYPE_BIGINT) == expected);
+                CPPUNIT_ASSERT(routeInteger(WIRE_TYPE_BIGINT, values[ii], position, -1) == expected);
+            }
+        }
+        // the values are spread over more than one partition, so a fixed answer would fail
+        CPPUNIT_ASSERT(std::count(seen.begin(), seen.end(), true) > 1);
+    }
+
+    /*
+     * The server widens the parameter to the column's type before hashing it
+     */
+    void testIntegerWidthsAgree() {
+        const int64_t values[] = { 0, 5, -5, 100, -100, 127 };
+        const WireType types[] = { WIRE_TYPE_TINYINT, WIRE_TYPE_SMALLINT, WIRE_TYPE_INTEGER, WIRE_TYPE_BIGINT };
+        for (int position = 0; position < POSITIONS; position++) {
+            for (size_t ii = 0; ii < sizeof values / sizeof values[0]; ii++) {
+                const int expected = m_hashinator->hashinate(values[ii]);
+                for (size_t param = 0; param < 4; param++) {
+                    for (size_t column = 0; column < 4; column++) {
+                        CPPUNIT_ASSERT(routeInteger(types[param], values[ii], position, types[column]) == expected);
+                    }
+                }
+            }
+        }
+        CPPUNIT_ASSERT(routeInteger(WIRE_TYPE_INTEGER, 70000, 2, WIRE_TYPE_BIGINT) == m_hashinator->hashinate(70000));
+    }
+
+    void testNulls() {
+        for (int position = 0; position < POSITIONS; position++) {
+            CPPUNIT_ASSERT(routeInteger(WIRE_TYPE_TINYINT, INT8_MIN, position, WIRE_TYPE_BIGINT) == 0);
+            CPPUNIT_ASSERT(routeInteger(WIRE_TYPE_SMALLINT, INT16_MIN, position, WIRE_TYPE_INTEGER) == 0);
+            CPPUNIT_ASSERT(routeInteger(WIRE_TYPE_INTEGER, INT32_MIN, position, WIRE_TYPE_INTEGER) == 0);
+            CPPUNIT_ASSERT(routeInteger(WIRE_TYPE_BIGINT, INT64_MIN, position, WIRE_TYPE_BIGINT) == 0);
+
+            const int columnTypes[] = { WIRE_TYPE_BIGINT, WIRE_TYPE_STRING, WIRE_TYPE_VARBINARY, -1 };
+            for (size_t column = 0; column < 4; column++) {
+                boost::scoped_ptr<Procedure> proc(procedure(position, Parameter(WIRE_TYPE_STRING)));
+                ParameterSet *params = proc->params();
+                bindFiller(params, 0, position, position);
+                params->addNull();
+                bindFiller(params, position + 1, POSITIONS, position);
+                CPPUNIT_ASSERT(route(*proc, position, columnTypes[column]) == 0);
+            }
+        }
+    }
+
+    void testStringAndBinaryAtEveryPosition() {
+        const char *values[] = { "", "a", "Hello", "partition key", "\xff\x01 binary" };
+        std::vector<bool> seen(4, false);
+        for (int position = 0; position < POSITIONS; position++) {
+            for (size_t ii = 0; ii < sizeof values / sizeof values[0]; ii++) {
+                const std::string value(values[ii]);
+                const int expected = m_hashinator->hashinate(value.data(), static_cast<int32_t>(value.size()));
+                seen[expected] = true;
+                CPPUNIT_ASSERT(routeBytes(WIRE_TYPE_STRING, value, position, WIRE_TYPE_STRING) == expected);
+                CPPUNIT_ASSERT(routeBytes(WIRE_TYPE_STRING, value, position, -1) == expected);
+                CPPUNIT_ASSERT(routeBytes(WIRE_TYPE_VARBINARY, value, position, WIRE_TYPE_VARBINARY) == expected);
+                // a byte array is how other clients send VARBINARY
+                CPPUNIT_ASSERT(routeBytes(WIRE_TYPE_TINYINT, value, position, WIRE_TYPE_VARBINARY) == expected);
+            }
+        }
+        CPPUNIT_ASSERT(std::count(seen.begin(), seen.end(), true) > 1);
+    }
+
+    /*
+     * Conversions the client does not reproduce are left to the server
+     */
+    void testUnroutable() {
+        for (int position = 0; position < POSITIONS; position++) {
+            // the server parses strings for numeric columns and hex decodes them for binary ones
+            CPPUNIT_ASSERT(routeBytes(WIRE_TYPE_STRING, "42", position, WIRE_TYPE_BIGINT) == -1);
+            CPPUNIT_ASSERT(routeBytes(WIRE_TYPE_STRING, "2a", position, WIRE_TYPE_VARBINARY) == -1);
+            CPPUNIT_ASSERT(routeBytes(WIRE_TYPE_VARBINARY, "2a", position, WIRE_TYPE_STRING) == -1);
+            CPPUNIT_ASSERT(routeInteger(WIRE_TYPE_BIGINT, 42, position, WIRE_TYPE_STRING) == -1);
+
+            boost::scoped_ptr<Procedure> proc(procedure(position, Parameter(WIRE_TYPE_FLOAT)));
+            ParameterSet *params = proc->params();
+            bindFiller(params, 0, position, position);
+            params->addDouble(42.0);
+            bindFiller(params, position + 1, POSITIONS, position);
+            CPPUNIT_ASSERT(route(*proc, position, -1) == -1);
+        }
+
+        boost::scoped_ptr<Procedure> proc(procedure(0, Parameter(WIRE_TYPE_BIGINT)));
+        ParameterSet *params = proc->params();
+        params->addInt64(42);
+        bindFiller(params, 1, POSITIONS, 0);
+        CPPUNIT_ASSERT(route(*proc, 0, WIRE_TYPE_BIGINT) == m_hashinator->hashinate(static_cast<int64_t>(42)));
+        CPPUNIT_ASSERT(route(*proc, POSITIONS, WIRE_TYPE_BIGINT) == -1);
+        CPPUNIT_ASSERT(route(*proc, -1, WIRE_TYPE_BIGINT) == -1);
+    }
+
+    /*
+     * The offset recorded while binding leads to the same partition as walking the parameters
+     */
+    void testWatchedParameterOffset() {
+        for (int position = 0; position < POSITIONS; position++) {
+            boost::scoped_ptr<Procedure> proc(procedure(position, Parameter(WIRE_TYPE_STRING)));
+            ParameterSet *params = proc->params();
+            bindFiller(params, 0, position, position);
+            params->addString("Hello");
+            bindFiller(params, position + 1, POSITIONS, position);
+            CPPUNIT_ASSERT(proc->watchedParameterOffset() == -1);
+
+            proc->watchParameter(position);
+            for (int round = 0; round < 3; round++) {
+                params = proc->params();
+                CPPUNIT_ASSERT(proc->watchedParameterOffset() == -1);
+                bindFiller(params, 0, position, position);
+                if (round == 2) {
+                    params->addNull();
+                } else {
+                    params->addString(round == 0 ? "Hello" : "World");
+                }
+                bindFiller(params, position + 1, POSITIONS, position);
+
+                const int32_t offset = proc->watchedParameterOffset();
+                CPPUNIT_ASSERT(offset >= 2);
+                ByteBuffer buffer = proc->getParameterBuffer();
+                const int walked = m_topology.getHashedPartitionForParameter(buffer, position, WIRE_TYPE_STRING);
+                CPPUNIT_ASSERT(walked >= 0);
+                CPPUNIT_ASSERT(m_topology.getHashedPartitionAt(buffer, offset, WIRE_TYPE_STRING) == walked);
+            }
+        }
+    }
+
+    /*
+     * Publishing replaces the snapshot and leaves the one readers already have untouched
+     */
+    void testSnapshotPublishing() {
+        Distributer distributer;
+        boost::shared_ptr<const TopologySnapshot> initial = distributer.snapshot();
+        CPPUNIT_ASSERT(distributer.version() == initial->version());
+        CPPUNIT_ASSERT(initial->getHostIdByPartitionId(0) == -1);
+
+        distributer.startUpdate();
+        boost::shared_ptr<const TopologySnapshot> updating = distributer.snapshot();
+        CPPUNIT_ASSERT(updating != initial);
+        CPPUNIT_ASSERT(updating->isUpdating());
+        CPPUNIT_ASSERT(!initial->isUpdating());
+        CPPUNIT_ASSERT(distributer.version() == updating->version());
+        CPPUNIT_ASSERT(updating->version() > initial->version());
+        distributer.startUpdate();
+        CPPUNIT_ASSERT(distributer.snapshot() == updating);
+
+        publishHosts(distributer, 3, 7);
+        boost::shared_ptr<const TopologySnapshot> current = distributer.snapshot();
+        CPPUNIT_ASSERT(!current->isUpdating());
+        CPPUNIT_ASSERT(current->getHostIdByPartitionId(0) == 7);
+        CPPUNIT_ASSERT(current->getHostIdByPartitionId(2) == 7);
+        CPPUNIT_ASSERT(current->getHostIdByPartitionId(3) == -1);
+        CPPUNIT_ASSERT(current->getHostIdByPartitionId(-1) == -1);
+        CPPUNIT_ASSERT(current->getHostIdByPartitionId(Distributer::MP_INIT_PID) == 7);
+        CPPUNIT_ASSERT(updating->getHostIdByPartitionId(0) == -1);
+        CPPUNIT_ASSERT(current->m_procedures == updating->m_procedures);
+        CPPUNIT_ASSERT(current->procedureVersion() == updating->procedureVersion());
+    }
+
+    /*
+     * A failed topology fetch ends the update and keeps the mappings already published
+     */
+    void testAbortUpdate() {
+        Distributer distributer;
+        publishHosts(distributer, 3, 7);
+        boost::shared_ptr<const TopologySnapshot> known = distributer.snapshot();
+        distributer.abortUpdate();
+        CPPUNIT_ASSERT(distributer.snapshot() == known);
+
+        distributer.startUpdate();
+        boost::shared_ptr<const TopologySnapshot> updating = distributer.snapshot();
+        CPPUNIT_ASSERT(updating->isUpdating());
+        distributer.abortUpdate();
+        boost::shared_ptr<const TopologySnapshot> current = distributer.snapshot();
+        CPPUNIT_ASSERT(!current->isUpdating());
+        CPPUNIT_ASSERT(current->version() > updating->version());
+        CPPUNIT_ASSERT(distributer.version() == current->version());
+        CPPUNIT_ASSERT(current->getHostIdByPartitionId(0) == 7);
+        CPPUNIT_ASSERT(current->m_procedures == updating->m_procedures);
+    }
+
+    /*
+     * A reader refreshing its snapshot whenever the version moves, the way ClientImpl does,
+     * always sees a whole snapshot while another thread keeps publishing
+     */
+    void testConcurrentPublishing() {
+        Distributer distributer;
+        boost::atomic<bool> done(false);
+        boost::thread writer(boost::bind(&DistributerTest::publishMany, &distributer, 2000, &done));
+
+        boost::shared_ptr<const TopologySnapshot> topology = distributer.snapshot();
+        int64_t refreshes = 0;
+        bool consistent = true;
+        bool finished = false;
+        while (!finished) {
+            finished = done.load();
+            if (distributer.version() != topology->version()) {
+                topology = distributer.snapshot();
+                refreshes++;
+            }
+            const int expected = topology->getHostIdByPartitionId(Distributer::MP_INIT_PID);
+            for (int ii = 0; ii < 64; ii++) {
+                consistent = consistent && topology->getHostIdByPartitionId(ii) == expected;
+            }
+        }
+        writer.join();
+        CPPUNIT_ASSERT(consistent);
+        CPPUNIT_ASSERT(refreshes > 0);
+        CPPUNIT_ASSERT(topology->version() == distributer.version());
+        CPPUNIT_ASSERT(topology->getHostIdByPartitionId(0) == 2000);
+    }
+
+    /*
+     * Starting an update keeps the topology already received, so requests can still be
+     * routed with it until the new one is published
+     */
+    void testLastTopologyDuringUpdate() {
+        Distributer distributer;
+        CPPUNIT_ASSERT(!distributer.snapshot()->hasTopology());
+        distributer.startUpdate();
+        CPPUNIT_ASSERT(!distributer.snapshot()->hasTopology());
+
+        {
+            boost::mutex::scoped_lock lock(distributer.m_publishLock);
+            TopologySnapshot *next = new TopologySnapshot(*distributer.m_snapshot);
+            next->m_hashinator = m_topology.m_hashinator;
+            distributer.publish(next);
+        }
+        publishHosts(distributer, 4, 3);
+        boost::shared_ptr<const TopologySnapshot> known = distributer.snapshot();
+        CPPUNIT_ASSERT(known->hasTopology());
+        CPPUNIT_ASSERT(!known->isUpdating());
+
+        distributer.startUpdate();
+        boost::shared_ptr<const TopologySnapshot> updating = distributer.snapshot();
+        CPPUNIT_ASSERT(updating->isUpdating());
+        CPPUNIT_ASSERT(updating->hasTopology());
+        boost::scoped_ptr<Procedure> proc(procedure(0, Parameter(WIRE_TYPE_BIGINT)));
+        ParameterSet *params = proc->params();
+        params->addInt64(42);
+        bindFiller(params, 1, POSITIONS, 0);
+        ByteBuffer buffer = proc->getParameterBuffer();
+        const int partition = updating->getHashedPartitionForParameter(buffer, 0, WIRE_TYPE_BIGINT);
+        CPPUNIT_ASSERT(partition == m_hashinator->hashinate(static_cast<int64_t>(42)));
+        CPPUNIT_ASSERT(updating->getHostIdByPartitionId(partition) == 3);
+    }
+
+private:
+    static void publishHosts(Distributer &distributer, int partitions, int hostId) {
+        boost::mutex::scoped_lock lock(distributer.m_publishLock);
+        TopologySnapshot *next = new TopologySnapshot(*distributer.m_snapshot);
+        next->m_partitionToHostId.assign(partitions, hostId);
+        next->m_mpHostId = hostId;
+        next->m_isUpdating = false;
+        distributer.publish(next);
+    }
+
+    static void publishMany(Distributer *distributer, int count, boost::atomic<bool> *done) {
+        for (int ii = 1; ii <= count; ii++) {
+            publishHosts(*distributer, 64, ii);
+        }
+        *done = true;
+    }
+
+    TopologySnapshot m_topology;
+    ElasticHashinator *m_hashinator;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( DistributerTest );
+}
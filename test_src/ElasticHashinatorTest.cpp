@@ -0,0 +1,197 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "ElasticHashinator.h"
+
+namespace voltdb {
+
+class ElasticHashinatorTest : public CppUnit::TestFixture {
+CPPUNIT_TEST_SUITE( ElasticHashinatorTest );
+CPPUNIT_TEST( testTokenBoundaries );
+CPPUNIT_TEST( testMatchesSortedSearch );
+CPPUNIT_TEST( testWrapsBeforeFirstToken );
+CPPUNIT_TEST( testBatchMurmurHash );
+CPPUNIT_TEST( testHashinateBatch );
+CPPUNIT_TEST_SUITE_END();
+
+public:
+    /*
+     * Serialize a ring the way the server describes it
+     */
+    static std::vector<char> ring(const std::vector<int32_t> &tokens) {
+        std::vector<char> buffer(4 + tokens.size() * 8);
+        const int32_t count = htonl(static_cast<int32_t>(tokens.size()));
+        memcpy(&buffer[0], &count, 4);
+        for (size_t ii = 0; ii < tokens.size(); ii++) {
+            const int32_t token = htonl(tokens[ii]);
+            const int32_t partition = htonl(static_cast<int32_t>(ii % 7));
+            memcpy(&buffer[4 + ii * 8], &token, 4);
+            memcpy(&buffer[8 + ii * 8], &partition, 4);
+        }
+        return buffer;
+    }
+
+    /*
+     * Partition of the last token at or before hash in the sorted ring
+     */
+    static int32_t expected(const std::vector<int32_t> &tokens, int32_t hash) {
+        size_t index = std::upper_bound(tokens.begin(), tokens.end(), hash) - tokens.begin();
+        index = index == 0 ? tokens.size() - 1 : index - 1;
+        return static_cast<int32_t>(index % 7);
+    }
+
+    static std::vector<int32_t> randomTokens(size_t count) {
+        std::vector<int32_t> tokens;
+        tokens.push_back(INT32_MIN);
+        while (tokens.size() < count) {
+            tokens.push_back(static_cast<int32_t>((static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand())));
+        }
+        std::sort(tokens.begin(), tokens.end());
+        tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+        return tokens;
+    }
+
+    void testTokenBoundaries() {
+        std::vector<int32_t> tokens;
+        for (int32_t ii = 0; ii < 10; ii++) {
+            tokens.push_back(INT32_MIN + ii * 1000);
+        }
+        std::vector<char> buffer = ring(tokens);
+        ElasticHashinator hashinator(&buffer[0]);
+        for (size_t ii = 0; ii < tokens.size(); ii++) {
+            CPPUNIT_ASSERT(hashinator.partitionForToken(tokens[ii]) == static_cast<int32_t>(ii % 7));
+            CPPUNIT_ASSERT(hashinator.partitionForToken(tokens[ii] + 999) == static_cast<int32_t>(ii % 7));
+        }
+        CPPUNIT_ASSERT(hashinator.partitionForToken(INT32_MAX) == 9 % 7);
+    }
+
+    /*
+     * Every ring size, so that trees of every shape, full or not, are covered
+     */
+    void testMatchesSortedSearch() {
+        srand(42);
+        for (size_t count = 1; count <= 300; count++) {
+            std::vector<int32_t> tokens = randomTokens(count);
+            std::vector<char> buffer = ring(tokens);
+            ElasticHashinator hashinator(&buffer[0]);
+            for (size_t ii = 0; ii < tokens.size(); ii++) {
+                CPPUNIT_ASSERT(hashinator.partitionForToken(tokens[ii]) == expected(tokens, tokens[ii]));
+                if (tokens[ii] != INT32_MAX) {
+                    CPPUNIT_ASSERT(hashinator.partitionForToken(tokens[ii] + 1) == expected(tokens, tokens[ii] + 1));
+                }
+                if (tokens[ii] != INT32_MIN) {
+                    CPPUNIT_ASSERT(hashinator.partitionForToken(tokens[ii] - 1) == expected(tokens, tokens[ii] - 1));
+                }
+            }
+            for (int ii = 0; ii < 50; ii++) {
+                const int32_t hash = static_cast<int32_t>((static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand()));
+                CPPUNIT_ASSERT(hashinator.partitionForToken(hash) == expected(tokens, hash));
+            }
+        }
+    }
+
+    /*
+     * Positions before the first token belong to the last one, as the ring wraps
+     */
+    void testWrapsBeforeFirstToken() {
+        std::vector<int32_t> tokens;
+        tokens.push_back(-100);
+        tokens.push_back(0);
+        tokens.push_back(100);
+        std::vector<char> buffer = ring(tokens);
+        ElasticHashinator hashinator(&buffer[0]);
+        CPPUNIT_ASSERT(hashinator.partitionForToken(INT32_MIN) == 2);
+        CPPUNIT_ASSERT(hashinator.partitionForToken(-101) == 2);
+        CPPUNIT_ASSERT(hashinator.partitionForToken(-100) == 0);
+        CPPUNIT_ASSERT(hashinator.partitionForToken(50) == 1);
+    }
+
+    /*
+     * Batches of every length up to a few lanes past the lane count, so the tail is covered
+     */
+    void testBatchMurmurHash() {
+        srand(7);
+        std::vector<int64_t> values;
+        values.push_back(0);
+        values.push_back(-1);
+        values.push_back(INT64_MIN);
+        values.push_back(INT64_MAX);
+        while (values.size() < 23) {
+            values.push_back((static_cast<int64_t>(rand()) << 32) ^ rand());
+        }
+        for (size_t count = 0; count <= values.size(); count++) {
+            std::vector<int32_t> hashes(count + 1, 42);
+            MurmurHash3_x64_128_batch(&values[0], count, &hashes[0]);
+            for (size_t ii = 0; ii < count; ii++) {
+                CPPUNIT_ASSERT(hashes[ii] == MurmurHash3_x64_128(values[ii]));
+            }
+            CPPUNIT_ASSERT(hashes[count] == 42);
+        }
+    }
+
+    void testHashinateBatch() {
+        srand(11);
+        std::vector<char> buffer = ring(randomTokens(500));
+        ElasticHashinator elastic(&buffer[0]);
+        const TheHashinator &hashinator = elastic;
+
+        std::vector<int64_t> values;
+        values.push_back(INT64_MIN);
+        while (values.size() < 1001) {
+            values.push_back((static_cast<int64_t>(rand()) << 32) ^ rand());
+        }
+        std::vector<int32_t> partitions(values.size());
+        hashinator.hashinateBatch(&values[0], values.size(), &partitions[0]);
+        CPPUNIT_ASSERT(partitions[0] == 0);
+        for (size_t ii = 0; ii < values.size(); ii++) {
+            CPPUNIT_ASSERT(partitions[ii] == hashinator.hashinate(values[ii]));
+        }
+
+        std::vector<std::string> keys;
+        keys.push_back("");
+        while (keys.size() < 100) {
+            keys.push_back(std::string(keys.size(), static_cast<char>('a' + rand() % 26)));
+        }
+        std::vector<const char*> strings;
+        std::vector<int32_t> lengths;
+        for (size_t ii = 0; ii < keys.size(); ii++) {
+            strings.push_back(keys[ii].data());
+            lengths.push_back(static_cast<int32_t>(keys[ii].size()));
+        }
+        partitions.assign(keys.size(), -1);
+        hashinator.hashinateBatch(&strings[0], &lengths[0], keys.size(), &partitions[0]);
+        for (size_t ii = 0; ii < keys.size(); ii++) {
+            CPPUNIT_ASSERT(partitions[ii] == hashinator.hashinate(strings[ii], lengths[ii]));
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ElasticHashinatorTest );
+}
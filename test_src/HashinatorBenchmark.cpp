@@ -0,0 +1,158 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Compares token lookup in ElasticHashinator before and after the ring was laid out in
+ * Eytzinger order. The old lookup, copied here, ran a branchy binary search over an array
+ * of interleaved hash and partition pairs. Both lookups are run over the same random
+ * hashes and their checksums must agree. Then hashing values one at a time through
+ * TheHashinator is compared with hashing them a batch at a time with hashinateBatch.
+ *
+ * Usage: hashinatorbench [lookups]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include <vector>
+#include <arpa/inet.h>
+#include "ElasticHashinator.h"
+
+using namespace voltdb;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+static int32_t randomHash() {
+    return static_cast<int32_t>((static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand()));
+}
+
+static int32_t interleavedLookup(const std::vector<int32_t> &tokens, int32_t hash) {
+    int32_t min = 0;
+    int32_t max = static_cast<int32_t>(tokens.size() / 2) - 1;
+    while (min <= max) {
+        uint32_t mid = (min + max) >> 1;
+        int32_t midval = tokens[mid * 2];
+        if (midval < hash) {
+            min = mid + 1;
+        } else if (midval > hash) {
+            max = mid - 1;
+        } else {
+            return tokens[mid * 2 + 1];
+        }
+    }
+    return tokens[(min - 1) * 2 + 1];
+}
+
+static const size_t BATCH_SIZE = 1024;
+
+int main(int argc, char **argv) {
+    int64_t lookups = argc > 1 ? atoll(argv[1]) : 20000000;
+    const uint32_t sizes[] = { 1024, 4096, 16384, 65536 };
+
+    srand(1);
+    std::vector<int32_t> hashes(1 << 16);
+    std::vector<int64_t> values(1 << 16);
+    for (size_t ii = 0; ii < hashes.size(); ii++) {
+        hashes[ii] = randomHash();
+        values[ii] = (static_cast<int64_t>(randomHash()) << 32) ^ randomHash();
+    }
+    std::vector<int32_t> partitions(BATCH_SIZE);
+    std::vector<double> singleNanos, batchNanos;
+
+    printf("%lld lookups per ring\n", static_cast<long long>(lookups));
+    printf("%-8s %18s %18s %8s\n", "tokens", "binary ns/op", "eytzinger ns/op", "same");
+    for (size_t ss = 0; ss < sizeof(sizes) / sizeof(sizes[0]); ss++) {
+        // the server always places a token at the start of the ring
+        std::vector<int32_t> sorted;
+        sorted.push_back(INT32_MIN);
+        while (sorted.size() < sizes[ss]) {
+            sorted.push_back(randomHash());
+            if (sorted.size() == sizes[ss]) {
+                std::sort(sorted.begin(), sorted.end());
+                sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+            }
+        }
+
+        std::vector<int32_t> interleaved;
+        std::vector<int32_t> serialized(1 + 2 * sorted.size());
+        serialized[0] = htonl(static_cast<int32_t>(sorted.size()));
+        for (size_t ii = 0; ii < sorted.size(); ii++) {
+            const int32_t partition = static_cast<int32_t>(ii % 64);
+            interleaved.push_back(sorted[ii]);
+            interleaved.push_back(partition);
+            serialized[1 + ii * 2] = htonl(sorted[ii]);
+            serialized[2 + ii * 2] = htonl(partition);
+        }
+        ElasticHashinator hashinator(reinterpret_cast<const char*>(&serialized[0]));
+
+        int64_t before = 0;
+        double start = now();
+        for (int64_t ii = 0; ii < lookups; ii++) {
+            before += interleavedLookup(interleaved, hashes[ii & 0xffff]);
+        }
+        double beforeSecs = now() - start;
+
+        int64_t after = 0;
+        start = now();
+        for (int64_t ii = 0; ii < lookups; ii++) {
+            after += hashinator.partitionForToken(hashes[ii & 0xffff]);
+        }
+        double afterSecs = now() - start;
+
+        printf("%-8u %18.1f %18.1f %8s\n", static_cast<unsigned>(sorted.size()),
+               beforeSecs * 1e9 / lookups, afterSecs * 1e9 / lookups, before == after ? "yes" : "NO");
+
+        const TheHashinator &base = hashinator;
+        const int64_t batched = lookups - lookups % static_cast<int64_t>(BATCH_SIZE);
+        before = 0;
+        start = now();
+        for (int64_t ii = 0; ii < batched; ii++) {
+            before += base.hashinate(values[ii & 0xffff]);
+        }
+        singleNanos.push_back((now() - start) * 1e9 / batched);
+
+        after = 0;
+        start = now();
+        for (int64_t ii = 0; ii < batched; ii += BATCH_SIZE) {
+            base.hashinateBatch(&values[ii & 0xffff], BATCH_SIZE, &partitions[0]);
+            for (size_t jj = 0; jj < BATCH_SIZE; jj++) {
+                after += partitions[jj];
+            }
+        }
+        batchNanos.push_back((now() - start) * 1e9 / batched);
+        if (before != after) {
+            printf("hashinateBatch disagrees with hashinate\n");
+            return 1;
+        }
+    }
+
+    printf("\n%-8s %18s %18s\n", "tokens", "hashinate ns/op", "batch ns/op");
+    for (size_t ss = 0; ss < singleNanos.size(); ss++) {
+        printf("%-8u %18.1f %18.1f\n", sizes[ss], singleNanos[ss], batchNanos[ss]);
+    }
+    return 0;
+}
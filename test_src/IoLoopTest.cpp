@@ -0,0 +1,244 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include "Client.h"
+#include "MockVoltDB.h"
+#include "Procedure.hpp"
+#include "ProcedureCallback.hpp"
+#include "InvocationResponse.hpp"
+#include "ClientConfig.h"
+
+namespace voltdb {
+
+/*
+ * Exercises a client configured with I/O threads. The mock server runs on a single
+ * threaded client of its own, driven by a separate thread.
+ */
+class IoLoopTest : public CppUnit::TestFixture {
+CPPUNIT_TEST_SUITE( IoLoopTest );
+CPPUNIT_TEST( testSyncInvoke );
+CPPUNIT_TEST( testInvokeFromManyThreads );
+CPPUNIT_TEST( testInvokeAsync );
+CPPUNIT_TEST( testCreateConnectionsAsync );
+CPPUNIT_TEST( testRateLimit );
+CPPUNIT_TEST( testDeadlinePassed );
+CPPUNIT_TEST_EXCEPTION( testInvokeNoConnections, voltdb::NoConnectionsException );
+CPPUNIT_TEST_EXCEPTION( testConnectFailure, voltdb::ConnectException );
+CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {
+        m_voltdb.reset(new MockVoltDB(Client::create(ClientConfig("hello", "world"))));
+        m_voltdb->filenameForNextResponse("invocation_response_success.msg");
+        m_stopServer = false;
+        m_server.reset(new boost::thread(boost::bind(&IoLoopTest::serve, this)));
+
+        ClientConfig config("hello", "world");
+        config.m_ioThreads = 2;
+        config.m_maxOutstandingRequests = 100000;
+        m_client.reset(new Client(Client::create(config)));
+    }
+
+    void tearDown() {
+        m_client.reset();
+        m_stopServer = true;
+        m_voltdb->interrupt();
+        m_server->join();
+        m_voltdb.reset();
+    }
+
+    void serve() {
+        while (!m_stopServer) {
+            m_voltdb->run();
+        }
+    }
+
+    void testSyncInvoke() {
+        m_client->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        InvocationResponse response = m_client->invoke(proc);
+        CPPUNIT_ASSERT(response.success());
+        CPPUNIT_ASSERT(m_client->outstandingRequests() == 0);
+    }
+
+    class CountingCallback : public ProcedureCallback {
+    public:
+        CountingCallback() : m_success(0), m_failure(0) {}
+        bool callback(InvocationResponse response) throw (voltdb::Exception) {
+            if (response.success()) {
+                m_success++;
+            } else {
+                m_failure++;
+            }
+            return false;
+        }
+        boost::atomic<int32_t> m_success;
+        boost::atomic<int32_t> m_failure;
+    };
+
+    static void invokeMany(Client *client, boost::shared_ptr<ProcedureCallback> callback, int count) {
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        for (int ii = 0; ii < count; ii++) {
+            client->invoke(proc, callback);
+        }
+    }
+
+    void testInvokeFromManyThreads() {
+        m_client->createConnection("localhost");
+        m_client->createConnection("localhost");
+
+        CountingCallback *cb = new CountingCallback();
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        const int threads = 4;
+        const int perThread = 500;
+        boost::thread_group producers;
+        for (int ii = 0; ii < threads; ii++) {
+            producers.create_thread(boost::bind(&IoLoopTest::invokeMany, m_client.get(), callback, perThread));
+        }
+        producers.join_all();
+
+        CPPUNIT_ASSERT(m_client->drain());
+        CPPUNIT_ASSERT(cb->m_success == threads * perThread);
+        CPPUNIT_ASSERT(cb->m_failure == 0);
+        CPPUNIT_ASSERT(m_client->outstandingRequests() == 0);
+    }
+
+    void testInvokeAsync() {
+        m_client->createConnection("localhost");
+        m_client->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        std::vector<InvocationFuture> futures;
+        for (int ii = 0; ii < 100; ii++) {
+            futures.push_back(m_client->invokeAsync(proc));
+        }
+        CPPUNIT_ASSERT(whenAll(futures));
+        CPPUNIT_ASSERT(m_client->outstandingRequests() == 0);
+    }
+
+    class CompletionCallback : public ConnectionCallback {
+    public:
+        CompletionCallback() : m_connected(0), m_completed(false) {}
+        bool connected(const std::string &hostname, unsigned short port) {
+            m_connected++;
+            return false;
+        }
+        bool completed(int32_t connected, const std::vector<std::string> &failed) {
+            m_completedConnected = connected;
+            m_completed = true;
+            return false;
+        }
+        boost::atomic<int32_t> m_connected;
+        boost::atomic<bool> m_completed;
+        int32_t m_completedConnected;
+    };
+
+    void testCreateConnectionsAsync() {
+        std::vector<std::string> hosts(2, "localhost");
+        CompletionCallback *cb = new CompletionCallback();
+        boost::shared_ptr<ConnectionCallback> callback(cb);
+        m_client->createConnectionsAsync(hosts, callback);
+        while (!cb->m_completed) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+        CPPUNIT_ASSERT(cb->m_connected == 2);
+        CPPUNIT_ASSERT(cb->m_completedConnected == 2);
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        CPPUNIT_ASSERT(m_client->invoke(proc).success());
+    }
+
+    void testRateLimit() {
+        ClientConfig config("hello", "world");
+        config.m_ioThreads = 2;
+        config.m_rateLimits["Insert"] = RateLimit(200, 5);
+        m_client.reset(new Client(Client::create(config)));
+        m_client->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        std::vector<InvocationFuture> futures;
+        const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+        for (int ii = 0; ii < 10; ii++) {
+            futures.push_back(m_client->invokeAsync(proc));
+        }
+        CPPUNIT_ASSERT(m_client->getStats().m_rateLimitedRequests == 5);
+        CPPUNIT_ASSERT(whenAll(futures));
+        // the I/O threads held the last five back five milliseconds apart
+        CPPUNIT_ASSERT((boost::posix_time::microsec_clock::universal_time() - start).total_milliseconds() >= 20);
+        CPPUNIT_ASSERT(m_client->outstandingRequests() == 0);
+    }
+
+    class DeadlineCallback : public ProcedureCallback {
+    public:
+        DeadlineCallback() : m_expired(0) {}
+        bool callback(InvocationResponse response) throw (voltdb::Exception) {
+            return false;
+        }
+        void abandon(AbandonReason reason) {
+            if (reason == DEADLINE_EXPIRED) {
+                m_expired++;
+            }
+        }
+        boost::atomic<int32_t> m_expired;
+    };
+
+    void testDeadlinePassed() {
+        m_client->createConnection("localhost");
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        DeadlineCallback *cb = new DeadlineCallback();
+        boost::shared_ptr<ProcedureCallback> callback(cb);
+        // abandoned on the calling thread, which has no event loop of its own
+        m_client->invokeWithDeadline(proc, callback, 1);
+        CPPUNIT_ASSERT(cb->m_expired == 1);
+        CPPUNIT_ASSERT(m_client->getStats().m_shedRequests == 1);
+        CPPUNIT_ASSERT(m_client->outstandingRequests() == 0);
+    }
+
+    void testInvokeNoConnections() {
+        std::vector<Parameter> signature;
+        Procedure proc("Insert", signature);
+        m_client->invoke(proc, boost::shared_ptr<ProcedureCallback>(new CountingCallback()));
+    }
+
+    void testConnectFailure() {
+        m_client->createConnection("localhost", 21213);
+    }
+
+private:
+    boost::scoped_ptr<MockVoltDB> m_voltdb;
+    boost::scoped_ptr<boost::thread> m_server;
+    boost::atomic<bool> m_stopServer;
+    boost::scoped_ptr<Client> m_client;
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( IoLoopTest );
+}
@@ -131,7 +131,7 @@ static void acceptCallback(struct evconnlistener *listener,
 
 
 MockVoltDB::MockVoltDB(Client client) : m_base(client.m_impl->m_base), m_listener(NULL),
-        m_hangupOnRequestCounter(-1), m_dontRead(false), m_timeoutCount(-1), m_errorCount(-1), m_client(client) {
+        m_hangupOnRequestCounter(-1), m_dontRead(false), m_answerLogins(true), m_timeoutCount(-1), m_errorCount(-1), m_client(client) {
     struct sockaddr_in sin;
     ::memset(&sin, 0, sizeof(sin));
     sin.sin_family = AF_INET;
@@ -229,6 +229,9 @@ void MockVoltDB::readCallback(struct bufferevent *bev) {
 
     boost::shared_ptr<CxnContext> ctx = m_contexts[bev];
     if (!ctx->m_authenticated) {
+        if (!m_answerLogins) {
+            return;
+        }
         if (m_hangupOnRequestCounter > 0) {
             m_hangupOnRequestCounter--;
             if (m_hangupOnRequestCounter == 0) {
@@ -256,7 +259,14 @@ void MockVoltDB::readCallback(struct bufferevent *bev) {
     }
 
     struct evbuffer *evbuf = bufferevent_get_input(bev);
-    while (evbuffer_get_length(evbuf) > 0)  {
+    while (evbuffer_get_length(evbuf) >= 4)  {
+        // leave a partially received request for the next read
+        char peekedLengthBytes[4];
+        evbuffer_copyout(evbuf, peekedLengthBytes, 4);
+        ByteBuffer peekedLengthBuffer(peekedLengthBytes, 4);
+        if (evbuffer_get_length(evbuf) < 4 + static_cast<size_t>(peekedLengthBuffer.getInt32())) {
+            return;
+        }
         if (m_hangupOnRequestCounter > 0) {
             m_hangupOnRequestCounter--;
             if (m_hangupOnRequestCounter == 0) {
@@ -68,6 +68,14 @@ public:
         m_dontRead = true;
     }
 
+    /**
+     * Leave the logins of new connections unanswered, as a peer that accepts the socket
+     * but hangs would
+     */
+    void answerLogins(bool answer) {
+        m_answerLogins = answer;
+    }
+
     /**
      * Forces a timeout after N transactions, to allow for testing execute multi.
      * @param the number of transactions to allow before forcing a timeout
@@ -93,6 +101,7 @@ private:
     std::string m_filenameForNextResponse;
     int32_t m_hangupOnRequestCounter;
     bool m_dontRead;
+    bool m_answerLogins;
     int m_timeoutCount;
     int m_errorCount;
     Client m_client;
@@ -0,0 +1,95 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include "ReconnectBackoff.h"
+
+namespace voltdb {
+
+class ReconnectBackoffTest : public CppUnit::TestFixture {
+CPPUNIT_TEST_SUITE( ReconnectBackoffTest );
+CPPUNIT_TEST( testExponentialUpToMax );
+CPPUNIT_TEST( testJitterShortensDelay );
+CPPUNIT_TEST( testStateMachine );
+CPPUNIT_TEST( testAttemptExpires );
+CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testExponentialUpToMax() {
+        ReconnectBackoff backoff(100, 1000, 2.0, 0.0);
+        CPPUNIT_ASSERT(backoff.delayMillis(1, 0.5) == 100);
+        CPPUNIT_ASSERT(backoff.delayMillis(2, 0.5) == 200);
+        CPPUNIT_ASSERT(backoff.delayMillis(4, 0.5) == 800);
+        CPPUNIT_ASSERT(backoff.delayMillis(5, 0.5) == 1000);
+        CPPUNIT_ASSERT(backoff.delayMillis(1000000, 0.5) == 1000);
+    }
+
+    void testJitterShortensDelay() {
+        ReconnectBackoff backoff(100, 1000, 2.0, 0.2);
+        CPPUNIT_ASSERT(backoff.delayMillis(1, 0.0) == 100);
+        CPPUNIT_ASSERT(backoff.delayMillis(1, 0.5) == 90);
+        CPPUNIT_ASSERT(backoff.delayMillis(10, 0.999) >= 800);
+        CPPUNIT_ASSERT(backoff.delayMillis(10, 0.999) <= 1000);
+    }
+
+    void testStateMachine() {
+        ReconnectBackoff backoff(100, 1000, 2.0, 0.0);
+        ReconnectState state(5000);
+        CPPUNIT_ASSERT(!state.isDue(4999));
+        CPPUNIT_ASSERT(state.isDue(5000));
+
+        state.attemptStarted(5000);
+        CPPUNIT_ASSERT(state.state() == ReconnectState::CONNECTING);
+        CPPUNIT_ASSERT(!state.isDue(6000));
+        CPPUNIT_ASSERT(state.nextEventMillis(2000) == 7000);
+        CPPUNIT_ASSERT(!state.attemptExpired(6000, 2000));
+
+        state.attemptFailed(backoff, 6000, 0.0);
+        CPPUNIT_ASSERT(state.state() == ReconnectState::WAITING);
+        CPPUNIT_ASSERT(state.failures() == 1);
+        CPPUNIT_ASSERT(state.dueMillis() == 6100);
+
+        CPPUNIT_ASSERT(state.nextEventMillis(2000) == 6100);
+        CPPUNIT_ASSERT(!state.attemptExpired(10000, 2000));
+
+        state.attemptStarted(6100);
+        state.attemptFailed(backoff, 6100, 0.0);
+        CPPUNIT_ASSERT(state.dueMillis() == 6300);
+    }
+
+    void testAttemptExpires() {
+        ReconnectBackoff backoff(100, 1000, 2.0, 0.0);
+        ReconnectState state(0);
+        state.attemptStarted(1000);
+        CPPUNIT_ASSERT(!state.attemptExpired(2999, 2000));
+        CPPUNIT_ASSERT(state.attemptExpired(3000, 2000));
+        // an expired attempt backs off like any other failure
+        state.attemptFailed(backoff, 3000, 0.0);
+        CPPUNIT_ASSERT(state.state() == ReconnectState::WAITING);
+        CPPUNIT_ASSERT(state.dueMillis() == 3100);
+        CPPUNIT_ASSERT(!state.attemptExpired(10000, 2000));
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( ReconnectBackoffTest );
+}
@@ -0,0 +1,124 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Compares the two ways of getting an invocation into a connection's output buffer.
+ * The old path serialized into a heap allocated ScopedByteBuffer and then evbuffer_add
+ * copied it. The new path, used by ClientImpl::writeInvocation, serializes straight into
+ * space reserved at the end of the evbuffer.
+ *
+ * Usage: serializationbench [invocations]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <event2/buffer.h>
+#include "Procedure.hpp"
+#include "Parameter.hpp"
+#include "ParameterSet.hpp"
+
+using namespace voltdb;
+
+static const size_t DRAIN_THRESHOLD = 1024 * 1024;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+static void bind(Procedure &proc, int64_t ii) {
+    proc.params()->addString("Hello").addString("World").addInt64(ii);
+}
+
+/*
+ * Returns the number of bytes copied out of already serialized buffers
+ */
+static int64_t copyThroughScopedBuffer(Procedure &proc, struct evbuffer *evbuf, int64_t invocations) {
+    int64_t copied = 0;
+    for (int64_t ii = 0; ii < invocations; ii++) {
+        bind(proc, ii);
+        int32_t paramSize = proc.getParameterBuffer().capacity();
+        int32_t messageSize = proc.getSerializedSize();
+        ScopedByteBuffer sbb(messageSize);
+        proc.serializeTo(&sbb, ii);
+        evbuffer_add(evbuf, sbb.bytes(), static_cast<size_t>(sbb.remaining()));
+        copied += paramSize + messageSize;
+        if (evbuffer_get_length(evbuf) > DRAIN_THRESHOLD) {
+            evbuffer_drain(evbuf, evbuffer_get_length(evbuf));
+        }
+    }
+    return copied;
+}
+
+static int64_t serializeIntoReservedSpace(Procedure &proc, struct evbuffer *evbuf, int64_t invocations) {
+    int64_t copied = 0;
+    for (int64_t ii = 0; ii < invocations; ii++) {
+        bind(proc, ii);
+        int32_t paramSize = proc.getParameterBuffer().capacity();
+        int32_t messageSize = proc.getSerializedSize();
+        struct evbuffer_iovec extent;
+        evbuffer_reserve_space(evbuf, messageSize, &extent, 1);
+        ByteBuffer buffer(reinterpret_cast<char*>(extent.iov_base), messageSize);
+        proc.serializeTo(&buffer, ii);
+        extent.iov_len = static_cast<size_t>(messageSize);
+        evbuffer_commit_space(evbuf, &extent, 1);
+        copied += paramSize;
+        if (evbuffer_get_length(evbuf) > DRAIN_THRESHOLD) {
+            evbuffer_drain(evbuf, evbuffer_get_length(evbuf));
+        }
+    }
+    return copied;
+}
+
+int main(int argc, char **argv) {
+    int64_t invocations = argc > 1 ? atoll(argv[1]) : 5000000;
+
+    std::vector<Parameter> signature;
+    signature.push_back(Parameter(WIRE_TYPE_STRING));
+    signature.push_back(Parameter(WIRE_TYPE_STRING));
+    signature.push_back(Parameter(WIRE_TYPE_BIGINT));
+    Procedure proc("Insert", signature);
+    bind(proc, 0);
+    int32_t messageSize = proc.getSerializedSize();
+
+    struct evbuffer *evbuf = evbuffer_new();
+    double start = now();
+    int64_t before = copyThroughScopedBuffer(proc, evbuf, invocations);
+    double beforeSecs = now() - start;
+    evbuffer_drain(evbuf, evbuffer_get_length(evbuf));
+
+    start = now();
+    int64_t after = serializeIntoReservedSpace(proc, evbuf, invocations);
+    double afterSecs = now() - start;
+    evbuffer_free(evbuf);
+
+    printf("%lld invocations of %d bytes each\n", static_cast<long long>(invocations), messageSize);
+    printf("%-28s %8s %12s %14s\n", "path", "ns/op", "allocs/op", "bytes copied/op");
+    printf("%-28s %8.1f %12d %14.1f\n", "ScopedByteBuffer + add",
+           beforeSecs * 1e9 / invocations, 1, static_cast<double>(before) / invocations);
+    printf("%-28s %8.1f %12d %14.1f\n", "reserve/commit in place",
+           afterSecs * 1e9 / invocations, 0, static_cast<double>(after) / invocations);
+    return 0;
+}
@@ -25,6 +25,7 @@
 #include <cppunit/extensions/HelperMacros.h>
 #include <cppunit/TestFixture.h>
 #include <boost/scoped_ptr.hpp>
+#include <boost/checked_delete.hpp>
 #include <iostream>
 #include <exception>
 #include <cstdio>
@@ -55,6 +56,7 @@ CPPUNIT_TEST(testInvocationAllParams);
 CPPUNIT_TEST(testInvocationResponseSuccess);
 CPPUNIT_TEST(testInvocationResponseFailCV);
 CPPUNIT_TEST(testInvocationResponseSelect);
+CPPUNIT_TEST(testInvocationResponseInPlace);
 CPPUNIT_TEST(testSerializedTable);
 CPPUNIT_TEST_SUITE_END();
 public:
@@ -230,6 +232,31 @@ void testInvocationResponseSelect() {
     CPPUNIT_ASSERT(resultCount == 1);
 }
 
+void testInvocationResponseInPlace() {
+    SharedByteBuffer original = fileAsByteBuffer("invocation_response_select.msg");
+    const int32_t length = original.capacity() - 4;
+    char *storage = new char[3 + length * 2];
+    boost::shared_ptr<void> chunk(storage, boost::checked_array_deleter<char>());
+    original.position(4);
+    original.get(storage + 3, length);
+    original.position(4);
+    original.get(storage + 3 + length, length);
+
+    InvocationResponse first(chunk, storage + 3, length);
+    InvocationResponse second(chunk, storage + 3 + length, length);
+    chunk.reset();
+
+    CPPUNIT_ASSERT(first.clientData() == -9223372036854775806);
+    CPPUNIT_ASSERT(second.clientData() == -9223372036854775806);
+    CPPUNIT_ASSERT(second.results().size() == 1);
+    TableIterator iterator = second.results()[0].iterator();
+    CPPUNIT_ASSERT(iterator.hasNext());
+    Row r = iterator.next();
+    CPPUNIT_ASSERT(r.getString("HELLO") == "Hello");
+    CPPUNIT_ASSERT(r.getString("WORLD") == "World");
+    CPPUNIT_ASSERT(!iterator.hasNext());
+}
+
 void testSerializedTable() {
     SharedByteBuffer original = fileAsByteBuffer("serialized_table.bin");
     original.position(4);
@@ -0,0 +1,145 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Multi-producer throughput of cross-thread invoke. One thread sits in Client::run() while
+ * application threads invoke concurrently, so every request goes through the submission
+ * queue and the coalesced wakeup. The mock server runs on its own thread and event base.
+ * Must be run from the repository root so the mock can find its canned responses.
+ *
+ * Usage: submissionbench [invocations per round]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "Client.h"
+#include "ClientConfig.h"
+#include "MockVoltDB.h"
+#include "Procedure.hpp"
+#include "ProcedureCallback.hpp"
+
+using namespace voltdb;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+class CountingCallback : public ProcedureCallback {
+public:
+    CountingCallback() : m_completed(0), m_rejected(0) {}
+    bool callback(InvocationResponse response) throw (voltdb::Exception) {
+        m_completed++;
+        return false;
+    }
+    void abandon(AbandonReason reason) {
+        m_rejected++;
+    }
+    boost::atomic<int64_t> m_completed;
+    boost::atomic<int64_t> m_rejected;
+};
+
+static void serve(MockVoltDB *mock, boost::atomic<bool> *stop) {
+    while (!*stop) {
+        mock->run();
+    }
+}
+
+static const int32_t MAX_OUTSTANDING = 50000;
+static const int32_t PRODUCER_WINDOW = 20000;
+
+/*
+ * Producers stay under the outstanding request limit, as an application honouring
+ * backpressure would, so nothing is rejected and the numbers reflect completed requests
+ */
+static void produce(Client *client, boost::shared_ptr<ProcedureCallback> callback, int64_t count) {
+    std::vector<Parameter> signature;
+    signature.push_back(Parameter(WIRE_TYPE_BIGINT));
+    Procedure proc("Insert", signature);
+    for (int64_t ii = 0; ii < count; ii++) {
+        while (client->outstandingRequests() >= PRODUCER_WINDOW) {
+            boost::this_thread::yield();
+        }
+        proc.params()->addInt64(ii);
+        client->invoke(proc, callback);
+    }
+}
+
+int main(int argc, char **argv) {
+    int64_t invocations = argc > 1 ? atoll(argv[1]) : 400000;
+
+    MockVoltDB mock(Client::create(ClientConfig("hello", "world")));
+    mock.filenameForNextResponse("invocation_response_success.msg");
+    boost::atomic<bool> stopServer(false);
+    boost::thread server(boost::bind(serve, &mock, &stopServer));
+
+    ClientConfig config("hello", "world");
+    config.m_maxOutstandingRequests = MAX_OUTSTANDING;
+    Client client = Client::create(config);
+    client.createConnection("localhost");
+
+    /*
+     * The first request is made before the loop thread starts and completes inside run(),
+     * after which every invoke from this thread is a cross-thread one.
+     */
+    CountingCallback *counter = new CountingCallback();
+    boost::shared_ptr<ProcedureCallback> callback(counter);
+    produce(&client, callback, 1);
+    boost::thread loop(boost::bind(&Client::run, &client));
+    while (counter->m_completed < 1) {
+        boost::this_thread::yield();
+    }
+
+    printf("%lld invocations per round\n", static_cast<long long>(invocations));
+    printf("%-10s %12s %12s\n", "producers", "req/s", "rejected");
+    const int producerCounts[] = { 1, 2, 4, 8 };
+    for (size_t round = 0; round < sizeof producerCounts / sizeof producerCounts[0]; round++) {
+        const int producers = producerCounts[round];
+        const int64_t expected = counter->m_completed + counter->m_rejected + invocations;
+        const int64_t rejectedBefore = counter->m_rejected;
+        double start = now();
+        boost::thread_group group;
+        for (int ii = 0; ii < producers; ii++) {
+            group.create_thread(boost::bind(produce, &client, callback, invocations / producers));
+        }
+        group.join_all();
+        while (counter->m_completed + counter->m_rejected < expected) {
+            boost::this_thread::yield();
+        }
+        double secs = now() - start;
+        printf("%-10d %12.0f %12lld\n", producers, static_cast<double>(invocations) / secs,
+               static_cast<long long>(counter->m_rejected - rejectedBefore));
+    }
+
+    client.interrupt();
+    loop.join();
+    stopServer = true;
+    mock.interrupt();
+    server.join();
+    return 0;
+}
@@ -0,0 +1,104 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <algorithm>
+#include "TimerWheel.h"
+
+namespace voltdb {
+
+class TimerWheelTest : public CppUnit::TestFixture {
+CPPUNIT_TEST_SUITE( TimerWheelTest );
+CPPUNIT_TEST( testExpiresAtDeadline );
+CPPUNIT_TEST( testPastDeadline );
+CPPUNIT_TEST( testMultipleRevolutions );
+CPPUNIT_TEST( testLongPause );
+CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testExpiresAtDeadline() {
+        TimerWheel wheel(10, 8, 1000);
+        wheel.schedule(1, 1050);
+        wheel.schedule(2, 1055);
+        std::vector<int64_t> expired;
+        wheel.expire(1049, expired);
+        CPPUNIT_ASSERT(expired.empty());
+        wheel.expire(1050, expired);
+        CPPUNIT_ASSERT(expired.size() == 1 && expired[0] == 1);
+        wheel.expire(1059, expired);
+        CPPUNIT_ASSERT(expired.size() == 1);
+        wheel.expire(1060, expired);
+        CPPUNIT_ASSERT(expired.size() == 2 && expired[1] == 2);
+        CPPUNIT_ASSERT(wheel.empty());
+    }
+
+    void testPastDeadline() {
+        TimerWheel wheel(10, 8, 1000);
+        wheel.schedule(1, 900);
+        std::vector<int64_t> expired;
+        wheel.expire(1009, expired);
+        CPPUNIT_ASSERT(expired.empty());
+        wheel.expire(1010, expired);
+        CPPUNIT_ASSERT(expired.size() == 1 && expired[0] == 1);
+    }
+
+    /*
+     * Deadlines beyond one revolution share a slot with nearer ones and must wait their turn
+     */
+    void testMultipleRevolutions() {
+        TimerWheel wheel(10, 8, 0);
+        wheel.schedule(1, 10);
+        wheel.schedule(2, 90);
+        wheel.schedule(3, 170);
+        std::vector<int64_t> expired;
+        for (int64_t now = 0; now <= 160; now += 10) {
+            wheel.expire(now, expired);
+        }
+        CPPUNIT_ASSERT(expired.size() == 2);
+        CPPUNIT_ASSERT(expired[0] == 1 && expired[1] == 2);
+        CPPUNIT_ASSERT(wheel.size() == 1);
+        wheel.expire(170, expired);
+        CPPUNIT_ASSERT(expired.size() == 3 && expired[2] == 3);
+    }
+
+    void testLongPause() {
+        TimerWheel wheel(10, 8, 0);
+        for (int64_t ii = 0; ii < 100; ii++) {
+            wheel.schedule(ii, ii * 7);
+        }
+        std::vector<int64_t> expired;
+        wheel.expire(350, expired);
+        CPPUNIT_ASSERT(expired.size() == 51);
+        wheel.expire(10000, expired);
+        CPPUNIT_ASSERT(expired.size() == 100);
+        std::sort(expired.begin(), expired.end());
+        for (int64_t ii = 0; ii < 100; ii++) {
+            CPPUNIT_ASSERT(expired[ii] == ii);
+        }
+        CPPUNIT_ASSERT(wheel.empty());
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TimerWheelTest );
+}
@@ -0,0 +1,83 @@
+/* This file is part of VoltDB.
+ * Copyright (C) 2008-2015 VoltDB Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include "TokenBucket.h"
+
+namespace voltdb {
+
+class TokenBucketTest : public CppUnit::TestFixture {
+CPPUNIT_TEST_SUITE( TokenBucketTest );
+CPPUNIT_TEST( testBurst );
+CPPUNIT_TEST( testRefill );
+CPPUNIT_TEST( testRates );
+CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testBurst() {
+        TokenBucket bucket(100, 3);
+        const int64_t now = 1000000;
+        for (int ii = 0; ii < 3; ii++) {
+            CPPUNIT_ASSERT(bucket.reserve(now) == now);
+        }
+        // once the burst is spent permits are reserved a hundredth of a second apart
+        CPPUNIT_ASSERT(bucket.reserve(now) == now + 10000);
+        CPPUNIT_ASSERT(bucket.reserve(now) == now + 20000);
+    }
+
+    void testRefill() {
+        TokenBucket bucket(100, 3);
+        const int64_t now = 1000000;
+        for (int ii = 0; ii < 3; ii++) {
+            bucket.reserve(now);
+        }
+        CPPUNIT_ASSERT(bucket.reserve(now + 10000) == now + 10000);
+        CPPUNIT_ASSERT(bucket.reserve(now + 10000) == now + 20000);
+        // an idle bucket fills up to its burst and no further
+        const int64_t later = now + 1000000;
+        for (int ii = 0; ii < 3; ii++) {
+            CPPUNIT_ASSERT(bucket.reserve(later) == later);
+        }
+        CPPUNIT_ASSERT(bucket.reserve(later) == later + 10000);
+    }
+
+    void testRates() {
+        TokenBucket fast(1000000, 1);
+        CPPUNIT_ASSERT(fast.reserve(5) == 5);
+        CPPUNIT_ASSERT(fast.reserve(5) == 6);
+        // a third of a microsecond apart, rounded up to the next microsecond
+        TokenBucket faster(3000000, 1);
+        CPPUNIT_ASSERT(faster.reserve(5) == 5);
+        CPPUNIT_ASSERT(faster.reserve(5) == 6);
+        CPPUNIT_ASSERT(faster.reserve(5) == 6);
+        CPPUNIT_ASSERT(faster.reserve(5) == 6);
+        CPPUNIT_ASSERT(faster.reserve(5) == 7);
+        // no rate at all still lets one invocation through a second
+        TokenBucket none(0, 0);
+        CPPUNIT_ASSERT(none.reserve(5) == 5);
+        CPPUNIT_ASSERT(none.reserve(5) == 1000005);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( TokenBucketTest );
+}